@@ -206,6 +206,18 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/**
+ * Switch allocator to lock-free allocator which collects statistics per allocation name
+ * (count, bytes and lifetime), printed by #MEM_printmemlist_stats and on exit.
+ * Must be called before any allocation happened, blocks allocated earlier are not accounted. */
+void MEM_use_profiling_allocator(void);
+
+/**
+ * Switch allocator to a size-class allocator with per-thread caches for small blocks,
+ * larger blocks use the lock-free allocator.
+ * Must be called before any allocation happened. */
+void MEM_use_slab_allocator(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
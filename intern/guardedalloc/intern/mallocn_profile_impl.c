@@ -0,0 +1,475 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file guardedalloc/intern/mallocn_profile_impl.c
+ *  \ingroup MEM
+ *
+ * Allocation profiling on top of the lock-free allocator.
+ *
+ * Every allocation is accounted to the name passed to it (the \a str argument),
+ * collecting the number of allocations, requested bytes, live blocks and
+ * a histogram of block lifetimes. Lifetimes are measured in "ticks",
+ * where a tick is a single allocation made anywhere in the program,
+ * so a short lifetime means a block was freed before many other allocations happened.
+ *
+ * To find the entry of a block when it's freed, a small tail is stored after the user data,
+ * this way the layout of the lock-free allocator (and its alignment handling) is untouched.
+ *
+ * Statistics are kept in a fixed size, open addressing table keyed by the name pointer,
+ * which is updated using atomic operations only.
+ */
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <sys/types.h>
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+/* Must be a power of two. */
+#define MEM_PROFILE_TABLE_SIZE 4096
+/* Number of lifetime buckets, each bucket covers 4x longer lifetime than the previous one. */
+#define MEM_PROFILE_LIFETIME_BUCKETS 12
+/* Number of names to print in the report. */
+#define MEM_PROFILE_REPORT_LINES 64
+
+#define MEM_PROFILE_TAIL_MAGIC 0x4d454d50  /* 'MEMP' */
+
+typedef struct MemProfileEntry {
+	/* Name of the allocation, NULL for unused entries. */
+	const char *str;
+	size_t alloc_num;
+	size_t alloc_bytes;
+	size_t live_num;
+	size_t live_bytes;
+	size_t live_bytes_peak;
+	/* Memory wasted by the system allocator rounding up the size. */
+	size_t slop_bytes;
+	size_t lifetime[MEM_PROFILE_LIFETIME_BUCKETS];
+} MemProfileEntry;
+
+/* Stored (unaligned) after the user data of each block. */
+typedef struct MemProfileTail {
+	unsigned int magic;
+	unsigned int entry_index;
+	size_t tick;
+} MemProfileTail;
+
+/* Last entry is used when the table is full. */
+static MemProfileEntry profile_table[MEM_PROFILE_TABLE_SIZE + 1];
+static size_t profile_tick = 0;
+static bool profile_report_registered = false;
+
+MEM_INLINE void update_maximum(size_t *maximum_value, size_t value)
+{
+	size_t prev_value = *maximum_value;
+	while (prev_value < value) {
+		const size_t prev_value_test = atomic_cas_z(maximum_value, prev_value, value);
+		if (prev_value_test == prev_value) {
+			break;
+		}
+		prev_value = prev_value_test;
+	}
+}
+
+MEM_INLINE unsigned int profile_hash_ptr(const char *str)
+{
+	uintptr_t key = (uintptr_t)str;
+	key ^= key >> 16;
+	key *= 0x9e3779b1u;
+	return (unsigned int)(key >> 8) & (MEM_PROFILE_TABLE_SIZE - 1);
+}
+
+static unsigned int profile_entry_index_ensure(const char *str)
+{
+	unsigned int index = profile_hash_ptr(str);
+	unsigned int i;
+
+	for (i = 0; i < MEM_PROFILE_TABLE_SIZE; i++) {
+		MemProfileEntry *entry = &profile_table[index];
+		const char *entry_str = entry->str;
+		if (entry_str == str) {
+			return index;
+		}
+		else if (entry_str == NULL) {
+			entry_str = (const char *)atomic_cas_z((size_t *)&entry->str, 0, (size_t)str);
+			/* Either we claimed the entry or another thread claimed it for the same name. */
+			if (entry_str == NULL || entry_str == str) {
+				return index;
+			}
+		}
+		index = (index + 1) & (MEM_PROFILE_TABLE_SIZE - 1);
+	}
+
+	return MEM_PROFILE_TABLE_SIZE;
+}
+
+MEM_INLINE unsigned int profile_lifetime_bucket(size_t lifetime)
+{
+	unsigned int bucket = 0;
+	while ((lifetime >>= 2) && (bucket < MEM_PROFILE_LIFETIME_BUCKETS - 1)) {
+		bucket++;
+	}
+	return bucket;
+}
+
+MEM_INLINE size_t profile_total_len(size_t len)
+{
+	return len + sizeof(MemProfileTail);
+}
+
+MEM_INLINE bool profile_tail_read(const void *vmemh, MemProfileTail *r_tail, size_t *r_len)
+{
+	const size_t len_total = MEM_lockfree_allocN_len(vmemh);
+	if (LIKELY(len_total >= sizeof(MemProfileTail))) {
+		const size_t len = len_total - sizeof(MemProfileTail);
+		memcpy(r_tail, (const char *)vmemh + len, sizeof(*r_tail));
+		if (LIKELY(r_tail->magic == MEM_PROFILE_TAIL_MAGIC &&
+		           r_tail->entry_index <= MEM_PROFILE_TABLE_SIZE))
+		{
+			*r_len = len;
+			return true;
+		}
+	}
+	/* Allocated before switching to this allocator. */
+	*r_len = len_total;
+	return false;
+}
+
+static void *profile_alloc_tag(void *vmemh, unsigned int entry_index, bool use_slop)
+{
+	MemProfileEntry *entry = &profile_table[entry_index];
+	MemProfileTail tail;
+	size_t len;
+
+	if (UNLIKELY(vmemh == NULL)) {
+		return NULL;
+	}
+
+	len = MEM_lockfree_allocN_len(vmemh) - sizeof(MemProfileTail);
+
+	tail.magic = MEM_PROFILE_TAIL_MAGIC;
+	tail.entry_index = entry_index;
+	tail.tick = atomic_fetch_and_add_z(&profile_tick, 1);
+	memcpy((char *)vmemh + len, &tail, sizeof(tail));
+
+	atomic_add_and_fetch_z(&entry->alloc_num, 1);
+	atomic_add_and_fetch_z(&entry->alloc_bytes, len);
+	atomic_add_and_fetch_z(&entry->live_num, 1);
+	update_maximum(&entry->live_bytes_peak, atomic_add_and_fetch_z(&entry->live_bytes, len));
+
+#ifdef USE_MALLOC_USABLE_SIZE
+	if (use_slop) {
+		const void *real_ptr = (const char *)vmemh - MEM_SIZE_OVERHEAD;
+		atomic_add_and_fetch_z(
+		        &entry->slop_bytes,
+		        malloc_usable_size((void *)real_ptr) - (len + sizeof(MemProfileTail) + MEM_SIZE_OVERHEAD));
+	}
+#else
+	(void)use_slop;
+#endif
+
+	return vmemh;
+}
+
+/* Account the block as freed. */
+static void profile_free_untag(const void *vmemh)
+{
+	MemProfileTail tail;
+	size_t len;
+
+	if (profile_tail_read(vmemh, &tail, &len)) {
+		MemProfileEntry *entry = &profile_table[tail.entry_index];
+		const size_t lifetime = profile_tick - tail.tick;
+
+		atomic_sub_and_fetch_z(&entry->live_num, 1);
+		atomic_sub_and_fetch_z(&entry->live_bytes, len);
+		atomic_add_and_fetch_z(&entry->lifetime[profile_lifetime_bucket(lifetime)], 1);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Allocator Callbacks
+ * \{ */
+
+size_t MEM_profile_allocN_len(const void *vmemh)
+{
+	if (vmemh) {
+		MemProfileTail tail;
+		size_t len;
+		profile_tail_read(vmemh, &tail, &len);
+		return len;
+	}
+	else {
+		return 0;
+	}
+}
+
+void MEM_profile_freeN(void *vmemh)
+{
+	if (vmemh) {
+		profile_free_untag(vmemh);
+	}
+	MEM_lockfree_freeN(vmemh);
+}
+
+void *MEM_profile_dupallocN(const void *vmemh)
+{
+	void *newp = NULL;
+	if (vmemh) {
+		MemProfileTail tail;
+		size_t len;
+		newp = MEM_lockfree_dupallocN(vmemh);
+		/* Account duplicates to the name of the original block, untracked blocks stay untracked. */
+		if (profile_tail_read(vmemh, &tail, &len)) {
+			newp = profile_alloc_tag(newp, tail.entry_index, false);
+		}
+	}
+	return newp;
+}
+
+void *MEM_profile_reallocN_id(void *vmemh, size_t len, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	if (vmemh) {
+		profile_free_untag(vmemh);
+	}
+	return profile_alloc_tag(MEM_lockfree_reallocN_id(vmemh, profile_total_len(len), str), entry_index, false);
+}
+
+void *MEM_profile_recallocN_id(void *vmemh, size_t len, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	size_t old_len = 0, old_len_total = 0;
+	void *newp;
+
+	if (vmemh) {
+		MemProfileTail tail;
+		profile_tail_read(vmemh, &tail, &old_len);
+		old_len_total = MEM_lockfree_allocN_len(vmemh);
+		profile_free_untag(vmemh);
+	}
+
+	newp = MEM_lockfree_recallocN_id(vmemh, profile_total_len(len), str);
+
+	/* The old tail was copied along with the user data, clear it. */
+	if (newp && len > old_len && old_len_total > old_len) {
+		memset((char *)newp + old_len, 0, (len < old_len_total ? len : old_len_total) - old_len);
+	}
+
+	return profile_alloc_tag(newp, entry_index, false);
+}
+
+void *MEM_profile_callocN(size_t len, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	return profile_alloc_tag(MEM_lockfree_callocN(profile_total_len(len), str), entry_index, true);
+}
+
+void *MEM_profile_mallocN(size_t len, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	return profile_alloc_tag(MEM_lockfree_mallocN(profile_total_len(len), str), entry_index, true);
+}
+
+void *MEM_profile_mallocN_aligned(size_t len, size_t alignment, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	return profile_alloc_tag(MEM_lockfree_mallocN_aligned(profile_total_len(len), alignment, str), entry_index, false);
+}
+
+void *MEM_profile_mapallocN(size_t len, const char *str)
+{
+	const unsigned int entry_index = profile_entry_index_ensure(str);
+	return profile_alloc_tag(MEM_lockfree_mapallocN(profile_total_len(len), str), entry_index, false);
+}
+
+#ifndef NDEBUG
+const char *MEM_profile_name_ptr(void *vmemh)
+{
+	if (vmemh) {
+		MemProfileTail tail;
+		size_t len;
+		if (profile_tail_read(vmemh, &tail, &len) && tail.entry_index != MEM_PROFILE_TABLE_SIZE) {
+			return profile_table[tail.entry_index].str;
+		}
+		return "unknown block name ptr";
+	}
+	else {
+		return "MEM_profile_name_ptr(NULL)";
+	}
+}
+#endif  /* NDEBUG */
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Report
+ * \{ */
+
+static int compare_name(const void *p1, const void *p2)
+{
+	const MemProfileEntry *e1 = (const MemProfileEntry *)p1;
+	const MemProfileEntry *e2 = (const MemProfileEntry *)p2;
+
+	return strcmp(e1->str, e2->str);
+}
+
+static int compare_alloc_num(const void *p1, const void *p2)
+{
+	const MemProfileEntry *e1 = (const MemProfileEntry *)p1;
+	const MemProfileEntry *e2 = (const MemProfileEntry *)p2;
+
+	if (e1->alloc_num < e2->alloc_num)
+		return 1;
+	else if (e1->alloc_num == e2->alloc_num)
+		return 0;
+	else
+		return -1;
+}
+
+static void profile_entry_merge(MemProfileEntry *dst, const MemProfileEntry *src)
+{
+	unsigned int i;
+	dst->alloc_num += src->alloc_num;
+	dst->alloc_bytes += src->alloc_bytes;
+	dst->live_num += src->live_num;
+	dst->live_bytes += src->live_bytes;
+	/* Not exact, peaks may have happened at different times. */
+	dst->live_bytes_peak += src->live_bytes_peak;
+	dst->slop_bytes += src->slop_bytes;
+	for (i = 0; i < MEM_PROFILE_LIFETIME_BUCKETS; i++) {
+		dst->lifetime[i] += src->lifetime[i];
+	}
+}
+
+void MEM_profile_printmemlist_stats(void)
+{
+	MemProfileEntry *entries;
+	unsigned int entries_len = 0, a, b, i;
+	size_t alloc_num_total = 0;
+
+	MEM_lockfree_printmemlist_stats();
+
+	entries = malloc(sizeof(*entries) * (MEM_PROFILE_TABLE_SIZE + 1));
+	if (entries == NULL) {
+		return;
+	}
+
+	for (a = 0; a < MEM_PROFILE_TABLE_SIZE + 1; a++) {
+		if (profile_table[a].alloc_num != 0) {
+			entries[entries_len] = profile_table[a];
+			if (a == MEM_PROFILE_TABLE_SIZE) {
+				entries[entries_len].str = "(profile table full)";
+			}
+			alloc_num_total += entries[entries_len].alloc_num;
+			entries_len++;
+		}
+	}
+
+	if (entries_len == 0) {
+		free(entries);
+		return;
+	}
+
+	/* Same names from different translation units may not share a pointer. */
+	qsort(entries, entries_len, sizeof(*entries), compare_name);
+	for (a = 0, b = 0; a < entries_len; a++) {
+		if (a == b) {
+			continue;
+		}
+		else if (strcmp(entries[a].str, entries[b].str) == 0) {
+			profile_entry_merge(&entries[b], &entries[a]);
+		}
+		else {
+			b++;
+			memcpy(&entries[b], &entries[a], sizeof(*entries));
+		}
+	}
+	entries_len = b + 1;
+
+	qsort(entries, entries_len, sizeof(*entries), compare_alloc_num);
+
+	printf("\nAllocation profile: " SIZET_FORMAT " allocations, %u names\n",
+	       SIZET_ARG(alloc_num_total), entries_len);
+	printf("Lifetime is measured in allocations, buckets: <4, <16, <64, ... (percent of freed blocks)\n");
+	printf("   ALLOCS    AVG-B  TOTAL-MiB   LIVE  LIVE-MiB  PEAK-MiB  SLOP-MiB  LIFETIME                                 NAME\n");
+	for (a = 0; a < entries_len && a < MEM_PROFILE_REPORT_LINES; a++) {
+		const MemProfileEntry *entry = &entries[a];
+		size_t freed_num = 0;
+
+		for (i = 0; i < MEM_PROFILE_LIFETIME_BUCKETS; i++) {
+			freed_num += entry->lifetime[i];
+		}
+
+		printf("%9lu %8.1f %10.3f %6lu %9.3f %9.3f %9.3f ",
+		       (unsigned long)entry->alloc_num,
+		       (double)entry->alloc_bytes / (double)entry->alloc_num,
+		       (double)entry->alloc_bytes / (double)(1024 * 1024),
+		       (unsigned long)entry->live_num,
+		       (double)entry->live_bytes / (double)(1024 * 1024),
+		       (double)entry->live_bytes_peak / (double)(1024 * 1024),
+		       (double)entry->slop_bytes / (double)(1024 * 1024));
+		for (i = 0; i < MEM_PROFILE_LIFETIME_BUCKETS; i++) {
+			printf("%3d", freed_num ? (int)((entry->lifetime[i] * 100 + freed_num / 2) / freed_num) : 0);
+		}
+		printf("  %s\n", entry->str);
+	}
+	if (entries_len > MEM_PROFILE_REPORT_LINES) {
+		printf("... %u more names\n", entries_len - MEM_PROFILE_REPORT_LINES);
+	}
+
+	free(entries);
+}
+
+static void profile_report_atexit(void)
+{
+	MEM_profile_printmemlist_stats();
+}
+
+/** \} */
+
+void MEM_use_profiling_allocator(void)
+{
+	MEM_allocN_len = MEM_profile_allocN_len;
+	MEM_freeN = MEM_profile_freeN;
+	MEM_dupallocN = MEM_profile_dupallocN;
+	MEM_reallocN_id = MEM_profile_reallocN_id;
+	MEM_recallocN_id = MEM_profile_recallocN_id;
+	MEM_callocN = MEM_profile_callocN;
+	MEM_mallocN = MEM_profile_mallocN;
+	MEM_mallocN_aligned = MEM_profile_mallocN_aligned;
+	MEM_mapallocN = MEM_profile_mapallocN;
+	MEM_printmemlist_stats = MEM_profile_printmemlist_stats;
+
+#ifndef NDEBUG
+	MEM_name_ptr = MEM_profile_name_ptr;
+#endif
+
+	if (!profile_report_registered) {
+		profile_report_registered = true;
+		atexit(profile_report_atexit);
+	}
+}
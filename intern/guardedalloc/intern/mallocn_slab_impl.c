@@ -0,0 +1,570 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file guardedalloc/intern/mallocn_slab_impl.c
+ *  \ingroup MEM
+ *
+ * Size-class allocator for small blocks, on top of the lock-free allocator.
+ *
+ * Small blocks are carved from large pages and rounded up to a fixed set of size classes.
+ * Each thread keeps a cache of free blocks per size class, so most allocations
+ * and frees don't need any synchronization. When a thread cache runs empty (or gets too full)
+ * a batch of blocks is moved from (or to) a central free list, which is protected by a spin lock.
+ * On Windows there are no thread caches, all blocks use the central free lists.
+ *
+ * Large, aligned and mapped allocations are passed to the lock-free allocator.
+ *
+ * Pages are never returned to the system, freed small blocks are kept for reuse.
+ */
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <sys/types.h>
+
+#ifndef WIN32
+#  include <pthread.h>
+/* Windows has no destructor for thread local storage here, an exiting thread would take its
+ * cached blocks with it, so there blocks always come from the central free lists. */
+#  define USE_THREAD_CACHE
+#endif
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+/* Same as lock-free allocator, so MEM_SIZE_OVERHEAD stays valid. */
+typedef struct MemHead {
+	size_t len;
+} MemHead;
+
+typedef struct MemSlabFree {
+	struct MemSlabFree *next;
+} MemSlabFree;
+
+/* Lengths of lock-free blocks never use the high bit. */
+#define MEMHEAD_SLAB_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+#define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
+#define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
+#define MEMHEAD_IS_SLAB(memhead) ((memhead)->len & MEMHEAD_SLAB_FLAG)
+
+/* Size classes (including MemHead), 16 byte steps up to 256, 64 byte steps up to 1024. */
+#define SLAB_CLASS_SMALL_MAX 256
+#define SLAB_CLASS_MAX 1024
+#define SLAB_CLASS_NUM (SLAB_CLASS_SMALL_MAX / 16 + (SLAB_CLASS_MAX - SLAB_CLASS_SMALL_MAX) / 64)
+
+#define SLAB_PAGE_SIZE (64 * 1024)
+/* Number of blocks moved between a thread cache and the central free list at once. */
+#define SLAB_BATCH_SIZE 32
+/* Thread cache returns a batch to the central free list when it holds more than this. */
+#define SLAB_CACHE_MAX (SLAB_BATCH_SIZE * 2)
+
+typedef struct MemSlabClass {
+	unsigned int lock;
+	MemSlabFree *free;
+	/* Remainder of the last page, not handed out yet. */
+	char *page_cur, *page_end;
+} MemSlabClass;
+
+typedef struct MemSlabThreadCache {
+	MemSlabFree *free[SLAB_CLASS_NUM];
+	unsigned int free_num[SLAB_CLASS_NUM];
+} MemSlabThreadCache;
+
+static MemSlabClass slab_classes[SLAB_CLASS_NUM];
+
+static unsigned int totblock = 0;
+static size_t mem_in_use = 0, peak_mem = 0;
+static size_t slab_pages_len = 0;
+static bool malloc_debug_memset = false;
+
+/* -------------------------------------------------------------------- */
+/** \name Thread Cache Storage
+ * \{ */
+
+#ifdef USE_THREAD_CACHE
+/* Used to return the cached chunks when a thread exits (and for storage on Apple). */
+static pthread_key_t slab_thread_cache_key;
+static pthread_once_t slab_thread_cache_key_once = PTHREAD_ONCE_INIT;
+static void slab_thread_cache_free(void *cache_v);
+
+static void slab_thread_cache_key_create(void)
+{
+	pthread_key_create(&slab_thread_cache_key, slab_thread_cache_free);
+}
+
+#  if defined(__APPLE__)
+#    define SLAB_THREAD_CACHE_GET() ((MemSlabThreadCache *)pthread_getspecific(slab_thread_cache_key))
+#    define SLAB_THREAD_CACHE_SET(cache) pthread_setspecific(slab_thread_cache_key, cache)
+#  else
+static __thread MemSlabThreadCache *slab_thread_cache = NULL;
+#    define SLAB_THREAD_CACHE_GET() (slab_thread_cache)
+#    define SLAB_THREAD_CACHE_SET(cache) (slab_thread_cache = (cache))
+#  endif
+
+/* Stored once the cache of an exiting thread has been freed, so allocations made
+ * by later thread-exit destructors use the central free lists instead of freed memory. */
+static MemSlabThreadCache slab_thread_cache_exited;
+#endif  /* USE_THREAD_CACHE */
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Central Free Lists
+ * \{ */
+
+MEM_INLINE void update_maximum(size_t *maximum_value, size_t value)
+{
+	size_t prev_value = *maximum_value;
+	while (prev_value < value) {
+		const size_t prev_value_test = atomic_cas_z(maximum_value, prev_value, value);
+		if (prev_value_test == prev_value) {
+			break;
+		}
+		prev_value = prev_value_test;
+	}
+}
+
+MEM_INLINE void slab_class_lock(MemSlabClass *slab_class)
+{
+	while (atomic_cas_u(&slab_class->lock, 0, 1) != 0) {
+		/* pass */
+	}
+}
+
+MEM_INLINE void slab_class_unlock(MemSlabClass *slab_class)
+{
+	atomic_cas_u(&slab_class->lock, 1, 0);
+}
+
+MEM_INLINE unsigned int slab_class_index(size_t chunk_len)
+{
+	if (chunk_len <= SLAB_CLASS_SMALL_MAX) {
+		return (unsigned int)((chunk_len + 15) >> 4) - 1;
+	}
+	return (SLAB_CLASS_SMALL_MAX / 16) + (unsigned int)((chunk_len - SLAB_CLASS_SMALL_MAX + 63) >> 6) - 1;
+}
+
+MEM_INLINE size_t slab_class_chunk_len(unsigned int class_index)
+{
+	if (class_index < SLAB_CLASS_SMALL_MAX / 16) {
+		return (size_t)(class_index + 1) * 16;
+	}
+	return SLAB_CLASS_SMALL_MAX + (size_t)(class_index + 1 - SLAB_CLASS_SMALL_MAX / 16) * 64;
+}
+
+/**
+ * Move up to \a fetch_num free chunks from the central free list into \a r_free,
+ * carving new chunks from pages when needed.
+ *
+ * \return the number of chunks.
+ */
+static unsigned int slab_class_fetch(unsigned int class_index, const unsigned int fetch_num, MemSlabFree **r_free)
+{
+	MemSlabClass *slab_class = &slab_classes[class_index];
+	const size_t chunk_len = slab_class_chunk_len(class_index);
+	MemSlabFree *free_list = NULL;
+	unsigned int free_num = 0;
+
+	slab_class_lock(slab_class);
+
+	while (slab_class->free && free_num < fetch_num) {
+		MemSlabFree *chunk = slab_class->free;
+		slab_class->free = chunk->next;
+		chunk->next = free_list;
+		free_list = chunk;
+		free_num++;
+	}
+
+	while (free_num < fetch_num) {
+		MemSlabFree *chunk;
+		if (slab_class->page_cur + chunk_len > slab_class->page_end) {
+			char *page = malloc(SLAB_PAGE_SIZE);
+			if (UNLIKELY(page == NULL)) {
+				break;
+			}
+			atomic_add_and_fetch_z(&slab_pages_len, SLAB_PAGE_SIZE);
+			slab_class->page_cur = page;
+			slab_class->page_end = page + SLAB_PAGE_SIZE;
+		}
+		chunk = (MemSlabFree *)slab_class->page_cur;
+		slab_class->page_cur += chunk_len;
+		chunk->next = free_list;
+		free_list = chunk;
+		free_num++;
+	}
+
+	slab_class_unlock(slab_class);
+
+	*r_free = free_list;
+	return free_num;
+}
+
+/* Return the chunks from \a free_first to \a free_last to the central free list. */
+static void slab_class_release(unsigned int class_index, MemSlabFree *free_first, MemSlabFree *free_last)
+{
+	MemSlabClass *slab_class = &slab_classes[class_index];
+
+	slab_class_lock(slab_class);
+	free_last->next = slab_class->free;
+	slab_class->free = free_first;
+	slab_class_unlock(slab_class);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Thread Caches
+ * \{ */
+
+#ifdef USE_THREAD_CACHE
+static void slab_thread_cache_free(void *cache_v)
+{
+	MemSlabThreadCache *cache = cache_v;
+	unsigned int class_index;
+
+	if (cache == &slab_thread_cache_exited) {
+		/* Only reached on Apple, where setting the marker below runs the destructor again. */
+		SLAB_THREAD_CACHE_SET(&slab_thread_cache_exited);
+		return;
+	}
+
+	/* Clear before freeing, destructors of other keys may still allocate on this thread. */
+	SLAB_THREAD_CACHE_SET(&slab_thread_cache_exited);
+
+	for (class_index = 0; class_index < SLAB_CLASS_NUM; class_index++) {
+		MemSlabFree *free_first = cache->free[class_index];
+		if (free_first) {
+			MemSlabFree *free_last = free_first;
+			while (free_last->next) {
+				free_last = free_last->next;
+			}
+			slab_class_release(class_index, free_first, free_last);
+		}
+	}
+	free(cache);
+}
+#endif
+
+/* Return the cache of this thread, NULL when blocks must use the central free lists. */
+static MemSlabThreadCache *slab_thread_cache_ensure(void)
+{
+#ifdef USE_THREAD_CACHE
+	MemSlabThreadCache *cache;
+
+#ifdef __APPLE__
+	pthread_once(&slab_thread_cache_key_once, slab_thread_cache_key_create);
+#endif
+
+	cache = SLAB_THREAD_CACHE_GET();
+	if (UNLIKELY(cache == NULL)) {
+		cache = calloc(1, sizeof(*cache));
+		if (UNLIKELY(cache == NULL)) {
+			return NULL;
+		}
+		pthread_once(&slab_thread_cache_key_once, slab_thread_cache_key_create);
+		pthread_setspecific(slab_thread_cache_key, cache);
+		SLAB_THREAD_CACHE_SET(cache);
+	}
+	else if (UNLIKELY(cache == &slab_thread_cache_exited)) {
+		return NULL;
+	}
+	return cache;
+#else
+	return NULL;
+#endif
+}
+
+MEM_INLINE void *slab_chunk_alloc(size_t len)
+{
+	const unsigned int class_index = slab_class_index(len + sizeof(MemHead));
+	MemSlabThreadCache *cache = slab_thread_cache_ensure();
+	MemSlabFree *chunk;
+	MemHead *memh;
+
+	if (UNLIKELY(cache == NULL)) {
+		if (slab_class_fetch(class_index, 1, &chunk) == 0) {
+			return NULL;
+		}
+	}
+	else {
+		if (UNLIKELY(cache->free[class_index] == NULL)) {
+			cache->free_num[class_index] = slab_class_fetch(class_index, SLAB_BATCH_SIZE, &cache->free[class_index]);
+			if (UNLIKELY(cache->free[class_index] == NULL)) {
+				return NULL;
+			}
+		}
+
+		chunk = cache->free[class_index];
+		cache->free[class_index] = chunk->next;
+		cache->free_num[class_index]--;
+	}
+
+	memh = (MemHead *)chunk;
+	memh->len = len | MEMHEAD_SLAB_FLAG;
+
+	atomic_add_and_fetch_u(&totblock, 1);
+	update_maximum(&peak_mem, atomic_add_and_fetch_z(&mem_in_use, len));
+
+	return PTR_FROM_MEMHEAD(memh);
+}
+
+MEM_INLINE void slab_chunk_free(MemHead *memh)
+{
+	const size_t len = memh->len & ~MEMHEAD_SLAB_FLAG;
+	const unsigned int class_index = slab_class_index(len + sizeof(MemHead));
+	MemSlabThreadCache *cache = slab_thread_cache_ensure();
+	MemSlabFree *chunk = (MemSlabFree *)memh;
+
+	atomic_sub_and_fetch_u(&totblock, 1);
+	atomic_sub_and_fetch_z(&mem_in_use, len);
+
+	if (UNLIKELY(malloc_debug_memset && len)) {
+		memset(memh + 1, 255, len);
+	}
+
+	if (UNLIKELY(cache == NULL)) {
+		slab_class_release(class_index, chunk, chunk);
+		return;
+	}
+
+	chunk->next = cache->free[class_index];
+	cache->free[class_index] = chunk;
+	cache->free_num[class_index]++;
+
+	if (UNLIKELY(cache->free_num[class_index] > SLAB_CACHE_MAX)) {
+		/* Give a batch back, so memory freed by one thread can be used by others. */
+		MemSlabFree *free_first = cache->free[class_index];
+		MemSlabFree *free_last = free_first;
+		unsigned int i;
+		for (i = 1; i < SLAB_BATCH_SIZE; i++) {
+			free_last = free_last->next;
+		}
+		cache->free[class_index] = free_last->next;
+		cache->free_num[class_index] -= SLAB_BATCH_SIZE;
+		slab_class_release(class_index, free_first, free_last);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Allocator Callbacks
+ * \{ */
+
+size_t MEM_slab_allocN_len(const void *vmemh)
+{
+	if (vmemh) {
+		const MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+		if (MEMHEAD_IS_SLAB(memh)) {
+			return memh->len & ~MEMHEAD_SLAB_FLAG;
+		}
+		return MEM_lockfree_allocN_len(vmemh);
+	}
+	else {
+		return 0;
+	}
+}
+
+void MEM_slab_freeN(void *vmemh)
+{
+	if (vmemh && MEMHEAD_IS_SLAB(MEMHEAD_FROM_PTR(vmemh))) {
+		slab_chunk_free(MEMHEAD_FROM_PTR(vmemh));
+	}
+	else {
+		MEM_lockfree_freeN(vmemh);
+	}
+}
+
+void *MEM_slab_dupallocN(const void *vmemh)
+{
+	void *newp = NULL;
+	if (vmemh) {
+		if (MEMHEAD_IS_SLAB(MEMHEAD_FROM_PTR(vmemh))) {
+			const size_t prev_size = MEM_slab_allocN_len(vmemh);
+			newp = MEM_slab_mallocN(prev_size, "dupli_malloc");
+			memcpy(newp, vmemh, prev_size);
+		}
+		else {
+			newp = MEM_lockfree_dupallocN(vmemh);
+		}
+	}
+	return newp;
+}
+
+void *MEM_slab_reallocN_id(void *vmemh, size_t len, const char *str)
+{
+	void *newp = NULL;
+
+	if (vmemh) {
+		const size_t old_len = MEM_slab_allocN_len(vmemh);
+
+		if (!MEMHEAD_IS_SLAB(MEMHEAD_FROM_PTR(vmemh))) {
+			/* Large, aligned and mapped blocks stay in the lock-free allocator. */
+			return MEM_lockfree_reallocN_id(vmemh, len, str);
+		}
+
+		newp = MEM_slab_mallocN(len, "realloc");
+		if (newp) {
+			memcpy(newp, vmemh, len < old_len ? len : old_len);
+		}
+		MEM_slab_freeN(vmemh);
+	}
+	else {
+		newp = MEM_slab_mallocN(len, str);
+	}
+
+	return newp;
+}
+
+void *MEM_slab_recallocN_id(void *vmemh, size_t len, const char *str)
+{
+	void *newp = NULL;
+
+	if (vmemh) {
+		const size_t old_len = MEM_slab_allocN_len(vmemh);
+
+		if (!MEMHEAD_IS_SLAB(MEMHEAD_FROM_PTR(vmemh))) {
+			return MEM_lockfree_recallocN_id(vmemh, len, str);
+		}
+
+		newp = MEM_slab_mallocN(len, "recalloc");
+		if (newp) {
+			if (len <= old_len) {
+				memcpy(newp, vmemh, len);
+			}
+			else {
+				memcpy(newp, vmemh, old_len);
+				memset((char *)newp + old_len, 0, MEM_slab_allocN_len(newp) - old_len);
+			}
+		}
+		MEM_slab_freeN(vmemh);
+	}
+	else {
+		newp = MEM_slab_callocN(len, str);
+	}
+
+	return newp;
+}
+
+void *MEM_slab_callocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (len + sizeof(MemHead) <= SLAB_CLASS_MAX) {
+		void *ptr = slab_chunk_alloc(len);
+		if (LIKELY(ptr)) {
+			memset(ptr, 0, len);
+			return ptr;
+		}
+	}
+	return MEM_lockfree_callocN(len, str);
+}
+
+void *MEM_slab_mallocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (len + sizeof(MemHead) <= SLAB_CLASS_MAX) {
+		void *ptr = slab_chunk_alloc(len);
+		if (LIKELY(ptr)) {
+			if (UNLIKELY(malloc_debug_memset && len)) {
+				memset(ptr, 255, len);
+			}
+			return ptr;
+		}
+	}
+	return MEM_lockfree_mallocN(len, str);
+}
+
+void *MEM_slab_mallocN_aligned(size_t len, size_t alignment, const char *str)
+{
+	return MEM_lockfree_mallocN_aligned(len, alignment, str);
+}
+
+void *MEM_slab_mapallocN(size_t len, const char *str)
+{
+	return MEM_lockfree_mapallocN(len, str);
+}
+
+void MEM_slab_printmemlist_stats(void)
+{
+	MEM_lockfree_printmemlist_stats();
+
+	printf("\nsmall blocks memory len: %.3f MB (%u blocks)\n",
+	       (double)mem_in_use / (double)(1024 * 1024), totblock);
+	printf("small blocks peak memory len: %.3f MB\n",
+	       (double)peak_mem / (double)(1024 * 1024));
+	printf("small blocks pages len: %.3f MB\n",
+	       (double)slab_pages_len / (double)(1024 * 1024));
+}
+
+void MEM_slab_set_memory_debug(void)
+{
+	malloc_debug_memset = true;
+	MEM_lockfree_set_memory_debug();
+}
+
+size_t MEM_slab_get_memory_in_use(void)
+{
+	return MEM_lockfree_get_memory_in_use() + mem_in_use;
+}
+
+unsigned int MEM_slab_get_memory_blocks_in_use(void)
+{
+	return MEM_lockfree_get_memory_blocks_in_use() + totblock;
+}
+
+void MEM_slab_reset_peak_memory(void)
+{
+	MEM_lockfree_reset_peak_memory();
+	peak_mem = mem_in_use;
+}
+
+/* Upper bound, the peaks of small and large blocks may not have happened at the same time. */
+size_t MEM_slab_get_peak_memory(void)
+{
+	return MEM_lockfree_get_peak_memory() + peak_mem;
+}
+
+/** \} */
+
+void MEM_use_slab_allocator(void)
+{
+	MEM_allocN_len = MEM_slab_allocN_len;
+	MEM_freeN = MEM_slab_freeN;
+	MEM_dupallocN = MEM_slab_dupallocN;
+	MEM_reallocN_id = MEM_slab_reallocN_id;
+	MEM_recallocN_id = MEM_slab_recallocN_id;
+	MEM_callocN = MEM_slab_callocN;
+	MEM_mallocN = MEM_slab_mallocN;
+	MEM_mallocN_aligned = MEM_slab_mallocN_aligned;
+	MEM_mapallocN = MEM_slab_mapallocN;
+	MEM_printmemlist_stats = MEM_slab_printmemlist_stats;
+	MEM_set_memory_debug = MEM_slab_set_memory_debug;
+	MEM_get_memory_in_use = MEM_slab_get_memory_in_use;
+	MEM_get_memory_blocks_in_use = MEM_slab_get_memory_blocks_in_use;
+	MEM_reset_peak_memory = MEM_slab_reset_peak_memory;
+	MEM_get_peak_memory = MEM_slab_get_peak_memory;
+}
@@ -93,6 +93,7 @@ struct MLoopNorSpaceArray;
 struct BMEditMesh;
 struct KeyBlock;
 struct ModifierData;
+struct CDMaskLink;
 struct MCol;
 struct ColorBand;
 struct GPUVertexAttribs;
@@ -806,6 +807,23 @@ void DM_set_object_boundbox(struct Object *ob, DerivedMesh *dm);
 
 void DM_init_origspace(DerivedMesh *dm);
 
+/* modifier_stack_cache.c */
+typedef struct DMStackCachePoint {
+	struct ModifierData *md;
+	struct CDMaskLink *link;
+	uint64_t key;
+} DMStackCachePoint;
+
+int DM_stack_cache_points_find(
+        struct Scene *scene, struct Object *ob, struct ModifierData *md, struct CDMaskLink *link,
+        const float (*vertCos)[3], int numVerts, CustomDataMask dataMask, int app_flags, int required_mode,
+        DMStackCachePoint *r_points, int max_points);
+bool DM_stack_cache_modifier_is_cacheable(struct Object *ob, struct ModifierData *md);
+DerivedMesh *DM_stack_cache_lookup(struct ModifierData *md, uint64_t key);
+void DM_stack_cache_store(struct ModifierData *md, uint64_t key, DerivedMesh *dm);
+void DM_stack_cache_free_modifier(struct ModifierData *md);
+void DM_stack_cache_free_all(void);
+
 /* debug only */
 #ifndef NDEBUG
 char *DM_debug_info(DerivedMesh *dm);
@@ -304,6 +304,8 @@ CCGSubSurf *ccgSubSurf_new(CCGMeshIFC *ifc, int subdivLevels, CCGAllocatorIFC *a
 		ss->tempVerts = NULL;
 		ss->tempEdges = NULL;
 
+		ss->topologyHash = 0;
+
 #ifdef WITH_OPENSUBDIV
 		ss->osd_evaluator = NULL;
 		ss->osd_mesh = NULL;
@@ -317,6 +319,7 @@ CCGSubSurf *ccgSubSurf_new(CCGMeshIFC *ifc, int subdivLevels, CCGAllocatorIFC *a
 		ss->osd_coarse_coords = NULL;
 		ss->osd_num_coarse_coords = 0;
 		ss->osd_subdiv_uvs = false;
+		ss->osd_topology_hash = 0;
 #endif
 
 		return ss;
@@ -411,6 +414,7 @@ CCGError ccgSubSurf_setSubdivisionLevels(CCGSubSurf *ss, int subdivisionLevels)
 		ss->vMap = ccg_ehash_new(0, &ss->allocatorIFC, ss->allocator);
 		ss->eMap = ccg_ehash_new(0, &ss->allocatorIFC, ss->allocator);
 		ss->fMap = ccg_ehash_new(0, &ss->allocatorIFC, ss->allocator);
+		ss->topologyHash = 0;
 	}
 
 	return eCCGError_None;
@@ -479,6 +483,16 @@ void ccgSubSurf_setNumLayers(CCGSubSurf *ss, int numLayers)
 	ss->meshIFC.numLayers = numLayers;
 }
 
+void ccgSubSurf_setTopologyHash(CCGSubSurf *ss, uint64_t topologyHash)
+{
+	ss->topologyHash = topologyHash;
+}
+
+uint64_t ccgSubSurf_getTopologyHash(const CCGSubSurf *ss)
+{
+	return ss->topologyHash;
+}
+
 /***/
 
 CCGError ccgSubSurf_initFullSync(CCGSubSurf *ss)
@@ -498,6 +512,7 @@ CCGError ccgSubSurf_initFullSync(CCGSubSurf *ss)
 	ss->fMap = ccg_ehash_new(0, &ss->allocatorIFC, ss->allocator);
 
 	ss->numGrids = 0;
+	ss->topologyHash = 0;
 
 	ss->lenTempArrays = 12;
 	ss->tempVerts = MEM_mallocN(sizeof(*ss->tempVerts) * ss->lenTempArrays, "CCGSubsurf tempVerts");
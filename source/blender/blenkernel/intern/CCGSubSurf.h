@@ -71,7 +71,13 @@ typedef enum {
 
 /***/
 
+/* Minimum amount of grid points to use OpenMP threads for (still used by multires). */
 #define CCG_OMP_LIMIT	1000000
+/* Minimum amount of grid points to use task threads for. The task scheduler's threads are
+ * already running, so a parallel range only has to wake them (where OpenMP loops may have
+ * to start a thread team). 16k points is in the order of a tenth of a millisecond of
+ * subdivision stencils, enough work for that to pay off while smaller meshes stay single threaded. */
+#define CCG_TASK_LIMIT	16384
 
 /***/
 
@@ -113,6 +119,11 @@ void		ccgSubSurf_setAllocMask				(CCGSubSurf *ss, int allocMask, int maskOffset)
 
 void		ccgSubSurf_setNumLayers				(CCGSubSurf *ss, int numLayers);
 
+/* Caller defined fingerprint of the topology synced by the last full sync, zero when unknown.
+ * Reset by every full sync and by changing subdivision levels. */
+void		ccgSubSurf_setTopologyHash			(CCGSubSurf *ss, uint64_t topologyHash);
+uint64_t	ccgSubSurf_getTopologyHash			(const CCGSubSurf *ss);
+
 /***/
 
 int			ccgSubSurf_getNumVerts				(const CCGSubSurf *ss);
@@ -196,8 +207,13 @@ void				ccgFaceIterator_next		(CCGFaceIterator *fi);
 #ifdef WITH_OPENSUBDIV
 struct DerivedMesh;
 
-/* Check if topology changed and evaluators are to be re-created. */
-void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, struct DerivedMesh *dm);
+/* Check if topology changed and evaluators are to be re-created.
+ *
+ * topology_hash is a fingerprint of the derived mesh topology, when it matches
+ * the one of the previous check the slow per-element comparison is skipped.
+ * Pass zero when it is not known.
+ */
+void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, struct DerivedMesh *dm, uint64_t topology_hash);
 
 /* Create topology refiner from give derived mesh which then later will be
  * used for GL mesh creation.
@@ -231,6 +231,12 @@ BLI_INLINE void VertDataZero(float v[], const CCGSubSurf *ss)
 BLI_INLINE void VertDataCopy(float dst[], const float src[], const CCGSubSurf *ss)
 {
 	int i;
+	if (ss->meshIFC.numLayers == 3) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		return;
+	}
 	for (i = 0; i < ss->meshIFC.numLayers; i++)
 		dst[i] = src[i];
 }
@@ -238,6 +244,12 @@ BLI_INLINE void VertDataCopy(float dst[], const float src[], const CCGSubSurf *s
 BLI_INLINE void VertDataAdd(float a[], const float b[], const CCGSubSurf *ss)
 {
 	int i;
+	if (ss->meshIFC.numLayers == 3) {
+		a[0] += b[0];
+		a[1] += b[1];
+		a[2] += b[2];
+		return;
+	}
 	for (i = 0; i < ss->meshIFC.numLayers; i++)
 		a[i] += b[i];
 }
@@ -262,6 +274,13 @@ BLI_INLINE void VertDataAvg4(float v[],
                              const CCGSubSurf *ss)
 {
 	int i;
+	/* Coordinates only is by far the most common case, let the compiler keep it branch free. */
+	if (ss->meshIFC.numLayers == 3) {
+		v[0] = (a[0] + b[0] + c[0] + d[0]) * 0.25f;
+		v[1] = (a[1] + b[1] + c[1] + d[1]) * 0.25f;
+		v[2] = (a[2] + b[2] + c[2] + d[2]) * 0.25f;
+		return;
+	}
 	for (i = 0; i < ss->meshIFC.numLayers; i++)
 		v[i] = (a[i] + b[i] + c[i] + d[i]) * 0.25f;
 }
@@ -207,6 +207,9 @@ struct CCGSubSurf {
 	CCGVert **tempVerts;
 	CCGEdge **tempEdges;
 
+	/* Fingerprint of the topology in the maps, see ccgSubSurf_setTopologyHash(). */
+	uint64_t topologyHash;
+
 #ifdef WITH_OPENSUBDIV
 	/* Skip grids means no CCG geometry is created and subsurf is possible
 	 * to be completely done on GPU.
@@ -254,6 +257,8 @@ struct CCGSubSurf {
 	 * to fill in PTex index of CCGFace.
 	 */
 	int osd_next_face_ptex_index;
+	/* Fingerprint of the topology used for the refiner, see ccgSubSurf_checkTopologyChanged(). */
+	uint64_t osd_topology_hash;
 
 	bool osd_subdiv_uvs;
 #endif
@@ -153,7 +153,7 @@ static bool compare_osd_derivedmesh_topology(CCGSubSurf *ss, DerivedMesh *dm)
 	return result;
 }
 
-static bool opensubdiv_is_topology_changed(CCGSubSurf *ss, DerivedMesh *dm)
+static bool opensubdiv_is_topology_changed(CCGSubSurf *ss, DerivedMesh *dm, uint64_t topology_hash)
 {
 	if (ss->osd_compute != U.opensubdiv_compute_type) {
 		return true;
@@ -175,6 +175,10 @@ static bool opensubdiv_is_topology_changed(CCGSubSurf *ss, DerivedMesh *dm)
 			return true;
 		}
 	}
+	/* Same topology as the previous check, skip the slow comparison. */
+	if (topology_hash != 0 && topology_hash == ss->osd_topology_hash) {
+		return false;
+	}
 	if (ss->skip_grids == false) {
 		return compare_ccg_derivedmesh_topology(ss, dm) == false;
 	}
@@ -184,9 +188,9 @@ static bool opensubdiv_is_topology_changed(CCGSubSurf *ss, DerivedMesh *dm)
 	return false;
 }
 
-void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, DerivedMesh *dm)
+void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, DerivedMesh *dm, uint64_t topology_hash)
 {
-	if (opensubdiv_is_topology_changed(ss, dm)) {
+	if (opensubdiv_is_topology_changed(ss, dm, topology_hash)) {
 		/* ** Make sure both GPU and CPU backends are properly reset. ** */
 
 		ss->osd_coarse_coords_invalid = true;
@@ -204,6 +208,8 @@ void ccgSubSurf_checkTopologyChanged(CCGSubSurf *ss, DerivedMesh *dm)
 			ss->osd_evaluator = NULL;
 		}
 	}
+
+	ss->osd_topology_hash = topology_hash;
 }
 
 static void ccgSubSurf__updateGLMeshCoords(CCGSubSurf *ss)
@@ -1722,6 +1722,9 @@ static void dm_ensure_display_normals(DerivedMesh *dm)
 	}
 }
 
+/* Maximum number of intermediate results of one stack looked up in the cache. */
+#define STACK_CACHE_MAX_POINTS 8
+
 /**
  * new value for useDeform -1  (hack for the gameengine):
  *
@@ -1769,6 +1772,13 @@ static void mesh_calc_modifiers(
 	const bool do_loop_normals = (me->flag & ME_AUTOSMOOTH) != 0;
 	const float loop_normals_split_angle = me->smoothresh;
 
+	/* Only the regular viewport evaluation uses the stack cache, see modifier_stack_cache.c */
+	const bool use_stack_cache = (useCache && !useRenderParams && useDeform > 0 && index == -1 &&
+	                              !need_mapping && !sculpt_mode && !do_init_wmcol && !build_shapekey_layers &&
+	                              inputVertexCos == NULL);
+	DMStackCachePoint cache_points[STACK_CACHE_MAX_POINTS];
+	int cache_points_num = 0, cache_point = 0;
+
 	VirtualModifierData virtualModifierData;
 
 	ModifierApplyFlag app_flags = useRenderParams ? MOD_APPLY_RENDER : 0;
@@ -1883,6 +1893,32 @@ static void mesh_calc_modifiers(
 	orcodm = NULL;
 	clothorcodm = NULL;
 
+	if (use_stack_cache && previewmd == NULL) {
+		int i;
+
+		cache_points_num = DM_stack_cache_points_find(
+		        scene, ob, md, curr, (const float (*)[3])deformedVerts, numVerts, dataMask, app_flags, required_mode,
+		        cache_points, ARRAY_SIZE(cache_points));
+
+		/* Continue after the last modifier whose result is still cached. */
+		for (i = cache_points_num - 1; i >= 0; i--) {
+			DerivedMesh *cache_dm = DM_stack_cache_lookup(cache_points[i].md, cache_points[i].key);
+
+			if (cache_dm) {
+				dm = cache_dm;
+				md = cache_points[i].md->next;
+				curr = cache_points[i].link->next;
+				cache_point = i + 1;
+
+				if (deformedVerts) {
+					MEM_freeN(deformedVerts);
+					deformedVerts = NULL;
+				}
+				break;
+			}
+		}
+	}
+
 	for (; md; md = md->next, curr = curr->next) {
 		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
 
@@ -2074,6 +2110,13 @@ static void mesh_calc_modifiers(
 				}
 			}
 
+			if ((cache_point < cache_points_num) && (md == cache_points[cache_point].md)) {
+				if (md->error == NULL) {
+					DM_stack_cache_store(md, cache_points[cache_point].key, dm);
+				}
+				cache_point++;
+			}
+
 			/* create an orco derivedmesh in parallel */
 			if (nextmask & CD_MASK_ORCO) {
 				if (!orcodm)
@@ -107,6 +107,7 @@ static int read_undosave(bContext *C, UndoElem *uel)
 	fileflags = G.fileflags;
 	G.fileflags |= G_FILE_NO_UI;
 
+	/* Reads all IDs back, runtime data of unchanged IDs is not kept but rebuilt. */
 	if (UNDO_DISK)
 		success = (BKE_blendfile_read(C, uel->str, NULL, 0) != BKE_BLENDFILE_READ_FAIL);
 	else
@@ -194,6 +195,7 @@ void BKE_undo_write(bContext *C, const char *name)
 
 		if (curundo->prev) prevfile = &(curundo->prev->memfile);
 
+		/* Every ID is written again, unchanged ones only share their chunks with prevfile. */
 		memused = MEM_get_memory_in_use();
 		/* success = */ /* UNUSED */ BLO_write_file_mem(CTX_data_main(C), prevfile, &curundo->memfile, G.fileflags);
 		curundo->undosize = MEM_get_memory_in_use() - memused;
@@ -2842,6 +2842,30 @@ void CustomData_bmesh_copy_data(const CustomData *source, CustomData *dest,
 	const LayerTypeInfo *typeInfo;
 	int dest_i, src_i;
 
+	if (source == dest) {
+		/* Same layout (copying within a single BMesh, the common case),
+		 * copy the whole block at once, layers which own allocated data make their own copy after. */
+		int i;
+
+		if (*dest_block == NULL) {
+			CustomData_bmesh_alloc_block(dest, dest_block);
+			if (*dest_block == NULL) {
+				return;
+			}
+		}
+
+		memcpy(*dest_block, src_block, (size_t)source->totsize);
+
+		for (i = 0; i < source->totlayer; i++) {
+			typeInfo = layerType_getInfo(source->layers[i].type);
+			if (typeInfo->copy) {
+				const int offset = source->layers[i].offset;
+				typeInfo->copy(POINTER_OFFSET(src_block, offset), POINTER_OFFSET(*dest_block, offset), 1);
+			}
+		}
+		return;
+	}
+
 	if (*dest_block == NULL) {
 		CustomData_bmesh_alloc_block(dest, dest_block);
 		if (*dest_block)
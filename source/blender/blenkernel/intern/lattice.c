@@ -40,6 +40,7 @@
 #include "BLI_listbase.h"
 #include "BLI_bitmap.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -335,6 +336,9 @@ void BKE_lattice_make_local(Main *bmain, Lattice *lt, const bool lib_local)
 typedef struct LatticeDeformData {
 	Object *object;
 	float *latticedata;
+	/* Weight of the lattice vertex group for each lattice point, NULL when
+	 * the lattice has no vertex group assigned. */
+	float *lattice_weights;
 	float latmat[4][4];
 } LatticeDeformData;
 
@@ -349,13 +353,28 @@ LatticeDeformData *init_latt_deform(Object *oblatt, Object *ob)
 	float fu, fv, fw;
 	int u, v, w;
 	float *latticedata;
+	float *lattice_weights = NULL;
 	float latmat[4][4];
 	LatticeDeformData *lattice_deform_data;
+	MDeformVert *dvert = BKE_lattice_deform_verts_get(oblatt);
 
 	if (lt->editlatt) lt = lt->editlatt->latt;
 	bp = lt->def;
 	
 	fp = latticedata = MEM_mallocN(sizeof(float) * 3 * lt->pntsu * lt->pntsv * lt->pntsw, "latticedata");
+
+	/* vgroup influence, looked up once instead of for every deformed vertex */
+	if (lt->vgroup[0] && dvert) {
+		const int defgrp_index = defgroup_name_index(oblatt, lt->vgroup);
+		if (defgrp_index != -1) {
+			const int totpoint = lt->pntsu * lt->pntsv * lt->pntsw;
+			int i;
+			lattice_weights = MEM_mallocN(sizeof(float) * totpoint, "lattice_weights");
+			for (i = 0; i < totpoint; i++) {
+				lattice_weights[i] = defvert_find_weight(dvert + i, defgrp_index);
+			}
+		}
+	}
 	
 	/* for example with a particle system: (ob == NULL) */
 	if (ob == NULL) {
@@ -395,6 +414,7 @@ LatticeDeformData *init_latt_deform(Object *oblatt, Object *ob)
 
 	lattice_deform_data = MEM_mallocN(sizeof(LatticeDeformData), "Lattice Deform Data");
 	lattice_deform_data->latticedata = latticedata;
+	lattice_deform_data->lattice_weights = lattice_weights;
 	lattice_deform_data->object = oblatt;
 	copy_m4_m4(lattice_deform_data->latmat, latmat);
 
@@ -411,16 +431,14 @@ void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float
 	int ui, vi, wi, uu, vv, ww;
 
 	/* vgroup influence */
-	int defgrp_index = -1;
+	const float *lattice_weights = lattice_deform_data->lattice_weights;
 	float co_prev[3], weight_blend = 0.0f;
-	MDeformVert *dvert = BKE_lattice_deform_verts_get(ob);
 
 
 	if (lt->editlatt) lt = lt->editlatt->latt;
 	if (lattice_deform_data->latticedata == NULL) return;
 
-	if (lt->vgroup[0] && dvert) {
-		defgrp_index = defgroup_name_index(ob, lt->vgroup);
+	if (lattice_weights) {
 		copy_v3_v3(co_prev, co);
 	}
 
@@ -500,8 +518,8 @@ void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float
 
 							madd_v3_v3fl(co, &lattice_deform_data->latticedata[idx_u * 3], u);
 
-							if (defgrp_index != -1)
-								weight_blend += (u * defvert_find_weight(dvert + idx_u, defgrp_index));
+							if (lattice_weights)
+								weight_blend += (u * lattice_weights[idx_u]);
 						}
 					}
 				}
@@ -509,7 +527,7 @@ void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float
 		}
 	}
 
-	if (defgrp_index != -1)
+	if (lattice_weights)
 		interp_v3_v3v3(co, co_prev, co, weight_blend);
 
 }
@@ -518,6 +536,8 @@ void end_latt_deform(LatticeDeformData *lattice_deform_data)
 {
 	if (lattice_deform_data->latticedata)
 		MEM_freeN(lattice_deform_data->latticedata);
+	if (lattice_deform_data->lattice_weights)
+		MEM_freeN(lattice_deform_data->lattice_weights);
 
 	MEM_freeN(lattice_deform_data);
 }
@@ -698,6 +718,46 @@ static bool calc_curve_deform(Scene *scene, Object *par, float co[3],
 	return false;
 }
 
+typedef struct CurveDeformUserdata {
+	Scene *scene;
+	Object *cuOb;
+	CurveDeform *cd;
+	float (*vertexCos)[3];
+	MDeformVert *dvert;
+	int defgrp_index;
+	short defaxis;
+	bool in_curvespace;
+} CurveDeformUserdata;
+
+static void curve_deform_vert_task(void *userdata, int a)
+{
+	const CurveDeformUserdata *data = userdata;
+	float *co = data->vertexCos[a];
+
+	if (data->dvert) {
+		const float weight = defvert_find_weight(&data->dvert[a], data->defgrp_index);
+
+		if (weight > 0.0f) {
+			float vec[3];
+
+			if (!data->in_curvespace) {
+				mul_m4_v3(data->cd->curvespace, co);
+			}
+			copy_v3_v3(vec, co);
+			calc_curve_deform(data->scene, data->cuOb, vec, data->defaxis, data->cd, NULL);
+			interp_v3_v3v3(co, co, vec, weight);
+			mul_m4_v3(data->cd->objectspace, co);
+		}
+	}
+	else {
+		if (!data->in_curvespace) {
+			mul_m4_v3(data->cd->curvespace, co);
+		}
+		calc_curve_deform(data->scene, data->cuOb, co, data->defaxis, data->cd, NULL);
+		mul_m4_v3(data->cd->objectspace, co);
+	}
+}
+
 void curve_deform_verts(
         Scene *scene, Object *cuOb, Object *target, DerivedMesh *dm, float (*vertexCos)[3],
         int numVerts, const char *vgroup, short defaxis)
@@ -747,71 +807,32 @@ void curve_deform_verts(
 		}
 	}
 
-	if (dvert) {
-		MDeformVert *dvert_iter;
-		float vec[3];
-
-		if (cu->flag & CU_DEFORM_BOUNDS_OFF) {
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				const float weight = defvert_find_weight(dvert_iter, defgrp_index);
-
-				if (weight > 0.0f) {
-					mul_m4_v3(cd.curvespace, vertexCos[a]);
-					copy_v3_v3(vec, vertexCos[a]);
-					calc_curve_deform(scene, cuOb, vec, defaxis, &cd, NULL);
-					interp_v3_v3v3(vertexCos[a], vertexCos[a], vec, weight);
-					mul_m4_v3(cd.objectspace, vertexCos[a]);
-				}
-			}
-		}
-		else {
-			/* set mesh min/max bounds */
-			INIT_MINMAX(cd.dmin, cd.dmax);
-
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				if (defvert_find_weight(dvert_iter, defgrp_index) > 0.0f) {
-					mul_m4_v3(cd.curvespace, vertexCos[a]);
-					minmax_v3v3_v3(cd.dmin, cd.dmax, vertexCos[a]);
-				}
-			}
+#ifdef CYCLIC_DEPENDENCY_WORKAROUND
+	/* done once here, calc_curve_deform() must not do it from the threads */
+	if (cuOb->curve_cache == NULL) {
+		BKE_displist_make_curveTypes(scene, cuOb, false);
+	}
+#endif
 
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				const float weight = defvert_find_weight(dvert_iter, defgrp_index);
+	if ((cu->flag & CU_DEFORM_BOUNDS_OFF) == 0) {
+		/* set mesh min/max bounds */
+		INIT_MINMAX(cd.dmin, cd.dmax);
 
-				if (weight > 0.0f) {
-					/* already in 'cd.curvespace', prev for loop */
-					copy_v3_v3(vec, vertexCos[a]);
-					calc_curve_deform(scene, cuOb, vec, defaxis, &cd, NULL);
-					interp_v3_v3v3(vertexCos[a], vertexCos[a], vec, weight);
-					mul_m4_v3(cd.objectspace, vertexCos[a]);
-				}
-			}
-		}
-	}
-	else {
-		if (cu->flag & CU_DEFORM_BOUNDS_OFF) {
-			for (a = 0; a < numVerts; a++) {
-				mul_m4_v3(cd.curvespace, vertexCos[a]);
-				calc_curve_deform(scene, cuOb, vertexCos[a], defaxis, &cd, NULL);
-				mul_m4_v3(cd.objectspace, vertexCos[a]);
-			}
-		}
-		else {
-			/* set mesh min max bounds */
-			INIT_MINMAX(cd.dmin, cd.dmax);
-				
-			for (a = 0; a < numVerts; a++) {
+		for (a = 0; a < numVerts; a++) {
+			if (dvert == NULL || defvert_find_weight(&dvert[a], defgrp_index) > 0.0f) {
 				mul_m4_v3(cd.curvespace, vertexCos[a]);
 				minmax_v3v3_v3(cd.dmin, cd.dmax, vertexCos[a]);
 			}
-	
-			for (a = 0; a < numVerts; a++) {
-				/* already in 'cd.curvespace', prev for loop */
-				calc_curve_deform(scene, cuOb, vertexCos[a], defaxis, &cd, NULL);
-				mul_m4_v3(cd.objectspace, vertexCos[a]);
-			}
 		}
 	}
+
+	CurveDeformUserdata data = {
+	    .scene = scene, .cuOb = cuOb, .cd = &cd, .vertexCos = vertexCos,
+	    .dvert = dvert, .defgrp_index = defgrp_index, .defaxis = defaxis,
+	    /* bounds calculation already transformed the vertices */
+	    .in_curvespace = (cu->flag & CU_DEFORM_BOUNDS_OFF) == 0,
+	};
+	BLI_task_parallel_range(0, numVerts, &data, curve_deform_vert_task, numVerts > 1024);
 }
 
 /* input vec and orco = local coord in armature space */
@@ -849,12 +870,35 @@ void curve_deform_vector(Scene *scene, Object *cuOb, Object *target,
 
 }
 
+typedef struct LatticeDeformUserdata {
+	LatticeDeformData *lattice_deform_data;
+	float (*vertexCos)[3];
+	MDeformVert *dvert;
+	int defgrp_index;
+	float fac;
+} LatticeDeformUserdata;
+
+static void lattice_deform_vert_task(void *userdata, int index)
+{
+	const LatticeDeformUserdata *data = userdata;
+
+	if (data->dvert != NULL) {
+		const float weight = defvert_find_weight(data->dvert + index, data->defgrp_index);
+		if (weight > 0.0f) {
+			calc_latt_deform(data->lattice_deform_data, data->vertexCos[index], weight * data->fac);
+		}
+	}
+	else {
+		calc_latt_deform(data->lattice_deform_data, data->vertexCos[index], data->fac);
+	}
+}
+
 void lattice_deform_verts(Object *laOb, Object *target, DerivedMesh *dm,
                           float (*vertexCos)[3], int numVerts, const char *vgroup, float fac)
 {
 	LatticeDeformData *lattice_deform_data;
-	int a;
-	bool use_vgroups;
+	MDeformVert *dvert = NULL;
+	int defgrp_index = -1;
 
 	if (laOb->type != OB_LATTICE)
 		return;
@@ -868,40 +912,29 @@ void lattice_deform_verts(Object *laOb, Object *target, DerivedMesh *dm,
 	if (target && target->type == OB_MESH) {
 		/* if there's derived data without deformverts, don't use vgroups */
 		if (dm) {
-			use_vgroups = (dm->getVertDataArray(dm, CD_MDEFORMVERT) != NULL);
+			dvert = dm->getVertDataArray(dm, CD_MDEFORMVERT);
 		}
 		else {
-			Mesh *me = target->data;
-			use_vgroups = (me->dvert != NULL);
+			dvert = ((Mesh *)target->data)->dvert;
 		}
 	}
-	else {
-		use_vgroups = false;
-	}
-	
-	if (vgroup && vgroup[0] && use_vgroups) {
-		Mesh *me = target->data;
-		const int defgrp_index = defgroup_name_index(target, vgroup);
-		float weight;
-
-		if (defgrp_index >= 0 && (me->dvert || dm)) {
-			MDeformVert *dvert = me->dvert;
-			
-			for (a = 0; a < numVerts; a++, dvert++) {
-				if (dm) dvert = dm->getVertData(dm, a, CD_MDEFORMVERT);
 
-				weight = defvert_find_weight(dvert, defgrp_index);
-
-				if (weight > 0.0f)
-					calc_latt_deform(lattice_deform_data, vertexCos[a], weight * fac);
-			}
-		}
+	if (vgroup && vgroup[0] && dvert) {
+		defgrp_index = defgroup_name_index(target, vgroup);
 	}
 	else {
-		for (a = 0; a < numVerts; a++) {
-			calc_latt_deform(lattice_deform_data, vertexCos[a], fac);
-		}
+		dvert = NULL;
+	}
+
+	/* a vertex group which doesn't exist deforms nothing */
+	if (dvert == NULL || defgrp_index != -1) {
+		LatticeDeformUserdata data = {
+		    .lattice_deform_data = lattice_deform_data, .vertexCos = vertexCos,
+		    .dvert = dvert, .defgrp_index = defgrp_index, .fac = fac,
+		};
+		BLI_task_parallel_range(0, numVerts, &data, lattice_deform_vert_task, numVerts > 1024);
 	}
+
 	end_latt_deform(lattice_deform_data);
 }
 
@@ -1214,6 +1214,201 @@ static void loop_split_generator(TaskPool *pool, LoopSplitTaskDataCommon *common
 #endif
 }
 
+typedef struct LoopSplitEdgeTaskData {
+	int (*edge_to_loops)[2];
+	unsigned int *edge_users;
+	int *loop_to_poly;
+	float (*loopnors)[3];
+
+	const MVert *mverts;
+	const MEdge *medges;
+	const MLoop *mloops;
+	const MPoly *mpolys;
+	const float (*polynors)[3];
+
+	float split_angle;
+	bool check_angle;
+} LoopSplitEdgeTaskData;
+
+/* First pass, per poly: map loops to their polys and edges to (up to two of) their loops. */
+static void loop_split_edge_users_task_cb(void *userdata, const int mp_index)
+{
+	LoopSplitEdgeTaskData *data = userdata;
+	const MPoly *mp = &data->mpolys[mp_index];
+	const MLoop *ml_curr = &data->mloops[mp->loopstart];
+	const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
+	int ml_curr_index;
+
+	for (ml_curr_index = mp->loopstart; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++) {
+		const unsigned int user = atomic_fetch_and_add_uint32(&data->edge_users[ml_curr->e], 1);
+
+		data->loop_to_poly[ml_curr_index] = mp_index;
+
+		/* Pre-populate all loop normals as if their verts were all-smooth, this way we don't have to compute
+		 * those later!
+		 */
+		normal_short_to_float_v3(data->loopnors[ml_curr_index], data->mverts[ml_curr->v].no);
+
+		if (user < 2) {
+			data->edge_to_loops[ml_curr->e][user] = ml_curr_index;
+		}
+	}
+}
+
+/* Second pass, per edge: check which edges are actually smooth.
+ * Gives the same edge_to_loops as a serial walk over all loops would: first loop, then second loop or sharp tag. */
+static void loop_split_edge_sharp_task_cb(void *userdata, const int me_index)
+{
+	LoopSplitEdgeTaskData *data = userdata;
+	int *e2l = data->edge_to_loops[me_index];
+	const MPoly *mpolys = data->mpolys;
+
+	switch (data->edge_users[me_index]) {
+		case 0:
+			/* Loose edge, both values stay 0. */
+			break;
+		case 1:
+			/* We have to check this here too, else we might miss some flat faces!!! */
+			e2l[1] = (mpolys[data->loop_to_poly[e2l[0]]].flag & ME_SMOOTH) ? INDEX_UNSET : INDEX_INVALID;
+			break;
+		case 2:
+		{
+			int mp_a, mp_b;
+
+			if (e2l[0] > e2l[1]) {
+				SWAP(int, e2l[0], e2l[1]);
+			}
+			mp_a = data->loop_to_poly[e2l[0]];
+			mp_b = data->loop_to_poly[e2l[1]];
+
+			/* An edge is sharp if it is tagged as such, or its face is not smooth,
+			 * or both poly have opposed (flipped) normals, i.e. both loops on the same edge share the same vertex,
+			 * or angle between both its polys' normals is above split_angle value.
+			 */
+			if (!(mpolys[mp_a].flag & ME_SMOOTH) || !(mpolys[mp_b].flag & ME_SMOOTH) ||
+			    (data->medges[me_index].flag & ME_SHARP) ||
+			    data->mloops[e2l[0]].v == data->mloops[e2l[1]].v ||
+			    (data->check_angle && dot_v3v3(data->polynors[mp_a], data->polynors[mp_b]) < data->split_angle))
+			{
+				e2l[1] = INDEX_INVALID;
+			}
+			break;
+		}
+		default:
+			/* More than two loops using this edge, always sharp. */
+			e2l[1] = INDEX_INVALID;
+			break;
+	}
+}
+
+/* Same as loop_split_generator_check_cyclic_smooth_fan(), but without shared state so that it can run
+ * for all loops in parallel: a cyclic smooth fan is only processed from its loop with the lowest index,
+ * which is also the one the serial generator would use as entry point. */
+static bool loop_split_check_cyclic_smooth_fan_entry(
+        const MLoop *mloops, const MPoly *mpolys,
+        const int (*edge_to_loops)[2], const int *loop_to_poly, const int *e2l_prev,
+        const MLoop *ml_curr, const MLoop *ml_prev, const int ml_curr_index, const int ml_prev_index,
+        const int mp_curr_index, const int numLoops)
+{
+	const unsigned int mv_pivot_index = ml_curr->v;  /* The vertex we are "fanning" around! */
+	const int *e2lfan_curr;
+	const MLoop *mlfan_curr;
+	/* mlfan_vert_index: the loop of our current edge might not be the loop of our current vertex! */
+	int mlfan_curr_index, mlfan_vert_index, mpfan_curr_index;
+	int i;
+
+	e2lfan_curr = e2l_prev;
+	if (IS_EDGE_SHARP(e2lfan_curr)) {
+		/* Sharp loop, so not a cyclic smooth fan... */
+		return false;
+	}
+
+	mlfan_curr = ml_prev;
+	mlfan_curr_index = ml_prev_index;
+	mlfan_vert_index = ml_curr_index;
+	mpfan_curr_index = mp_curr_index;
+
+	/* Only invalid geometry could make us walk more than all loops, avoid looping forever on it. */
+	for (i = 0; i < numLoops; i++) {
+		/* Find next loop of the smooth fan. */
+		loop_manifold_fan_around_vert_next(
+		            mloops, mpolys, loop_to_poly, e2lfan_curr, mv_pivot_index,
+		            &mlfan_curr, &mlfan_curr_index, &mlfan_vert_index, &mpfan_curr_index);
+
+		e2lfan_curr = edge_to_loops[mlfan_curr->e];
+
+		if (IS_EDGE_SHARP(e2lfan_curr)) {
+			/* Sharp loop/edge, so not a cyclic smooth fan... */
+			return false;
+		}
+		else if (mlfan_vert_index == ml_curr_index) {
+			/* We walked around a whole cyclic smooth fan without finding any lower loop index. */
+			return true;
+		}
+		else if (mlfan_vert_index < ml_curr_index) {
+			/* Another loop is the entry point of this fan (if it is cyclic at all). */
+			return false;
+		}
+	}
+
+	return false;
+}
+
+/* Parallel version of loop_split_generator(), only usable when no lnor spaces have to be created,
+ * since those are allocated from a non thread-safe memarena. Each fan is computed by the task
+ * handling the poly of its entry loop, all fans write to different loop normals. */
+static void loop_split_generator_task_cb(void *userdata, const int mp_index)
+{
+	LoopSplitTaskDataCommon *common_data = userdata;
+	float (*loopnors)[3] = common_data->loopnors;
+
+	const MLoop *mloops = common_data->mloops;
+	const MPoly *mpolys = common_data->mpolys;
+	const int *loop_to_poly = common_data->loop_to_poly;
+	const int (*edge_to_loops)[2] = common_data->edge_to_loops;
+
+	const MPoly *mp = &mpolys[mp_index];
+	const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
+	int ml_curr_index = mp->loopstart;
+	int ml_prev_index = ml_last_index;
+
+	const MLoop *ml_curr = &mloops[ml_curr_index];
+	const MLoop *ml_prev = &mloops[ml_prev_index];
+	float (*lnors)[3] = &loopnors[ml_curr_index];
+
+	BLI_assert(common_data->lnors_spacearr == NULL);
+
+	for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++, lnors++) {
+		const int *e2l_curr = edge_to_loops[ml_curr->e];
+		const int *e2l_prev = edge_to_loops[ml_prev->e];
+
+		if (IS_EDGE_SHARP(e2l_curr) ||
+		    loop_split_check_cyclic_smooth_fan_entry(
+		            mloops, mpolys, edge_to_loops, loop_to_poly, e2l_prev,
+		            ml_curr, ml_prev, ml_curr_index, ml_prev_index, mp_index, common_data->numLoops))
+		{
+			LoopSplitTaskData data = {NULL};
+
+			data.ml_curr = ml_curr;
+			data.ml_prev = ml_prev;
+			data.ml_curr_index = ml_curr_index;
+			data.mp_index = mp_index;
+			if (IS_EDGE_SHARP(e2l_curr) && IS_EDGE_SHARP(e2l_prev)) {
+				data.lnor = lnors;
+			}
+			else {
+				data.ml_prev_index = ml_prev_index;
+				data.e2l_prev = e2l_prev;  /* Also tag as 'fan' task. */
+			}
+
+			loop_split_worker_do(common_data, &data, NULL);
+		}
+
+		ml_prev = ml_curr;
+		ml_prev_index = ml_curr_index;
+	}
+}
+
 /**
  * Compute split normals, i.e. vertex normals associated with each poly (hence 'loop normals').
  * Useful to materialize sharp edges (or non-smooth faces) without actually modifying the geometry (splitting edges).
@@ -1271,8 +1466,8 @@ void BKE_mesh_normals_loop_split(
 	/* Simple mapping from a loop to its polygon index. */
 	int *loop_to_poly = r_loop_to_poly ? r_loop_to_poly : MEM_mallocN(sizeof(*loop_to_poly) * (size_t)numLoops, __func__);
 
-	MPoly *mp;
-	int mp_index;
+	/* Not enough loops to be worth the whole threading overhead otherwise... */
+	const bool use_threading = (numLoops >= LOOP_SPLIT_TASK_BLOCK_SIZE * 8);
 
 	/* When using custom loop normals, disable the angle feature! */
 	const bool check_angle = (split_angle < (float)M_PI) && (clnors_data == NULL);
@@ -1295,55 +1490,26 @@ void BKE_mesh_normals_loop_split(
 		BKE_lnor_spacearr_init(r_lnors_spacearr, numLoops);
 	}
 
-	/* This first loop check which edges are actually smooth, and compute edge vectors. */
-	for (mp = mpolys, mp_index = 0; mp_index < numPolys; mp++, mp_index++) {
-		MLoop *ml_curr;
-		int *e2l;
-		int ml_curr_index = mp->loopstart;
-		const int ml_last_index = (ml_curr_index + mp->totloop) - 1;
-
-		ml_curr = &mloops[ml_curr_index];
-
-		for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++) {
-			e2l = edge_to_loops[ml_curr->e];
+	/* Check which edges are actually smooth, in two passes so that both can run in parallel. */
+	{
+		LoopSplitEdgeTaskData edge_data = {
+		    .edge_to_loops = edge_to_loops,
+		    .edge_users = MEM_callocN(sizeof(*edge_data.edge_users) * (size_t)numEdges, __func__),
+		    .loop_to_poly = loop_to_poly,
+		    .loopnors = r_loopnors,
+		    .mverts = mverts,
+		    .medges = medges,
+		    .mloops = mloops,
+		    .mpolys = mpolys,
+		    .polynors = polynors,
+		    .split_angle = split_angle,
+		    .check_angle = check_angle,
+		};
 
-			loop_to_poly[ml_curr_index] = mp_index;
+		BLI_task_parallel_range(0, numPolys, &edge_data, loop_split_edge_users_task_cb, use_threading);
+		BLI_task_parallel_range(0, numEdges, &edge_data, loop_split_edge_sharp_task_cb, use_threading);
 
-			/* Pre-populate all loop normals as if their verts were all-smooth, this way we don't have to compute
-			 * those later!
-			 */
-			normal_short_to_float_v3(r_loopnors[ml_curr_index], mverts[ml_curr->v].no);
-
-			/* Check whether current edge might be smooth or sharp */
-			if ((e2l[0] | e2l[1]) == 0) {
-				/* 'Empty' edge until now, set e2l[0] (and e2l[1] to INDEX_UNSET to tag it as unset). */
-				e2l[0] = ml_curr_index;
-				/* We have to check this here too, else we might miss some flat faces!!! */
-				e2l[1] = (mp->flag & ME_SMOOTH) ? INDEX_UNSET : INDEX_INVALID;
-			}
-			else if (e2l[1] == INDEX_UNSET) {
-				/* Second loop using this edge, time to test its sharpness.
-				 * An edge is sharp if it is tagged as such, or its face is not smooth,
-				 * or both poly have opposed (flipped) normals, i.e. both loops on the same edge share the same vertex,
-				 * or angle between both its polys' normals is above split_angle value.
-				 */
-				if (!(mp->flag & ME_SMOOTH) || (medges[ml_curr->e].flag & ME_SHARP) ||
-				    ml_curr->v == mloops[e2l[0]].v ||
-				    (check_angle && dot_v3v3(polynors[loop_to_poly[e2l[0]]], polynors[mp_index]) < split_angle))
-				{
-					/* Note: we are sure that loop != 0 here ;) */
-					e2l[1] = INDEX_INVALID;
-				}
-				else {
-					e2l[1] = ml_curr_index;
-				}
-			}
-			else if (!IS_EDGE_SHARP(e2l)) {
-				/* More than two loops using this edge, tag as sharp if not yet done. */
-				e2l[1] = INDEX_INVALID;
-			}
-			/* Else, edge is already 'disqualified' (i.e. sharp)! */
-		}
+		MEM_freeN(edge_data.edge_users);
 	}
 
 	/* Init data common to all tasks. */
@@ -1362,10 +1528,13 @@ void BKE_mesh_normals_loop_split(
 	    .numPolys = numPolys,
 	};
 
-	if (numLoops < LOOP_SPLIT_TASK_BLOCK_SIZE * 8) {
-		/* Not enough loops to be worth the whole threading overhead... */
+	if (!use_threading) {
 		loop_split_generator(NULL, &common_data);
 	}
+	else if (r_lnors_spacearr == NULL) {
+		/* Without lnor spaces, fans can be found and computed fully in parallel. */
+		BLI_task_parallel_range(0, numPolys, &common_data, loop_split_generator_task_cb, true);
+	}
 	else {
 		TaskScheduler *task_scheduler;
 		TaskPool *task_pool;
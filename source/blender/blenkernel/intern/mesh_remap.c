@@ -77,6 +77,48 @@ static bool mesh_remap_bvhtree_query_nearest(
 	}
 }
 
+/**
+ * Batched version of #mesh_remap_bvhtree_query_nearest, for all vertices of \a verts_dst.
+ *
+ * \param r_cos: The vertex coordinates, converted to tree space if needed.
+ * \param r_nearest: The result for each vertex, check it with #mesh_remap_bvhtree_nearest_is_valid.
+ */
+static void mesh_remap_bvhtree_query_nearest_verts(
+        BVHTreeFromMesh *treedata, const MVert *verts_dst, const int numverts_dst,
+        const SpaceTransform *space_transform, const float max_dist_sq,
+        float (*r_cos)[3], BVHTreeNearest *r_nearest)
+{
+	int i;
+
+	for (i = 0; i < numverts_dst; i++) {
+		copy_v3_v3(r_cos[i], verts_dst[i].co);
+
+		/* Convert the vertex to tree coordinates, if needed. */
+		if (space_transform) {
+			BLI_space_transform_apply(space_transform, r_cos[i]);
+		}
+
+		r_nearest[i].index = -1;
+		r_nearest[i].dist_sq = max_dist_sq;
+	}
+
+	BLI_bvhtree_find_nearest_batch(
+	        treedata->tree, (const float (*)[3])r_cos, numverts_dst, r_nearest,
+	        treedata->nearest_callback, treedata);
+}
+
+static bool mesh_remap_bvhtree_nearest_is_valid(
+        const BVHTreeNearest *nearest, const float max_dist_sq, float *r_hit_dist)
+{
+	if ((nearest->index != -1) && (nearest->dist_sq <= max_dist_sq)) {
+		*r_hit_dist = sqrtf(nearest->dist_sq);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
 static bool mesh_remap_bvhtree_query_raycast(
         BVHTreeFromMesh *treedata, BVHTreeRayHit *rayhit,
         const float co[3], const float no[3], const float radius, const float max_dist, float *r_hit_dist)
@@ -454,56 +496,52 @@ void BKE_mesh_remap_calc_verts_from_dm(
 	}
 	else {
 		BVHTreeFromMesh treedata = {NULL};
-		BVHTreeNearest nearest = {0};
 		BVHTreeRayHit rayhit = {0};
 		float hit_dist;
 		float tmp_co[3], tmp_no[3];
 
 		if (mode == MREMAP_MODE_VERT_NEAREST) {
+			float (*vcos_dst)[3] = MEM_mallocN(sizeof(*vcos_dst) * (size_t)numverts_dst, __func__);
+			BVHTreeNearest *nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
+
 			bvhtree_from_mesh_verts(&treedata, dm_src, 0.0f, 2, 6);
-			nearest.index = -1;
+			mesh_remap_bvhtree_query_nearest_verts(
+			        &treedata, verts_dst, numverts_dst, space_transform, max_dist_sq, vcos_dst, nearest_dst);
 
 			for (i = 0; i < numverts_dst; i++) {
-				copy_v3_v3(tmp_co, verts_dst[i].co);
-
-				/* Convert the vertex to tree coordinates, if needed. */
-				if (space_transform) {
-					BLI_space_transform_apply(space_transform, tmp_co);
-				}
-
-				if (mesh_remap_bvhtree_query_nearest(&treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-					mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest.index, &full_weight);
+				if (mesh_remap_bvhtree_nearest_is_valid(&nearest_dst[i], max_dist_sq, &hit_dist)) {
+					mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest_dst[i].index, &full_weight);
 				}
 				else {
 					/* No source for this dest vertex! */
 					BKE_mesh_remap_item_define_invalid(r_map, i);
 				}
 			}
+
+			MEM_freeN(vcos_dst);
+			MEM_freeN(nearest_dst);
 		}
 		else if (ELEM(mode, MREMAP_MODE_VERT_EDGE_NEAREST, MREMAP_MODE_VERT_EDGEINTERP_NEAREST)) {
 			MEdge *edges_src = dm_src->getEdgeArray(dm_src);
 			float (*vcos_src)[3] = MEM_mallocN(sizeof(*vcos_src) * (size_t)dm_src->getNumVerts(dm_src), __func__);
 			dm_src->getVertCos(dm_src, vcos_src);
 
+			float (*vcos_dst)[3] = MEM_mallocN(sizeof(*vcos_dst) * (size_t)numverts_dst, __func__);
+			BVHTreeNearest *nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
+
 			bvhtree_from_mesh_edges(&treedata, dm_src, 0.0f, 2, 6);
-			nearest.index = -1;
+			mesh_remap_bvhtree_query_nearest_verts(
+			        &treedata, verts_dst, numverts_dst, space_transform, max_dist_sq, vcos_dst, nearest_dst);
 
 			for (i = 0; i < numverts_dst; i++) {
-				copy_v3_v3(tmp_co, verts_dst[i].co);
-
-				/* Convert the vertex to tree coordinates, if needed. */
-				if (space_transform) {
-					BLI_space_transform_apply(space_transform, tmp_co);
-				}
-
-				if (mesh_remap_bvhtree_query_nearest(&treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-					MEdge *me = &edges_src[nearest.index];
+				if (mesh_remap_bvhtree_nearest_is_valid(&nearest_dst[i], max_dist_sq, &hit_dist)) {
+					MEdge *me = &edges_src[nearest_dst[i].index];
 					const float *v1cos = vcos_src[me->v1];
 					const float *v2cos = vcos_src[me->v2];
 
 					if (mode == MREMAP_MODE_VERT_EDGE_NEAREST) {
-						const float dist_v1 = len_squared_v3v3(tmp_co, v1cos);
-						const float dist_v2 = len_squared_v3v3(tmp_co, v2cos);
+						const float dist_v1 = len_squared_v3v3(vcos_dst[i], v1cos);
+						const float dist_v2 = len_squared_v3v3(vcos_dst[i], v2cos);
 						const int index = (int)((dist_v1 > dist_v2) ? me->v2 : me->v1);
 						mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &index, &full_weight);
 					}
@@ -515,7 +553,7 @@ void BKE_mesh_remap_calc_verts_from_dm(
 						indices[1] = (int)me->v2;
 
 						/* Weight is inverse of point factor here... */
-						weights[0] = line_point_factor_v3(tmp_co, v2cos, v1cos);
+						weights[0] = line_point_factor_v3(vcos_dst[i], v2cos, v1cos);
 						CLAMP(weights[0], 0.0f, 1.0f);
 						weights[1] = 1.0f - weights[0];
 
@@ -529,6 +567,8 @@ void BKE_mesh_remap_calc_verts_from_dm(
 			}
 
 			MEM_freeN(vcos_src);
+			MEM_freeN(vcos_dst);
+			MEM_freeN(nearest_dst);
 		}
 		else if (ELEM(mode, MREMAP_MODE_VERT_POLY_NEAREST, MREMAP_MODE_VERT_POLYINTERP_NEAREST,
 		                    MREMAP_MODE_VERT_POLYINTERP_VNORPROJ))
@@ -574,24 +614,21 @@ void BKE_mesh_remap_calc_verts_from_dm(
 				}
 			}
 			else {
-				nearest.index = -1;
-
-				for (i = 0; i < numverts_dst; i++) {
-					copy_v3_v3(tmp_co, verts_dst[i].co);
+				float (*vcos_dst)[3] = MEM_mallocN(sizeof(*vcos_dst) * (size_t)numverts_dst, __func__);
+				BVHTreeNearest *nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
 
-					/* Convert the vertex to tree coordinates, if needed. */
-					if (space_transform) {
-						BLI_space_transform_apply(space_transform, tmp_co);
-					}
+				mesh_remap_bvhtree_query_nearest_verts(
+				        &treedata, verts_dst, numverts_dst, space_transform, max_dist_sq, vcos_dst, nearest_dst);
 
-					if (mesh_remap_bvhtree_query_nearest(&treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-						const MLoopTri *lt = &treedata.looptri[nearest.index];
+				for (i = 0; i < numverts_dst; i++) {
+					if (mesh_remap_bvhtree_nearest_is_valid(&nearest_dst[i], max_dist_sq, &hit_dist)) {
+						const MLoopTri *lt = &treedata.looptri[nearest_dst[i].index];
 						MPoly *mp = &polys_src[lt->poly];
 
 						if (mode == MREMAP_MODE_VERT_POLY_NEAREST) {
 							int index;
 							mesh_remap_interp_poly_data_get(
-							        mp, loops_src, (const float (*)[3])vcos_src, nearest.co,
+							        mp, loops_src, (const float (*)[3])vcos_src, nearest_dst[i].co,
 							        &tmp_buff_size, &vcos, false, &indices, &weights, false,
 							        &index);
 
@@ -599,7 +636,7 @@ void BKE_mesh_remap_calc_verts_from_dm(
 						}
 						else if (mode == MREMAP_MODE_VERT_POLYINTERP_NEAREST) {
 							const int sources_num = mesh_remap_interp_poly_data_get(
-							        mp, loops_src, (const float (*)[3])vcos_src, nearest.co,
+							        mp, loops_src, (const float (*)[3])vcos_src, nearest_dst[i].co,
 							        &tmp_buff_size, &vcos, false, &indices, &weights, true,
 							        NULL);
 
@@ -611,6 +648,9 @@ void BKE_mesh_remap_calc_verts_from_dm(
 						BKE_mesh_remap_item_define_invalid(r_map, i);
 					}
 				}
+
+				MEM_freeN(vcos_dst);
+				MEM_freeN(nearest_dst);
 			}
 
 			MEM_freeN(vcos_src);
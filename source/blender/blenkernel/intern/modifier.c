@@ -141,6 +141,8 @@ void modifier_free(ModifierData *md)
 	if (mti->freeData) mti->freeData(md);
 	if (md->error) MEM_freeN(md->error);
 
+	DM_stack_cache_free_modifier(md);
+
 	MEM_freeN(md);
 }
 
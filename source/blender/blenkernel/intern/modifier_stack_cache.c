@@ -0,0 +1,605 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenkernel/intern/modifier_stack_cache.c
+ *  \ingroup bke
+ *
+ * Cache of intermediate modifier stack results.
+ *
+ * The result of a constructive modifier is stored together with a key which
+ * hashes the base mesh, the deformed coordinates and the settings of every
+ * modifier up to and including that one. When the stack is evaluated again
+ * with the same key (for example when only a later modifier or the object
+ * transform changed) evaluation continues from the cached result instead of
+ * the base mesh.
+ *
+ * A result is only stored the second time the same key is seen, so animated
+ * input does not pay for copying results which are never reused.
+ */
+
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_linklist.h"
+#include "BLI_listbase.h"
+#include "BLI_threads.h"
+
+#include "BKE_cdderivedmesh.h"
+#include "BKE_customdata.h"
+#include "BKE_DerivedMesh.h"
+#include "BKE_modifier.h"
+
+#include "RNA_access.h"
+
+/* Memory budget for all cached results, least recently used ones are freed first. */
+#define STACK_CACHE_MAX_MEMORY (256 * 1024 * 1024)
+
+#define STACK_CACHE_HASH_SEED_HI 0x9e3779b9
+
+typedef struct StackCacheEntry {
+	struct StackCacheEntry *next, *prev;
+
+	ModifierData *md;
+	uint64_t key;
+	/* NULL while the key was only seen once. */
+	DerivedMesh *dm;
+	size_t mem_size;
+	/* Number of threads copying the result, entry can not be freed meanwhile. */
+	int users;
+} StackCacheEntry;
+
+static struct {
+	/* Entries ordered from least to most recently used. */
+	ListBase lru;
+	/* ModifierData -> StackCacheEntry. */
+	GHash *entries;
+	size_t mem_in_use;
+} stack_cache = {{NULL, NULL}, NULL, 0};
+
+static ThreadMutex stack_cache_lock = BLI_MUTEX_INITIALIZER;
+
+/* -------------------------------------------------------------------- */
+/** \name Keys
+ * \{ */
+
+/* Two independently seeded hashes, a 32 bit key alone is too likely to collide. */
+typedef struct StackCacheHash {
+	BLI_HashMurmur2A lo, hi;
+} StackCacheHash;
+
+static void stack_cache_hash_init(StackCacheHash *hash)
+{
+	BLI_hash_mm2a_init(&hash->lo, 0);
+	BLI_hash_mm2a_init(&hash->hi, STACK_CACHE_HASH_SEED_HI);
+}
+
+static void stack_cache_hash_add(StackCacheHash *hash, const void *data, size_t len)
+{
+	if (data && len) {
+		BLI_hash_mm2a_add(&hash->lo, data, len);
+		BLI_hash_mm2a_add(&hash->hi, data, len);
+	}
+}
+
+static void stack_cache_hash_add_int(StackCacheHash *hash, int data)
+{
+	BLI_hash_mm2a_add_int(&hash->lo, data);
+	BLI_hash_mm2a_add_int(&hash->hi, data);
+}
+
+static void stack_cache_hash_add_float(StackCacheHash *hash, float data)
+{
+	stack_cache_hash_add(hash, &data, sizeof(data));
+}
+
+static void stack_cache_hash_add_string(StackCacheHash *hash, const char *str)
+{
+	stack_cache_hash_add(hash, str, strlen(str) + 1);
+}
+
+static uint64_t stack_cache_hash_end(const StackCacheHash *hash)
+{
+	StackCacheHash tmp = *hash;
+	return ((uint64_t)BLI_hash_mm2a_end(&tmp.hi) << 32) | (uint64_t)BLI_hash_mm2a_end(&tmp.lo);
+}
+
+/* Returns false when the layers can not be hashed by value. */
+static bool stack_cache_hash_customdata(StackCacheHash *hash, const CustomData *data, int totelem)
+{
+	int i;
+
+	stack_cache_hash_add_int(hash, totelem);
+	stack_cache_hash_add_int(hash, data->totlayer);
+
+	for (i = 0; i < data->totlayer; i++) {
+		const CustomDataLayer *layer = &data->layers[i];
+
+		stack_cache_hash_add_int(hash, layer->type);
+		stack_cache_hash_add_int(hash, layer->flag);
+		stack_cache_hash_add_string(hash, layer->name);
+
+		switch (layer->type) {
+			case CD_MDEFORMVERT:
+			{
+				const MDeformVert *dvert = layer->data;
+				int j;
+
+				for (j = 0; j < totelem; j++, dvert++) {
+					stack_cache_hash_add_int(hash, dvert->totweight);
+					stack_cache_hash_add(hash, dvert->dw, sizeof(*dvert->dw) * (size_t)dvert->totweight);
+				}
+				break;
+			}
+			case CD_MDISPS:
+			case CD_GRID_PAINT_MASK:
+				/* Multires data, only meaningful together with sculpt state. */
+				return false;
+			default:
+				stack_cache_hash_add(hash, layer->data, (size_t)CustomData_sizeof(layer->type) * (size_t)totelem);
+				break;
+		}
+	}
+
+	return true;
+}
+
+/* Hash all value properties of the modifier, pointers are handled by #DM_stack_cache_modifier_is_cacheable. */
+static void stack_cache_hash_modifier(StackCacheHash *hash, Object *ob, ModifierData *md)
+{
+	PointerRNA ptr;
+
+	stack_cache_hash_add_int(hash, md->type);
+
+	RNA_pointer_create(&ob->id, &RNA_Modifier, md, &ptr);
+
+	RNA_STRUCT_BEGIN (&ptr, prop)
+	{
+		const PropertyType type = RNA_property_type(prop);
+		const int len = RNA_property_array_length(&ptr, prop);
+		int i;
+
+		switch (type) {
+			case PROP_BOOLEAN:
+				if (len) {
+					for (i = 0; i < len; i++) {
+						stack_cache_hash_add_int(hash, RNA_property_boolean_get_index(&ptr, prop, i));
+					}
+				}
+				else {
+					stack_cache_hash_add_int(hash, RNA_property_boolean_get(&ptr, prop));
+				}
+				break;
+			case PROP_INT:
+				if (len) {
+					for (i = 0; i < len; i++) {
+						stack_cache_hash_add_int(hash, RNA_property_int_get_index(&ptr, prop, i));
+					}
+				}
+				else {
+					stack_cache_hash_add_int(hash, RNA_property_int_get(&ptr, prop));
+				}
+				break;
+			case PROP_FLOAT:
+				if (len) {
+					for (i = 0; i < len; i++) {
+						stack_cache_hash_add_float(hash, RNA_property_float_get_index(&ptr, prop, i));
+					}
+				}
+				else {
+					stack_cache_hash_add_float(hash, RNA_property_float_get(&ptr, prop));
+				}
+				break;
+			case PROP_ENUM:
+				stack_cache_hash_add_int(hash, RNA_property_enum_get(&ptr, prop));
+				break;
+			case PROP_STRING:
+			{
+				char fixedbuf[256];
+				int str_len;
+				char *str = RNA_property_string_get_alloc(&ptr, prop, fixedbuf, sizeof(fixedbuf), &str_len);
+
+				stack_cache_hash_add(hash, str, (size_t)str_len);
+				if (str != fixedbuf) {
+					MEM_freeN(str);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	RNA_STRUCT_END;
+}
+
+static void stack_cache_id_walk(void *userData, Object *UNUSED(ob), ID **idpoin, int UNUSED(cb_flag))
+{
+	if (*idpoin) {
+		*((bool *)userData) = true;
+	}
+}
+
+/**
+ * Only modifiers whose result depends on nothing but their input and settings can be cached.
+ * Anything reading time, other objects, textures or bind data is re-evaluated every time.
+ */
+bool DM_stack_cache_modifier_is_cacheable(Object *ob, ModifierData *md)
+{
+	const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+	bool has_links = false;
+
+	if (mti->dependsOnTime && mti->dependsOnTime(md)) {
+		return false;
+	}
+
+	/* Modifiers keeping bind data or other runtime state outside of RNA (and so outside of the key),
+	 * for example pressing bind on corrective smooth only sets a flag which is not hashed. */
+	switch ((ModifierType)md->type) {
+		case eModifierType_CorrectiveSmooth:
+		case eModifierType_LaplacianDeform:
+		case eModifierType_MeshDeform:
+		case eModifierType_SurfaceDeform:
+		case eModifierType_Explode:
+		case eModifierType_Ocean:
+		case eModifierType_MeshCache:
+		case eModifierType_Multires:
+		case eModifierType_DynamicPaint:
+		/* physics, their state lives in point-caches and runtime data */
+		case eModifierType_Softbody:
+		case eModifierType_Cloth:
+		case eModifierType_Collision:
+		case eModifierType_Surface:
+		case eModifierType_Smoke:
+		case eModifierType_Fluidsim:
+		case eModifierType_ParticleSystem:
+			return false;
+		default:
+			break;
+	}
+
+	if (mti->foreachIDLink) {
+		mti->foreachIDLink(md, ob, stack_cache_id_walk, &has_links);
+	}
+	else if (mti->foreachObjectLink) {
+		mti->foreachObjectLink(md, ob, (ObjectWalkFunc)stack_cache_id_walk, &has_links);
+	}
+	else if (mti->foreachTexLink) {
+		has_links = true;
+	}
+
+	return !has_links;
+}
+
+static bool stack_cache_hash_input(
+        StackCacheHash *hash, Scene *scene, Object *ob, const float (*vertCos)[3], int numVerts,
+        CustomDataMask dataMask, int app_flags)
+{
+	Mesh *me = ob->data;
+	bDeformGroup *dg;
+
+	if (!stack_cache_hash_customdata(hash, &me->vdata, me->totvert) ||
+	    !stack_cache_hash_customdata(hash, &me->edata, me->totedge) ||
+	    !stack_cache_hash_customdata(hash, &me->ldata, me->totloop) ||
+	    !stack_cache_hash_customdata(hash, &me->pdata, me->totpoly))
+	{
+		return false;
+	}
+
+	if (vertCos) {
+		stack_cache_hash_add(hash, vertCos, sizeof(*vertCos) * (size_t)numVerts);
+	}
+
+	for (dg = ob->defbase.first; dg; dg = dg->next) {
+		stack_cache_hash_add_string(hash, dg->name);
+	}
+
+	stack_cache_hash_add_int(hash, me->totcol);
+	stack_cache_hash_add_int(hash, ob->mode);
+	stack_cache_hash_add_int(hash, app_flags);
+	stack_cache_hash_add(hash, &dataMask, sizeof(dataMask));
+
+	/* Simplify changes the subdivision level of modifiers without touching their settings. */
+	stack_cache_hash_add_int(hash, scene->r.mode & R_SIMPLIFY);
+	stack_cache_hash_add_int(hash, scene->r.simplify_subsurf);
+
+	return true;
+}
+
+/* Walk the remaining stack the same way mesh_calc_modifiers() does, optionally computing keys. */
+static int stack_cache_points_walk(
+        Scene *scene, Object *ob, ModifierData *md, CDMaskLink *link, const int required_mode,
+        StackCacheHash *hash, DMStackCachePoint *r_points, const int max_points)
+{
+	ModifierData *last_applied = NULL;
+	bool has_dm = false;
+	int num_points = 0;
+
+	for (; md; md = md->next, link = link->next) {
+		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+
+		if (!modifier_isEnabled(scene, md, required_mode)) {
+			continue;
+		}
+
+		if ((mti->flags & eModifierTypeFlag_RequiresOriginalData) && has_dm) {
+			continue;
+		}
+
+		last_applied = md;
+
+		if (!DM_stack_cache_modifier_is_cacheable(ob, md) || (link->mask & (CD_MASK_ORCO | CD_MASK_CLOTH_ORCO))) {
+			break;
+		}
+
+		if (hash) {
+			stack_cache_hash_modifier(hash, ob, md);
+			stack_cache_hash_add(hash, &link->mask, sizeof(link->mask));
+		}
+
+		if (mti->type != eModifierTypeType_OnlyDeform) {
+			has_dm = true;
+
+			if (num_points < max_points) {
+				r_points[num_points].md = md;
+				r_points[num_points].link = link;
+				r_points[num_points].key = hash ? stack_cache_hash_end(hash) : 0;
+				num_points++;
+			}
+		}
+	}
+
+	/* Caching the last applied modifier saves nothing, its result is the final mesh. */
+	if (num_points && r_points[num_points - 1].md == last_applied) {
+		num_points--;
+	}
+
+	return num_points;
+}
+
+/**
+ * Find the constructive modifiers after \a md whose results can be cached, and compute their keys.
+ * \a vertCos are the coordinates deformed by the leading deform modifiers (may be NULL).
+ *
+ * \return the number of points written to \a r_points.
+ */
+int DM_stack_cache_points_find(
+        Scene *scene, Object *ob, ModifierData *md, CDMaskLink *link,
+        const float (*vertCos)[3], int numVerts, CustomDataMask dataMask, int app_flags, int required_mode,
+        DMStackCachePoint *r_points, int max_points)
+{
+	StackCacheHash hash;
+
+	if (dataMask & (CD_MASK_ORCO | CD_MASK_CLOTH_ORCO)) {
+		return 0;
+	}
+
+	/* Cheap pass first, most stacks have nothing worth hashing the mesh for. */
+	if (stack_cache_points_walk(scene, ob, md, link, required_mode, NULL, r_points, max_points) == 0) {
+		return 0;
+	}
+
+	stack_cache_hash_init(&hash);
+	if (!stack_cache_hash_input(&hash, scene, ob, vertCos, numVerts, dataMask, app_flags)) {
+		return 0;
+	}
+
+	return stack_cache_points_walk(scene, ob, md, link, required_mode, &hash, r_points, max_points);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Storage
+ * \{ */
+
+static size_t stack_cache_customdata_size(const CustomData *data, int totelem)
+{
+	size_t size = 0;
+	int i;
+
+	for (i = 0; i < data->totlayer; i++) {
+		size += (size_t)CustomData_sizeof(data->layers[i].type) * (size_t)totelem;
+	}
+
+	return size;
+}
+
+static size_t stack_cache_dm_size(DerivedMesh *dm)
+{
+	return (sizeof(*dm) +
+	        stack_cache_customdata_size(&dm->vertData, dm->numVertData) +
+	        stack_cache_customdata_size(&dm->edgeData, dm->numEdgeData) +
+	        stack_cache_customdata_size(&dm->faceData, dm->numTessFaceData) +
+	        stack_cache_customdata_size(&dm->loopData, dm->numLoopData) +
+	        stack_cache_customdata_size(&dm->polyData, dm->numPolyData));
+}
+
+static void stack_cache_dm_release(void *dm)
+{
+	((DerivedMesh *)dm)->release(dm);
+}
+
+/* Detach the result of an entry, results are released by the caller outside of the lock. */
+static void stack_cache_entry_clear(StackCacheEntry *entry, LinkNode **r_free_dms)
+{
+	if (entry->dm) {
+		BLI_linklist_prepend(r_free_dms, entry->dm);
+		stack_cache.mem_in_use -= entry->mem_size;
+		entry->dm = NULL;
+		entry->mem_size = 0;
+	}
+}
+
+static void stack_cache_entry_remove(StackCacheEntry *entry, LinkNode **r_free_dms)
+{
+	stack_cache_entry_clear(entry, r_free_dms);
+	BLI_remlink(&stack_cache.lru, entry);
+	BLI_ghash_remove(stack_cache.entries, entry->md, NULL, NULL);
+	MEM_freeN(entry);
+}
+
+static void stack_cache_evict(LinkNode **r_free_dms)
+{
+	StackCacheEntry *entry, *entry_next;
+
+	for (entry = stack_cache.lru.first; entry && stack_cache.mem_in_use > STACK_CACHE_MAX_MEMORY; entry = entry_next) {
+		entry_next = entry->next;
+		if (entry->users == 0) {
+			stack_cache_entry_clear(entry, r_free_dms);
+		}
+	}
+}
+
+/**
+ * Return a copy of the cached result of \a md when it was stored with \a key, NULL otherwise.
+ */
+DerivedMesh *DM_stack_cache_lookup(ModifierData *md, uint64_t key)
+{
+	StackCacheEntry *entry;
+	DerivedMesh *dm = NULL;
+
+	BLI_mutex_lock(&stack_cache_lock);
+	entry = stack_cache.entries ? BLI_ghash_lookup(stack_cache.entries, md) : NULL;
+	if (entry && entry->dm && entry->key == key) {
+		entry->users++;
+		BLI_remlink(&stack_cache.lru, entry);
+		BLI_addtail(&stack_cache.lru, entry);
+	}
+	else {
+		entry = NULL;
+	}
+	BLI_mutex_unlock(&stack_cache_lock);
+
+	if (entry) {
+		dm = CDDM_copy(entry->dm);
+
+		BLI_mutex_lock(&stack_cache_lock);
+		entry->users--;
+		BLI_mutex_unlock(&stack_cache_lock);
+	}
+
+	return dm;
+}
+
+/**
+ * Offer the result of \a md for caching. A copy is only kept once the same \a key is seen twice
+ * in a row, the first time only the key is remembered.
+ */
+void DM_stack_cache_store(ModifierData *md, uint64_t key, DerivedMesh *dm)
+{
+	StackCacheEntry *entry;
+	LinkNode *free_dms = NULL;
+	bool do_copy = false;
+
+	BLI_mutex_lock(&stack_cache_lock);
+	if (stack_cache.entries == NULL) {
+		stack_cache.entries = BLI_ghash_ptr_new(__func__);
+	}
+
+	entry = BLI_ghash_lookup(stack_cache.entries, md);
+	if (entry == NULL) {
+		entry = MEM_callocN(sizeof(*entry), __func__);
+		entry->md = md;
+		entry->key = key;
+		BLI_ghash_insert(stack_cache.entries, md, entry);
+		BLI_addtail(&stack_cache.lru, entry);
+	}
+	else if (entry->users == 0) {
+		if (entry->key != key) {
+			stack_cache_entry_clear(entry, &free_dms);
+			entry->key = key;
+		}
+		else if (entry->dm == NULL) {
+			do_copy = true;
+		}
+	}
+	BLI_mutex_unlock(&stack_cache_lock);
+
+	if (do_copy) {
+		DerivedMesh *cache_dm = CDDM_copy(dm);
+		const size_t mem_size = stack_cache_dm_size(cache_dm);
+
+		BLI_mutex_lock(&stack_cache_lock);
+		/* The entry may have been removed or updated by another thread meanwhile. */
+		if (BLI_ghash_lookup(stack_cache.entries, md) == entry &&
+		    entry->key == key && entry->dm == NULL && entry->users == 0)
+		{
+			entry->dm = cache_dm;
+			entry->mem_size = mem_size;
+			stack_cache.mem_in_use += mem_size;
+			BLI_remlink(&stack_cache.lru, entry);
+			BLI_addtail(&stack_cache.lru, entry);
+			stack_cache_evict(&free_dms);
+		}
+		else {
+			BLI_linklist_prepend(&free_dms, cache_dm);
+		}
+		BLI_mutex_unlock(&stack_cache_lock);
+	}
+
+	BLI_linklist_free(free_dms, stack_cache_dm_release);
+}
+
+/**
+ * Called when a modifier is freed, so its address can not match a stale entry.
+ */
+void DM_stack_cache_free_modifier(ModifierData *md)
+{
+	StackCacheEntry *entry;
+	LinkNode *free_dms = NULL;
+
+	BLI_mutex_lock(&stack_cache_lock);
+	entry = stack_cache.entries ? BLI_ghash_lookup(stack_cache.entries, md) : NULL;
+	if (entry) {
+		BLI_assert(entry->users == 0);
+		stack_cache_entry_remove(entry, &free_dms);
+	}
+	BLI_mutex_unlock(&stack_cache_lock);
+
+	BLI_linklist_free(free_dms, stack_cache_dm_release);
+}
+
+void DM_stack_cache_free_all(void)
+{
+	LinkNode *free_dms = NULL;
+
+	BLI_mutex_lock(&stack_cache_lock);
+	while (stack_cache.lru.first) {
+		stack_cache_entry_remove(stack_cache.lru.first, &free_dms);
+	}
+	if (stack_cache.entries) {
+		BLI_ghash_free(stack_cache.entries, NULL, NULL);
+		stack_cache.entries = NULL;
+	}
+	BLI_mutex_unlock(&stack_cache_lock);
+
+	BLI_linklist_free(free_dms, stack_cache_dm_release);
+}
+
+/** \} */
@@ -54,6 +54,7 @@
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
 #include "BLI_edgehash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_threads.h"
@@ -678,6 +679,67 @@ static void free_ss_weights(WeightTable *wtable)
 		MEM_freeN(wtable->weight_table);
 }
 
+/* Second seed, so two 32 bit hashes give a key wide enough to trust for topology equality. */
+#define SS_TOPOLOGY_HASH_SEED_HI 0x9e3779b9
+
+static void ss_topology_hash_add(BLI_HashMurmur2A hash[2], const void *data, size_t len)
+{
+	if (data && len) {
+		BLI_hash_mm2a_add(&hash[0], data, len);
+		BLI_hash_mm2a_add(&hash[1], data, len);
+	}
+}
+
+/* Fingerprint of everything ss_sync_ccg_from_derivedmesh() feeds into the subsurf besides
+ * vertex positions, never zero so it can't match an unknown topology.
+ * The OpenSubdiv path skips its own topology comparison on a matching hash, so settings
+ * that change how the refiner is built (face-varying UV interpolation) are mixed in too. */
+static uint64_t ss_topology_hash(DerivedMesh *dm, int useFlatSubdiv, bool useSubdivUvs)
+{
+	BLI_HashMurmur2A hash[2];
+	const int totvert = dm->getNumVerts(dm);
+	const int totedge = dm->getNumEdges(dm);
+	const int totloop = dm->getNumLoops(dm);
+	const int totpoly = dm->getNumPolys(dm);
+	const int counts[6] = {totvert, totedge, totloop, totpoly, useFlatSubdiv, useSubdivUvs};
+	uint64_t result;
+
+	BLI_hash_mm2a_init(&hash[0], 0);
+	BLI_hash_mm2a_init(&hash[1], SS_TOPOLOGY_HASH_SEED_HI);
+
+	ss_topology_hash_add(hash, counts, sizeof(counts));
+	ss_topology_hash_add(hash, dm->getEdgeArray(dm), sizeof(MEdge) * totedge);
+	ss_topology_hash_add(hash, dm->getLoopArray(dm), sizeof(MLoop) * totloop);
+	ss_topology_hash_add(hash, dm->getPolyArray(dm), sizeof(MPoly) * totpoly);
+
+	/* Original indices are stored in the user data of the CCG elements. */
+	ss_topology_hash_add(hash, dm->getVertDataArray(dm, CD_ORIGINDEX), sizeof(int) * totvert);
+	ss_topology_hash_add(hash, dm->getEdgeDataArray(dm, CD_ORIGINDEX), sizeof(int) * totedge);
+	ss_topology_hash_add(hash, dm->getPolyDataArray(dm, CD_ORIGINDEX), sizeof(int) * totpoly);
+
+	result = ((uint64_t)BLI_hash_mm2a_end(&hash[1]) << 32) | (uint64_t)BLI_hash_mm2a_end(&hash[0]);
+	return result ? result : 1;
+}
+
+/* Topology is the same as in the last full sync, only push the new positions through a
+ * partial sync which keeps the vertex, edge and face maps and only subdivides what moved. */
+static void ss_sync_ccg_coords_from_derivedmesh(CCGSubSurf *ss,
+                                                DerivedMesh *dm,
+                                                float (*vertexCos)[3])
+{
+	MVert *mvert = dm->getVertArray(dm);
+	int totvert = dm->getNumVerts(dm);
+	int i;
+
+	ccgSubSurf_initPartialSync(ss);
+
+	for (i = 0; i < totvert; i++) {
+		ccgSubSurf_syncVert(ss, SET_INT_IN_POINTER(i), vertexCos ? vertexCos[i] : mvert[i].co, 0, NULL);
+	}
+
+	ccgSubSurf_processSync(ss);
+}
+
 static void ss_sync_ccg_from_derivedmesh(CCGSubSurf *ss,
                                          DerivedMesh *dm,
                                          float (*vertexCos)[3],
@@ -702,6 +764,12 @@ static void ss_sync_ccg_from_derivedmesh(CCGSubSurf *ss,
 	/*int totpoly = dm->getNumFaces(dm);*/ /*UNUSED*/
 	int i, j;
 	int *index;
+	const uint64_t topology_hash = ss_topology_hash(dm, useFlatSubdiv, false);
+
+	if (topology_hash == ccgSubSurf_getTopologyHash(ss)) {
+		ss_sync_ccg_coords_from_derivedmesh(ss, dm, vertexCos);
+		return;
+	}
 
 	ccgSubSurf_initFullSync(ss);
 
@@ -775,6 +843,7 @@ static void ss_sync_ccg_from_derivedmesh(CCGSubSurf *ss,
 	}
 
 	ccgSubSurf_processSync(ss);
+	ccgSubSurf_setTopologyHash(ss, topology_hash);
 
 #ifndef USE_DYNSIZE
 	BLI_array_free(fVerts);
@@ -808,7 +877,7 @@ static void ss_sync_from_derivedmesh(CCGSubSurf *ss,
 	if (!ccgSubSurf_needGrids(ss)) {
 		/* TODO(sergey): Use vertex coordinates and flat subdiv flag. */
 		ccgSubSurf__sync_subdivUvs(ss, use_subdiv_uvs);
-		ccgSubSurf_checkTopologyChanged(ss, dm);
+		ccgSubSurf_checkTopologyChanged(ss, dm, ss_topology_hash(dm, use_flat_subdiv, use_subdiv_uvs));
 		ss_sync_osd_from_derivedmesh(ss, dm);
 	}
 	else
@@ -0,0 +1,53 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_TRACE_H__
+#define __BLI_TRACE_H__
+
+/** \file BLI_trace.h
+ *  \ingroup bli
+ *  \brief Records a timeline of (nested) named stages per thread,
+ *  written as Chrome trace JSON (view with 'chrome://tracing').
+ */
+
+#include "BLI_compiler_attrs.h"
+#include "BLI_sys_types.h"
+
+void BLI_trace_start(const char *filepath) ATTR_NONNULL();
+bool BLI_trace_stop(void);
+bool BLI_trace_is_active(void);
+
+/* Names are not copied, they must be static strings. */
+void BLI_trace_begin(const char *name) ATTR_NONNULL();
+void BLI_trace_end(const char *name) ATTR_NONNULL();
+
+/* Writing of the trace file, also for profilers which collect their own events.
+ * Times are in seconds, relative to the start of the recording. */
+typedef struct TraceWriter TraceWriter;
+
+TraceWriter *BLI_trace_writer_open(const char *filepath) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+bool BLI_trace_writer_close(TraceWriter *tw) ATTR_NONNULL();
+void BLI_trace_writer_event(
+        TraceWriter *tw, const char *name, const char *category, const char phase,
+        const double time, const double duration, const int thread_index,
+        const char *args) ATTR_NONNULL(1, 2);
+void BLI_trace_writer_thread_name(TraceWriter *tw, const int thread_index, const char *name) ATTR_NONNULL();
+
+#endif  /* __BLI_TRACE_H__ */
@@ -55,6 +55,7 @@
 #include "BLI_stack.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_strict_flags.h"
 #include "BLI_task.h"
 
@@ -470,20 +471,27 @@ static void create_kdop_hull(BVHTree *tree, BVHNode *node, const float *co, int
 	float *bv = node->bv;
 	int k;
 	axis_t axis_iter;
-	
+	/* the first 3 kdop axes are the unit axes, their projection is the coordinate itself */
+	const axis_t unit_axis_end = min_axis(3, tree->stop_axis);
+
 	/* don't init boudings for the moving case */
 	if (!moving) {
 		node_minmax_init(tree, node);
 	}
 
 	for (k = 0; k < numpoints; k++) {
+		const float *co_k = &co[k * 3];
+
 		/* for all Axes. */
-		for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
-			newminmax = dot_v3v3(&co[k * 3], bvhtree_kdop_axes[axis_iter]);
-			if (newminmax < bv[2 * axis_iter])
-				bv[2 * axis_iter] = newminmax;
-			if (newminmax > bv[(2 * axis_iter) + 1])
-				bv[(2 * axis_iter) + 1] = newminmax;
+		for (axis_iter = tree->start_axis; axis_iter < unit_axis_end; axis_iter++) {
+			newminmax = co_k[axis_iter];
+			bv[(2 * axis_iter)]     = min_ff(bv[(2 * axis_iter)],     newminmax);
+			bv[(2 * axis_iter) + 1] = max_ff(bv[(2 * axis_iter) + 1], newminmax);
+		}
+		for (; axis_iter < tree->stop_axis; axis_iter++) {
+			newminmax = dot_v3v3(co_k, bvhtree_kdop_axes[axis_iter]);
+			bv[(2 * axis_iter)]     = min_ff(bv[(2 * axis_iter)],     newminmax);
+			bv[(2 * axis_iter) + 1] = max_ff(bv[(2 * axis_iter) + 1], newminmax);
 		}
 	}
 }
@@ -491,28 +499,25 @@ static void create_kdop_hull(BVHTree *tree, BVHNode *node, const float *co, int
 /**
  * \note depends on the fact that the BVH's for each face is already build
  */
-static void refit_kdop_hull(BVHTree *tree, BVHNode *node, int start, int end)
+static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int end)
 {
-	float newmin, newmax;
 	float *bv = node->bv;
+	const axis_t bv_start = (axis_t)(2 * tree->start_axis);
+	const axis_t bv_stop  = (axis_t)(2 * tree->stop_axis);
 	int j;
 	axis_t axis_iter;
 
 	node_minmax_init(tree, node);
 
 	for (j = start; j < end; j++) {
-		/* for all Axes. */
-		for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
-			newmin = tree->nodes[j]->bv[(2 * axis_iter)];
-			if ((newmin < bv[(2 * axis_iter)]))
-				bv[(2 * axis_iter)] = newmin;
+		const float *node_bv = tree->nodes[j]->bv;
 
-			newmax = tree->nodes[j]->bv[(2 * axis_iter) + 1];
-			if ((newmax > bv[(2 * axis_iter) + 1]))
-				bv[(2 * axis_iter) + 1] = newmax;
+		/* for all Axes, branch-less so the inner loop can be vectorized. */
+		for (axis_iter = bv_start; axis_iter < bv_stop; axis_iter += 2) {
+			bv[axis_iter]     = min_ff(bv[axis_iter],     node_bv[axis_iter]);
+			bv[axis_iter + 1] = max_ff(bv[axis_iter + 1], node_bv[axis_iter + 1]);
 		}
 	}
-
 }
 
 /**
@@ -910,6 +915,304 @@ static void non_recursive_bvh_div_nodes(BVHTree *tree, BVHNode *branches_array,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+
+/** \name SAH Balance
+ *
+ * Binned surface area heuristic build (see #BVH_BALANCE_SAH).
+ *
+ * Unlike the implicit build, the position of the split is chosen to minimize the expected cost of
+ * traversing the children, which gives noticeably faster ray-casts on meshes with uneven density.
+ * Only binary trees are supported since the number of branches of any binary tree is known up-front,
+ * which keeps the branch allocation done by #BLI_bvhtree_new valid.
+ *
+ * Branches are stored in pre-order, so all children still have an index greater than their parent
+ * (needed by #BLI_bvhtree_update_tree).
+ * \{ */
+
+#define BVH_SAH_BINS 16
+
+/* Past this depth splits are done at the median, so degenerate input can't overflow the stack. */
+#define BVH_SAH_DEPTH_MAX 64
+
+/* Approximate number of sub-trees to build in parallel. */
+#define BVH_SAH_TASK_NUM 64
+
+typedef struct BVHSAHBin {
+	float min[3], max[3];
+	int count;
+} BVHSAHBin;
+
+typedef struct BVHSAHSubTree {
+	int branch_index;
+	int begin, end;
+	int depth;
+} BVHSAHSubTree;
+
+typedef struct BVHSAHBuildData {
+	BVHTree *tree;
+	BVHNode *branches_array;
+	BVHNode **leafs_array;
+
+	/* when set, sub-trees smaller than 'subtree_leafs_max' are deferred to be built in parallel */
+	struct BLI_Stack *subtrees;
+	int subtree_leafs_max;
+
+	/* sub-trees to build in parallel, once the top of the tree is done */
+	const BVHSAHSubTree *subtree_array;
+} BVHSAHBuildData;
+
+BLI_INLINE float bvh_sah_centroid(const BVHNode *node, const int axis)
+{
+	return node->bv[(2 * axis)] + node->bv[(2 * axis) + 1];
+}
+
+BLI_INLINE float bvh_sah_half_area(const float min[3], const float max[3])
+{
+	const float d[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+	return (d[0] * d[1]) + (d[1] * d[2]) + (d[2] * d[0]);
+}
+
+BLI_INLINE int bvh_sah_bin_index(const float centroid, const float cent_min, const float bin_scale)
+{
+	const int i = (int)((centroid - cent_min) * bin_scale);
+	return min_ii(i, BVH_SAH_BINS - 1);
+}
+
+static void bvh_sah_bin_init(BVHSAHBin *bin)
+{
+	copy_v3_fl(bin->min,  FLT_MAX);
+	copy_v3_fl(bin->max, -FLT_MAX);
+	bin->count = 0;
+}
+
+static void bvh_sah_bin_expand_bv(BVHSAHBin *bin, const float *bv)
+{
+	int i;
+	for (i = 0; i < 3; i++) {
+		bin->min[i] = min_ff(bin->min[i], bv[(2 * i)]);
+		bin->max[i] = max_ff(bin->max[i], bv[(2 * i) + 1]);
+	}
+}
+
+static void bvh_sah_bin_expand_bin(BVHSAHBin *bin, const BVHSAHBin *other)
+{
+	int i;
+	for (i = 0; i < 3; i++) {
+		bin->min[i] = min_ff(bin->min[i], other->min[i]);
+		bin->max[i] = max_ff(bin->max[i], other->max[i]);
+	}
+	bin->count += other->count;
+}
+
+/**
+ * Split the leafs in [begin, end) in two, returns the index of the first leaf of the second half.
+ * \param r_axis: The axis used to split (0-2).
+ */
+static int bvh_sah_split(BVHNode **leafs_array, const int begin, const int end, const int depth, char *r_axis)
+{
+	float cent_min[3], cent_max[3];
+	float best_cost = FLT_MAX;
+	int best_axis = -1, best_bin = -1;
+	int axis, i;
+
+	INIT_MINMAX(cent_min, cent_max);
+	for (i = begin; i < end; i++) {
+		for (axis = 0; axis < 3; axis++) {
+			const float c = bvh_sah_centroid(leafs_array[i], axis);
+			cent_min[axis] = min_ff(cent_min[axis], c);
+			cent_max[axis] = max_ff(cent_max[axis], c);
+		}
+	}
+
+	if (depth < BVH_SAH_DEPTH_MAX) {
+		for (axis = 0; axis < 3; axis++) {
+			BVHSAHBin bins[BVH_SAH_BINS], accum;
+			float cost_left[BVH_SAH_BINS - 1];
+			const float extent = cent_max[axis] - cent_min[axis];
+			float bin_scale;
+
+			if (extent <= 0.0f) {
+				continue;
+			}
+			bin_scale = (float)BVH_SAH_BINS / extent;
+
+			for (i = 0; i < BVH_SAH_BINS; i++) {
+				bvh_sah_bin_init(&bins[i]);
+			}
+			for (i = begin; i < end; i++) {
+				BVHSAHBin *bin = &bins[bvh_sah_bin_index(
+				        bvh_sah_centroid(leafs_array[i], axis), cent_min[axis], bin_scale)];
+				bvh_sah_bin_expand_bv(bin, leafs_array[i]->bv);
+				bin->count++;
+			}
+
+			/* sweep left to right, then right to left, evaluating every split plane between bins */
+			bvh_sah_bin_init(&accum);
+			for (i = 0; i < BVH_SAH_BINS - 1; i++) {
+				bvh_sah_bin_expand_bin(&accum, &bins[i]);
+				cost_left[i] = accum.count ? bvh_sah_half_area(accum.min, accum.max) * (float)accum.count : 0.0f;
+			}
+			bvh_sah_bin_init(&accum);
+			for (i = BVH_SAH_BINS - 1; i > 0; i--) {
+				bvh_sah_bin_expand_bin(&accum, &bins[i]);
+				if (accum.count && (accum.count != end - begin)) {
+					const float cost = cost_left[i - 1] + (bvh_sah_half_area(accum.min, accum.max) * (float)accum.count);
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin = i;
+					}
+				}
+			}
+		}
+	}
+
+	if (best_axis != -1) {
+		const float bin_scale = (float)BVH_SAH_BINS / (cent_max[best_axis] - cent_min[best_axis]);
+		int i_left = begin, i_right = end - 1;
+
+		while (i_left <= i_right) {
+			if (bvh_sah_bin_index(bvh_sah_centroid(leafs_array[i_left], best_axis),
+			                      cent_min[best_axis], bin_scale) < best_bin)
+			{
+				i_left++;
+			}
+			else {
+				SWAP(BVHNode *, leafs_array[i_left], leafs_array[i_right]);
+				i_right--;
+			}
+		}
+
+		if (i_left != begin && i_left != end) {
+			*r_axis = (char)best_axis;
+			return i_left;
+		}
+	}
+
+	/* all centroids in the same place (or too deep), fall back to a median split */
+	{
+		const int mid = (begin + end) / 2;
+		float cent_extent[3];
+		sub_v3_v3v3(cent_extent, cent_max, cent_min);
+		axis = (cent_extent[0] > cent_extent[1]) ?
+		       ((cent_extent[0] > cent_extent[2]) ? 0 : 2) :
+		       ((cent_extent[1] > cent_extent[2]) ? 1 : 2);
+		partition_nth_element(leafs_array, begin, end, mid, (2 * axis) + 1);
+		*r_axis = (char)axis;
+		return mid;
+	}
+}
+
+static void bvh_sah_build_branch(
+        BVHSAHBuildData *data, const int branch_index, const int begin, const int end, const int depth)
+{
+	BVHNode *node = data->branches_array + branch_index;
+	int mid, k;
+
+	if (data->subtrees && (end - begin) <= data->subtree_leafs_max) {
+		BVHSAHSubTree *subtree = BLI_stack_push_r(data->subtrees);
+		subtree->branch_index = branch_index;
+		subtree->begin = begin;
+		subtree->end = end;
+		subtree->depth = depth;
+		return;
+	}
+
+	refit_kdop_hull(data->tree, node, begin, end);
+	mid = bvh_sah_split(data->leafs_array, begin, end, depth, &node->main_axis);
+
+	{
+		/* the left sub-tree uses (mid - begin - 1) branches, the right one is stored after it */
+		const int child_begin[2] = {begin, mid};
+		const int child_end[2]   = {mid, end};
+		const int child_branch_index[2] = {branch_index + 1, branch_index + (mid - begin)};
+
+		for (k = 0; k < 2; k++) {
+			BVHNode *child;
+			if (child_end[k] - child_begin[k] == 1) {
+				child = data->leafs_array[child_begin[k]];
+			}
+			else {
+				child = data->branches_array + child_branch_index[k];
+				bvh_sah_build_branch(data, child_branch_index[k], child_begin[k], child_end[k], depth + 1);
+			}
+			child->parent = node;
+			node->children[k] = child;
+		}
+		node->totnode = 2;
+	}
+}
+
+static void bvh_sah_build_subtree_task_cb(
+        void *userdata, void *UNUSED(userdata_chunk), const int i, const int UNUSED(threadid))
+{
+	BVHSAHBuildData *data = userdata;
+	const BVHSAHSubTree *subtree = &data->subtree_array[i];
+	BVHSAHBuildData data_local = *data;
+
+	data_local.subtrees = NULL;
+	bvh_sah_build_branch(&data_local, subtree->branch_index, subtree->begin, subtree->end, subtree->depth);
+}
+
+static void bvh_sah_build(BVHTree *tree, BVHNode *branches_array, BVHNode **leafs_array, int num_leafs)
+{
+	BVHSAHBuildData data = {
+		.tree = tree, .branches_array = branches_array, .leafs_array = leafs_array,
+	};
+
+	BLI_assert(tree->tree_type == 2 && tree->start_axis == 0);
+
+	branches_array->parent = NULL;
+
+	if (num_leafs == 0) {
+		/* empty tree, the root has no children (the median split can't divide zero leafs) */
+		branches_array->totnode = 0;
+		return;
+	}
+	else if (num_leafs == 1) {
+		BVHNode *root = branches_array;
+		refit_kdop_hull(tree, root, 0, num_leafs);
+		root->main_axis = get_largest_axis(root->bv) / 2;
+		root->totnode = 1;
+		root->children[0] = leafs_array[0];
+		root->children[0]->parent = root;
+		return;
+	}
+
+	if (num_leafs > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+		/* Build the top of the tree here, deferring the sub-trees to be built in parallel. */
+		BVHSAHSubTree *subtrees;
+		int subtrees_len;
+
+		data.subtrees = BLI_stack_new(sizeof(BVHSAHSubTree), __func__);
+		data.subtree_leafs_max = max_ii(num_leafs / BVH_SAH_TASK_NUM, 2);
+
+		bvh_sah_build_branch(&data, 0, 0, num_leafs, 0);
+
+		subtrees_len = (int)BLI_stack_count(data.subtrees);
+		subtrees = MEM_mallocN(sizeof(*subtrees) * (size_t)subtrees_len, __func__);
+		BLI_stack_pop_n(data.subtrees, subtrees, (unsigned int)subtrees_len);
+		BLI_stack_free(data.subtrees);
+		data.subtrees = NULL;
+		data.subtree_array = subtrees;
+
+		/* Static scheduling, dynamic scheduling takes chunks of 32 iterations and would skip
+		 * the sub-trees entirely when there are fewer than that.
+		 * Tasks still pull chunks from a shared counter so uneven sub-tree sizes are balanced. */
+		BLI_task_parallel_range_ex(
+		        0, subtrees_len, &data, NULL, 0, bvh_sah_build_subtree_task_cb,
+		        true, false);
+
+		MEM_freeN(subtrees);
+	}
+	else {
+		bvh_sah_build_branch(&data, 0, 0, num_leafs, 0);
+	}
+}
+
+/** \} */
+
 
 /* -------------------------------------------------------------------- */
 
@@ -1014,7 +1317,11 @@ void BLI_bvhtree_free(BVHTree *tree)
 	}
 }
 
-void BLI_bvhtree_balance(BVHTree *tree)
+/**
+ * \param flag: #BVH_BALANCE_SAH to split using the surface area heuristic,
+ * this is only supported for binary trees which include the X/Y/Z axes (other trees use median splits).
+ */
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag)
 {
 	int i;
 
@@ -1024,8 +1331,14 @@ void BLI_bvhtree_balance(BVHTree *tree)
 	/* This function should only be called once (some big bug goes here if its being called more than once per tree) */
 	BLI_assert(tree->totbranch == 0);
 
-	/* Build the implicit tree */
-	non_recursive_bvh_div_nodes(tree, branches_array, leafs_array, tree->totleaf);
+	if ((flag & BVH_BALANCE_SAH) && (tree->tree_type == 2) && (tree->start_axis == 0)) {
+		/* Build a binary tree, splitting where the traversal cost is lowest */
+		bvh_sah_build(tree, branches_array, leafs_array, tree->totleaf);
+	}
+	else {
+		/* Build the implicit tree */
+		non_recursive_bvh_div_nodes(tree, branches_array, leafs_array, tree->totleaf);
+	}
 
 	/* current code expects the branches to be linked to the nodes array
 	 * we perform that linkage here */
@@ -1040,6 +1353,11 @@ void BLI_bvhtree_balance(BVHTree *tree)
 	/* bvhtree_info(tree); */
 }
 
+void BLI_bvhtree_balance(BVHTree *tree)
+{
+	BLI_bvhtree_balance_ex(tree, 0);
+}
+
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints)
 {
 	axis_t axis_iter;
@@ -1089,18 +1407,94 @@ bool BLI_bvhtree_update_node(BVHTree *tree, int index, const float co[3], const
 	return true;
 }
 
+/* Approximate number of sub-trees to refit in parallel. */
+#define BVH_REFIT_TASK_NUM 64
+
+typedef struct BVHRefitData {
+	BVHTree *tree;
+	BVHNode **subtree_roots;
+} BVHRefitData;
+
+static void bvhtree_refit_subtree(BVHTree *tree, BVHNode *node)
+{
+	int i;
+	for (i = 0; i < node->totnode; i++) {
+		if (node->children[i]->totnode) {
+			bvhtree_refit_subtree(tree, node->children[i]);
+		}
+	}
+	node_join(tree, node);
+}
+
+static void bvhtree_refit_subtree_task_cb(void *userdata, const int i)
+{
+	BVHRefitData *data = userdata;
+	bvhtree_refit_subtree(data->tree, data->subtree_roots[i]);
+}
+
+/**
+ * Refit the tree by splitting it into sub-trees that are refit in parallel,
+ * the branches above them are joined afterwards.
+ */
+static void bvhtree_update_tree_parallel(BVHTree *tree)
+{
+	BVHNode **branches = MEM_mallocN(sizeof(*branches) * (size_t)tree->totbranch, __func__);
+	int level_begin = 0, level_end = 1;
+	int i, k;
+
+	/* Breadth first, collect branches until there are enough to keep all threads busy */
+	branches[0] = tree->nodes[tree->totleaf];
+	while (level_end - level_begin < BVH_REFIT_TASK_NUM) {
+		int next_level_end = level_end;
+		for (i = level_begin; i < level_end; i++) {
+			BVHNode *node = branches[i];
+			for (k = 0; k < node->totnode; k++) {
+				if (node->children[k]->totnode) {
+					branches[next_level_end++] = node->children[k];
+				}
+			}
+		}
+		if (next_level_end == level_end) {
+			break;
+		}
+		level_begin = level_end;
+		level_end = next_level_end;
+	}
+
+	{
+		BVHRefitData data = {.tree = tree, .subtree_roots = &branches[level_begin]};
+		BLI_task_parallel_range(0, level_end - level_begin, &data, bvhtree_refit_subtree_task_cb, true);
+	}
+
+	/* Children always come after their parent in breadth first order */
+	for (i = level_begin - 1; i >= 0; i--) {
+		node_join(tree, branches[i]);
+	}
+
+	MEM_freeN(branches);
+}
+
 /* call BLI_bvhtree_update_node() first for every node/point/triangle */
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
-	/* Update bottom=>top
-	 * TRICKY: the way we build the tree all the childs have an index greater than the parent
-	 * This allows us todo a bottom up update by starting on the bigger numbered branch */
+	if (tree->totbranch == 0) {
+		return;
+	}
 
-	BVHNode **root  = tree->nodes + tree->totleaf;
-	BVHNode **index = tree->nodes + tree->totleaf + tree->totbranch - 1;
+	if (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+		bvhtree_update_tree_parallel(tree);
+	}
+	else {
+		/* Update bottom=>top
+		 * TRICKY: the way we build the tree all the childs have an index greater than the parent
+		 * This allows us todo a bottom up update by starting on the bigger numbered branch */
+
+		BVHNode **root  = tree->nodes + tree->totleaf;
+		BVHNode **index = tree->nodes + tree->totleaf + tree->totbranch - 1;
 
-	for (; index >= root; index--)
-		node_join(tree, *index);
+		for (; index >= root; index--)
+			node_join(tree, *index);
+	}
 }
 /**
  * Number of times #BLI_bvhtree_insert has been called.
@@ -2037,3 +2431,281 @@ void BLI_bvhtree_walk_dfs(
 }
 
 /** \} */
+
+
+/* -------------------------------------------------------------------- */
+
+/** \name BLI_bvhtree batch queries
+ *
+ * Run many queries at once over the task scheduler, writing results to flat arrays.
+ * Callbacks may run from multiple threads at once, so they must not write to shared data.
+ *
+ * Ray-casts are traversed in packets of consecutive rays, testing a node against all rays of the packet.
+ * This way nodes are only fetched once for coherent rays (neighboring vertices, pixels... etc),
+ * and the bounding volume test is a simple loop over the packet, which can be vectorized.
+ *
+ * \{ */
+
+#define BVH_RAY_PACKET_SIZE 8
+
+/* Number of consecutive nearest queries handled by one task. */
+#define BVH_NEAREST_BATCH_CHUNK_SIZE 256
+
+typedef struct BVHRayPacket {
+	/* per ray state, used for callbacks */
+	BVHRayCastData data[BVH_RAY_PACKET_SIZE];
+
+	/* transposed copy of the ray data, so the rays can be tested together */
+	float origin[3][BVH_RAY_PACKET_SIZE];
+	float idot_axis[3][BVH_RAY_PACKET_SIZE];
+	float hit_dist[BVH_RAY_PACKET_SIZE];
+} BVHRayPacket;
+
+typedef struct BVHRayCastBatchData {
+	BVHTree *tree;
+	const float (*co)[3];
+	const float (*dir)[3];
+	int rays_num;
+	float radius;
+	BVHTreeRayHit *hits;
+
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+	int flag;
+} BVHRayCastBatchData;
+
+typedef struct BVHNearestBatchData {
+	BVHTree *tree;
+	const float (*co)[3];
+	int co_num;
+	BVHTreeNearest *nearest;
+
+	BVHTree_NearestPointCallback callback;
+	void *userdata;
+} BVHNearestBatchData;
+
+/**
+ * Same test as #fast_ray_nearest_hit for all rays of the packet.
+ * \return the rays of \a mask hitting the node, \a r_dist is the distance for each ray.
+ */
+static unsigned int ray_packet_nearest_hit(
+        const BVHRayPacket *packet, const BVHNode *node, const unsigned int mask,
+        float r_dist[BVH_RAY_PACKET_SIZE])
+{
+	const float *bv = node->bv;
+	unsigned int mask_hit = 0;
+	int r, axis;
+
+	for (r = 0; r < BVH_RAY_PACKET_SIZE; r++) {
+		float t_entry = -FLT_MAX, t_exit = FLT_MAX;
+
+		for (axis = 0; axis < 3; axis++) {
+			const float t1 = (bv[(2 * axis)]     - packet->origin[axis][r]) * packet->idot_axis[axis][r];
+			const float t2 = (bv[(2 * axis) + 1] - packet->origin[axis][r]) * packet->idot_axis[axis][r];
+			t_entry = max_ff(t_entry, min_ff(t1, t2));
+			t_exit  = min_ff(t_exit,  max_ff(t1, t2));
+		}
+
+		r_dist[r] = t_entry;
+		mask_hit |= (unsigned int)((t_entry <= t_exit) && (t_exit >= 0.0f) &&
+		                           (t_entry < packet->hit_dist[r])) << r;
+	}
+
+	return mask_hit & mask;
+}
+
+static void dfs_raycast_packet(BVHRayPacket *packet, BVHNode *node, unsigned int mask)
+{
+	float dist[BVH_RAY_PACKET_SIZE];
+	int i, r;
+
+	mask = ray_packet_nearest_hit(packet, node, mask, dist);
+	if (mask == 0) {
+		return;
+	}
+
+	if ((node->totnode != 0) && (count_bits_i(mask) == 1)) {
+		/* diverged rays are faster to traverse on their own */
+		for (r = 0; (mask & (1u << r)) == 0; r++) {
+			/* pass */
+		}
+		dfs_raycast(&packet->data[r], node);
+		packet->hit_dist[r] = packet->data[r].hit.dist;
+	}
+	else if (node->totnode == 0) {
+		for (r = 0; r < BVH_RAY_PACKET_SIZE; r++) {
+			if (mask & (1u << r)) {
+				BVHRayCastData *data = &packet->data[r];
+				if (data->callback) {
+					data->callback(data->userdata, node->index, &data->ray, &data->hit);
+				}
+				else {
+					data->hit.index = node->index;
+					data->hit.dist  = dist[r];
+					madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[r]);
+				}
+				packet->hit_dist[r] = data->hit.dist;
+			}
+		}
+	}
+	else {
+		/* pick loop direction from the first active ray of the packet */
+		const BVHRayCastData *data_first;
+		for (r = 0; (mask & (1u << r)) == 0; r++) {
+			/* pass */
+		}
+		data_first = &packet->data[r];
+
+		if (data_first->ray_dot_axis[node->main_axis] > 0.0f) {
+			for (i = 0; i != node->totnode; i++) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+		else {
+			for (i = node->totnode - 1; i >= 0; i--) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+	}
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *userdata, const int packet_index)
+{
+	const BVHRayCastBatchData *batch = userdata;
+	BVHNode *root = batch->tree->nodes[batch->tree->totleaf];
+	BVHRayPacket packet;
+	const int ray_start = packet_index * BVH_RAY_PACKET_SIZE;
+	const int rays_num = min_ii(BVH_RAY_PACKET_SIZE, batch->rays_num - ray_start);
+	unsigned int mask = 0;
+	int r, axis;
+
+	for (r = 0; r < BVH_RAY_PACKET_SIZE; r++) {
+		BVHRayCastData *data = &packet.data[r];
+
+		if (r < rays_num) {
+			BLI_ASSERT_UNIT_V3(batch->dir[ray_start + r]);
+
+			data->tree = batch->tree;
+			data->callback = batch->callback;
+			data->userdata = batch->userdata;
+
+			copy_v3_v3(data->ray.origin,    batch->co[ray_start + r]);
+			copy_v3_v3(data->ray.direction, batch->dir[ray_start + r]);
+			data->ray.radius = batch->radius;
+
+			bvhtree_ray_cast_data_precalc(data, batch->flag);
+			data->hit = batch->hits[ray_start + r];
+
+			for (axis = 0; axis < 3; axis++) {
+				packet.origin[axis][r] = data->ray.origin[axis];
+				packet.idot_axis[axis][r] = data->idot_axis[axis];
+			}
+			packet.hit_dist[r] = data->hit.dist;
+
+			mask |= 1u << r;
+		}
+		else {
+			/* unused rays never hit */
+			for (axis = 0; axis < 3; axis++) {
+				packet.origin[axis][r] = 0.0f;
+				packet.idot_axis[axis][r] = 0.0f;
+			}
+			packet.hit_dist[r] = -FLT_MAX;
+		}
+	}
+
+	if (root) {
+		/* XXX: see dfs_raycast, the packet test doesn't support ray.radius either */
+		if (batch->radius == 0.0f) {
+			dfs_raycast_packet(&packet, root, mask);
+		}
+		else {
+			for (r = 0; r < rays_num; r++) {
+				dfs_raycast(&packet.data[r], root);
+			}
+		}
+	}
+
+	for (r = 0; r < rays_num; r++) {
+		batch->hits[ray_start + r] = packet.data[r].hit;
+	}
+}
+
+/**
+ * Cast many rays, the equivalent of calling #BLI_bvhtree_ray_cast_ex for each one.
+ *
+ * \param r_hits: Must be initialized by the caller (as for a single ray-cast),
+ * the index is -1 for rays that don't hit anything.
+ * \note Consecutive rays are traversed together, so keeping coherent rays next to each other is faster.
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], const int rays_num, float radius,
+        BVHTreeRayHit *r_hits,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHRayCastBatchData batch = {
+		.tree = tree, .co = co, .dir = dir, .rays_num = rays_num, .radius = radius, .hits = r_hits,
+		.callback = callback, .userdata = userdata, .flag = flag,
+	};
+	const int packets_num = (rays_num + (BVH_RAY_PACKET_SIZE - 1)) / BVH_RAY_PACKET_SIZE;
+
+	BLI_task_parallel_range(
+	        0, packets_num, &batch, bvhtree_ray_cast_batch_task_cb,
+	        rays_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+}
+
+static void bvhtree_find_nearest_batch_task_cb(void *userdata, const int chunk_index)
+{
+	const BVHNearestBatchData *batch = userdata;
+	const int i_start = chunk_index * BVH_NEAREST_BATCH_CHUNK_SIZE;
+	const int i_end = min_ii(i_start + BVH_NEAREST_BATCH_CHUNK_SIZE, batch->co_num);
+	int i;
+
+	for (i = i_start; i < i_end; i++) {
+		BVHTreeNearest *nearest = &batch->nearest[i];
+
+		/* Use local proximity heuristics (to reduce the nearest search),
+		 * the previous result is an upper bound of the distance to the surface. */
+		if (i != i_start) {
+			const BVHTreeNearest *nearest_prev = &batch->nearest[i - 1];
+			if (nearest_prev->index != -1) {
+				const float dist_sq = len_squared_v3v3(batch->co[i], nearest_prev->co);
+				if (dist_sq < nearest->dist_sq) {
+					nearest->index = nearest_prev->index;
+					nearest->dist_sq = dist_sq;
+					copy_v3_v3(nearest->co, nearest_prev->co);
+					copy_v3_v3(nearest->no, nearest_prev->no);
+				}
+			}
+		}
+
+		BLI_bvhtree_find_nearest(batch->tree, batch->co[i], nearest, batch->callback, batch->userdata);
+	}
+}
+
+/**
+ * Find the nearest element for many coordinates,
+ * the equivalent of calling #BLI_bvhtree_find_nearest for each one.
+ *
+ * \param r_nearest: Must be initialized by the caller (as for a single search, ``dist_sq`` limits the search),
+ * the index is -1 when nothing is found.
+ * \note Consecutive coordinates should be close to each other (as vertices of a mesh usually are),
+ * since each search is bounded by the result of the previous one.
+ */
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], const int co_num, BVHTreeNearest *r_nearest,
+        BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHNearestBatchData batch = {
+		.tree = tree, .co = co, .co_num = co_num, .nearest = r_nearest,
+		.callback = callback, .userdata = userdata,
+	};
+	const int chunks_num = (co_num + (BVH_NEAREST_BATCH_CHUNK_SIZE - 1)) / BVH_NEAREST_BATCH_CHUNK_SIZE;
+
+	BLI_task_parallel_range(
+	        0, chunks_num, &batch, bvhtree_find_nearest_batch_task_cb,
+	        co_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+}
+
+/** \} */
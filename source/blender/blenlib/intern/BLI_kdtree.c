@@ -29,6 +29,8 @@
 
 #include "BLI_math.h"
 #include "BLI_kdtree.h"
+#include "BLI_stack.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 #include "BLI_strict_flags.h"
 
@@ -61,6 +63,20 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((unsigned int)-1)
 
+/* Trees with more nodes (or batches with more queries) than this use threads,
+ * zero for debug builds so the threaded code is tested with small trees too. */
+#ifdef DEBUG
+#  define KD_THREAD_THRESHOLD 0
+#else
+#  define KD_THREAD_THRESHOLD 10000
+#endif
+
+/* Number of sub-trees to balance in parallel (approximately). */
+#define KD_BALANCE_TASK_NUM 64
+
+/* Number of consecutive queries of a batch handled by one task. */
+#define KD_BATCH_CHUNK_SIZE 256
+
 /**
  * Creates or free a kdtree
  */
@@ -113,17 +129,56 @@ void BLI_kdtree_insert(KDTree *tree, int index, const float co[3])
 #endif
 }
 
-static unsigned int kdtree_balance(KDTreeNode *nodes, unsigned int totnode, unsigned int axis, const unsigned int ofs)
+typedef struct KDTreeBalanceSubTree {
+	unsigned int ofs_src, totnode, axis, ofs_dst;
+} KDTreeBalanceSubTree;
+
+typedef struct KDTreeBalanceData {
+	KDTreeNode *nodes_src;
+	KDTreeNode *nodes_dst;
+
+	/* when set, sub-trees up to 'subtree_totnode_max' nodes are deferred to be balanced in parallel */
+	BLI_Stack *subtrees;
+	unsigned int subtree_totnode_max;
+
+	const KDTreeBalanceSubTree *subtree_array;
+} KDTreeBalanceData;
+
+/**
+ * Sort \a nodes around the median (recursively), storing the result in depth first order,
+ * so a node is followed by its left sub-tree, then its right sub-tree.
+ * This keeps nodes close to their parent in memory, for faster searches.
+ *
+ * \param nodes: Nodes to balance, used as scratch space for sorting.
+ * \param ofs_dst: Where to store this sub-tree in \a data->nodes_dst.
+ * \return The index of the root node in \a data->nodes_dst.
+ */
+static unsigned int kdtree_balance(
+        KDTreeBalanceData *data, KDTreeNode *nodes, unsigned int totnode, unsigned int axis,
+        const unsigned int ofs_dst)
 {
-	KDTreeNode *node;
+	KDTreeNode *node_dst;
 	float co;
 	unsigned int left, right, median, i, j;
 
-	if (totnode <= 0)
+	if (totnode <= 0) {
 		return KD_NODE_UNSET;
-	else if (totnode == 1)
-		return 0 + ofs;
-	
+	}
+	else if (totnode == 1) {
+		node_dst = &data->nodes_dst[ofs_dst];
+		*node_dst = nodes[0];
+		node_dst->left = node_dst->right = KD_NODE_UNSET;
+		return ofs_dst;
+	}
+	else if (data->subtrees && (totnode <= data->subtree_totnode_max)) {
+		KDTreeBalanceSubTree *subtree = BLI_stack_push_r(data->subtrees);
+		subtree->ofs_src = (unsigned int)(nodes - data->nodes_src);
+		subtree->totnode = totnode;
+		subtree->axis = axis;
+		subtree->ofs_dst = ofs_dst;
+		return ofs_dst;
+	}
+
 	/* quicksort style sorting around median */
 	left = 0;
 	right = totnode - 1;
@@ -152,18 +207,68 @@ static unsigned int kdtree_balance(KDTreeNode *nodes, unsigned int totnode, unsi
 	}
 
 	/* set node and sort subnodes */
-	node = &nodes[median];
-	node->d = axis;
+	node_dst = &data->nodes_dst[ofs_dst];
+	*node_dst = nodes[median];
+	node_dst->d = axis;
 	axis = (axis + 1) % 3;
-	node->left = kdtree_balance(nodes, median, axis, ofs);
-	node->right = kdtree_balance(nodes + median + 1, (totnode - (median + 1)), axis, (median + 1) + ofs);
+	node_dst->left = kdtree_balance(data, nodes, median, axis, ofs_dst + 1);
+	node_dst->right = kdtree_balance(data, nodes + median + 1, (totnode - (median + 1)), axis, ofs_dst + 1 + median);
 
-	return median + ofs;
+	return ofs_dst;
+}
+
+static void kdtree_balance_subtree_task_cb(
+        void *userdata, void *UNUSED(userdata_chunk), const int i, const int UNUSED(threadid))
+{
+	KDTreeBalanceData *data = userdata;
+	const KDTreeBalanceSubTree *subtree = &data->subtree_array[i];
+	KDTreeBalanceData data_local = *data;
+
+	data_local.subtrees = NULL;
+	kdtree_balance(
+	        &data_local, &data->nodes_src[subtree->ofs_src], subtree->totnode, subtree->axis,
+	        subtree->ofs_dst);
 }
 
 void BLI_kdtree_balance(KDTree *tree)
 {
-	tree->root = kdtree_balance(tree->nodes, tree->totnode, 0, 0);
+	KDTreeBalanceData data = {NULL};
+
+	/* keep the same capacity, so points can still be inserted and the tree balanced again */
+	data.nodes_src = tree->nodes;
+	data.nodes_dst = MEM_mallocN(MEM_allocN_len(tree->nodes), "KDTreeNode");
+
+	if (tree->totnode > KD_THREAD_THRESHOLD) {
+		/* Balance the top of the tree here, the sub-trees are disjoint and balanced in parallel. */
+		KDTreeBalanceSubTree *subtrees;
+		unsigned int subtrees_len;
+
+		data.subtrees = BLI_stack_new(sizeof(KDTreeBalanceSubTree), __func__);
+		/* single nodes are stored right away, so small trees need at least two per sub-tree */
+		data.subtree_totnode_max = MAX2(tree->totnode / KD_BALANCE_TASK_NUM, 2u);
+
+		tree->root = kdtree_balance(&data, data.nodes_src, tree->totnode, 0, 0);
+
+		subtrees_len = (unsigned int)BLI_stack_count(data.subtrees);
+		subtrees = MEM_mallocN(sizeof(*subtrees) * subtrees_len, __func__);
+		BLI_stack_pop_n(data.subtrees, subtrees, subtrees_len);
+		BLI_stack_free(data.subtrees);
+		data.subtrees = NULL;
+		data.subtree_array = subtrees;
+
+		/* Not dynamic scheduling, which runs no tasks at all with fewer sub-trees than its chunk size. */
+		BLI_task_parallel_range_ex(
+		        0, (int)subtrees_len, &data, NULL, 0, kdtree_balance_subtree_task_cb,
+		        true, false);
+
+		MEM_freeN(subtrees);
+	}
+	else {
+		tree->root = kdtree_balance(&data, data.nodes_src, tree->totnode, 0, 0);
+	}
+
+	MEM_freeN(tree->nodes);
+	tree->nodes = data.nodes_dst;
 
 #ifdef DEBUG
 	tree->is_balanced = true;
@@ -674,3 +779,166 @@ finally:
 	if (stack != defaultstack)
 		MEM_freeN(stack);
 }
+
+/**
+ * Same as #BLI_kdtree_find_nearest_n, limited to \a range_sq (without normal support).
+ * Doesn't allocate memory unless the tree is very deep.
+ */
+static unsigned int kdtree_find_nearest_n_range(
+        const KDTree *tree, const float co[3], const float range_sq,
+        KDTreeNearest r_nearest[], const unsigned int n)
+{
+	const KDTreeNode *nodes = tree->nodes;
+	unsigned int *stack, defaultstack[KD_STACK_INIT];
+	float cur_dist;
+	unsigned int totstack, cur = 0;
+	unsigned int i, found = 0;
+
+#ifdef DEBUG
+	BLI_assert(tree->is_balanced == true);
+#endif
+
+	if (UNLIKELY((tree->root == KD_NODE_UNSET) || n == 0))
+		return 0;
+
+	stack = defaultstack;
+	totstack = KD_STACK_INIT;
+
+	stack[cur++] = tree->root;
+
+	/* until 'n' points are found, accept any point in range, then only points nearer than the last one */
+#define NODE_DIST_TEST(dist_sq) \
+	((found < n) ? ((dist_sq) <= range_sq) : ((dist_sq) < r_nearest[found - 1].dist))
+
+	while (cur--) {
+		const KDTreeNode *node = &nodes[stack[cur]];
+
+		cur_dist = node->co[node->d] - co[node->d];
+
+		if (cur_dist < 0.0f) {
+			cur_dist = cur_dist * cur_dist;
+
+			if (NODE_DIST_TEST(cur_dist)) {
+				cur_dist = len_squared_v3v3(node->co, co);
+				if (NODE_DIST_TEST(cur_dist))
+					add_nearest(r_nearest, &found, n, node->index, cur_dist, node->co);
+
+				if (node->left != KD_NODE_UNSET)
+					stack[cur++] = node->left;
+			}
+			if (node->right != KD_NODE_UNSET)
+				stack[cur++] = node->right;
+		}
+		else {
+			cur_dist = cur_dist * cur_dist;
+
+			if (NODE_DIST_TEST(cur_dist)) {
+				cur_dist = len_squared_v3v3(node->co, co);
+				if (NODE_DIST_TEST(cur_dist))
+					add_nearest(r_nearest, &found, n, node->index, cur_dist, node->co);
+
+				if (node->right != KD_NODE_UNSET)
+					stack[cur++] = node->right;
+			}
+			if (node->left != KD_NODE_UNSET)
+				stack[cur++] = node->left;
+		}
+		if (UNLIKELY(cur + 3 > totstack)) {
+			stack = realloc_nodes(stack, &totstack, defaultstack != stack);
+		}
+	}
+
+#undef NODE_DIST_TEST
+
+	for (i = 0; i < found; i++)
+		r_nearest[i].dist = sqrtf(r_nearest[i].dist);
+
+	if (stack != defaultstack)
+		MEM_freeN(stack);
+
+	return found;
+}
+
+typedef struct KDTreeBatchData {
+	const KDTree *tree;
+	const float (*co)[3];
+	unsigned int co_num;
+
+	float range_sq;
+	unsigned int n;
+
+	KDTreeNearest *nearest;
+	unsigned int *found;
+} KDTreeBatchData;
+
+static void kdtree_find_nearest_batch_task_cb(void *userdata, const int chunk_index)
+{
+	const KDTreeBatchData *data = userdata;
+	const unsigned int i_start = (unsigned int)chunk_index * KD_BATCH_CHUNK_SIZE;
+	const unsigned int i_end = MIN2(i_start + KD_BATCH_CHUNK_SIZE, data->co_num);
+	unsigned int i;
+
+	for (i = i_start; i < i_end; i++) {
+		data->nearest[i].index = -1;
+		BLI_kdtree_find_nearest(data->tree, data->co[i], &data->nearest[i]);
+	}
+}
+
+static void kdtree_find_nearest_n_batch_task_cb(void *userdata, const int chunk_index)
+{
+	const KDTreeBatchData *data = userdata;
+	const unsigned int i_start = (unsigned int)chunk_index * KD_BATCH_CHUNK_SIZE;
+	const unsigned int i_end = MIN2(i_start + KD_BATCH_CHUNK_SIZE, data->co_num);
+	unsigned int i;
+
+	for (i = i_start; i < i_end; i++) {
+		data->found[i] = kdtree_find_nearest_n_range(
+		        data->tree, data->co[i], data->range_sq, &data->nearest[(size_t)i * data->n], data->n);
+	}
+}
+
+static void kdtree_batch_run(KDTreeBatchData *data, TaskParallelRangeFunc func)
+{
+	const int chunks_num = (int)((data->co_num + (KD_BATCH_CHUNK_SIZE - 1)) / KD_BATCH_CHUNK_SIZE);
+	BLI_task_parallel_range(0, chunks_num, data, func, data->co_num > KD_THREAD_THRESHOLD);
+}
+
+/**
+ * Find the nearest point for each of \a co, running the searches in parallel.
+ *
+ * \param r_nearest: An array sized \a co_num, the index is -1 when the tree is empty.
+ */
+void BLI_kdtree_find_nearest_batch(
+        const KDTree *tree, const float (*co)[3], const unsigned int co_num,
+        KDTreeNearest *r_nearest)
+{
+	KDTreeBatchData data = {
+		.tree = tree, .co = co, .co_num = co_num,
+		.nearest = r_nearest,
+	};
+
+	kdtree_batch_run(&data, kdtree_find_nearest_batch_task_cb);
+}
+
+/**
+ * Find up to \a n nearest points within \a range for each of \a co, running the searches in parallel.
+ * Results are written to preallocated arrays, so this can also be used as a bounded range search.
+ *
+ * \param range: Maximum distance, use FLT_MAX for no limit.
+ * \param r_nearest: An array sized ``co_num * n``, results of ``co[i]`` start at ``r_nearest[i * n]``,
+ * sorted by distance.
+ * \param r_found: An array sized \a co_num, the number of points found for each search.
+ */
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], const unsigned int co_num,
+        const float range, const unsigned int n,
+        KDTreeNearest *r_nearest, unsigned int *r_found)
+{
+	KDTreeBatchData data = {
+		.tree = tree, .co = co, .co_num = co_num,
+		.range_sq = (range < sqrtf(FLT_MAX)) ? (range * range) : FLT_MAX, .n = n,
+		.nearest = r_nearest, .found = r_found,
+	};
+
+	kdtree_batch_run(&data, kdtree_find_nearest_n_batch_task_cb);
+}
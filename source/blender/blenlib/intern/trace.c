@@ -0,0 +1,390 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/trace.c
+ *  \ingroup bli
+ *
+ * Timeline recording, events are only stored in memory while recording,
+ * the file is written by #BLI_trace_stop.
+ *
+ * Output is the Chrome trace event format, using begin/end ('B'/'E') duration events.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "atomic_ops.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"
+
+#include "PIL_time.h"
+
+#include "BLI_strict_flags.h"
+
+#define TRACE_THREADS_MAX 256
+
+typedef struct TraceEvent {
+	const char *name;
+	double time;
+	int thread_index;
+	char phase;
+} TraceEvent;
+
+static struct {
+	/* Always accessed atomically, so #BLI_trace_begin can check it without the lock,
+	 * only changed with the lock held. Everything else is only accessed with the lock held. */
+	uint32_t is_active;
+	char *filepath;
+	double time_start;
+
+	TraceEvent *events;
+	unsigned int events_len, events_alloc;
+
+	/* thread index (as written) is the position in this array */
+	pthread_t threads[TRACE_THREADS_MAX];
+	int threads_len;
+
+	/* Initialized by the first #BLI_trace_start and kept until exit,
+	 * threads may still be waiting on it while recording stops. */
+	SpinLock lock;
+	bool lock_is_init;
+} g_trace = {0};
+
+static bool trace_is_active(void)
+{
+	return atomic_fetch_and_add_uint32(&g_trace.is_active, 0) != 0;
+}
+
+/**
+ * Start recording, previous recordings are discarded.
+ *
+ * \note Must be called from the main thread, before other threads record events.
+ */
+void BLI_trace_start(const char *filepath)
+{
+	if (trace_is_active()) {
+		BLI_trace_stop();
+	}
+
+	if (g_trace.lock_is_init == false) {
+		BLI_spin_init(&g_trace.lock);
+		g_trace.lock_is_init = true;
+	}
+
+	BLI_spin_lock(&g_trace.lock);
+	g_trace.filepath = BLI_strdup(filepath);
+	g_trace.time_start = PIL_check_seconds_timer();
+	g_trace.events = NULL;
+	g_trace.events_len = 0;
+	g_trace.events_alloc = 0;
+	g_trace.threads_len = 0;
+	atomic_fetch_and_or_uint32(&g_trace.is_active, 1);
+	BLI_spin_unlock(&g_trace.lock);
+}
+
+bool BLI_trace_is_active(void)
+{
+	return trace_is_active();
+}
+
+/* caller must lock */
+static int trace_thread_index(void)
+{
+	const pthread_t thread = pthread_self();
+	int i;
+
+	for (i = 0; i < g_trace.threads_len; i++) {
+		if (pthread_equal(g_trace.threads[i], thread)) {
+			return i;
+		}
+	}
+
+	if (g_trace.threads_len == TRACE_THREADS_MAX) {
+		/* share the last index, unlikely to happen */
+		return TRACE_THREADS_MAX - 1;
+	}
+
+	g_trace.threads[g_trace.threads_len] = thread;
+	return g_trace.threads_len++;
+}
+
+/* caller must lock */
+static void trace_event_add_ex(const char *name, const char phase, const double time, const int thread_index)
+{
+	TraceEvent *event;
+
+	if (UNLIKELY(g_trace.events_len == g_trace.events_alloc)) {
+		g_trace.events_alloc = g_trace.events_alloc ? g_trace.events_alloc * 2 : 1024;
+		g_trace.events = MEM_reallocN_id(
+		        g_trace.events, sizeof(*g_trace.events) * g_trace.events_alloc, __func__);
+	}
+
+	event = &g_trace.events[g_trace.events_len++];
+	event->name = name;
+	event->time = time;
+	event->thread_index = thread_index;
+	event->phase = phase;
+}
+
+static void trace_event_add(const char *name, const char phase)
+{
+	const double time = PIL_check_seconds_timer();
+
+	BLI_spin_lock(&g_trace.lock);
+	/* recording may have stopped since the caller checked */
+	if (trace_is_active()) {
+		trace_event_add_ex(name, phase, time, trace_thread_index());
+	}
+	BLI_spin_unlock(&g_trace.lock);
+}
+
+void BLI_trace_begin(const char *name)
+{
+	if (trace_is_active()) {
+		trace_event_add(name, 'B');
+	}
+}
+
+void BLI_trace_end(const char *name)
+{
+	if (trace_is_active()) {
+		trace_event_add(name, 'E');
+	}
+}
+
+/**
+ * End events which are still open at \a time, innermost first,
+ * so exiting part way through a stage (background mode for e.g.) still writes it.
+ *
+ * Caller must lock.
+ */
+static void trace_events_close_open(const double time)
+{
+	const unsigned int events_len = g_trace.events_len;
+	int thread_index;
+
+	for (thread_index = 0; thread_index < g_trace.threads_len; thread_index++) {
+		unsigned int depth = 0;
+		unsigned int i;
+		for (i = events_len; i--; ) {
+			const TraceEvent *event = &g_trace.events[i];
+			if (event->thread_index != thread_index) {
+				continue;
+			}
+			if (event->phase == 'E') {
+				depth++;
+			}
+			else if (depth != 0) {
+				depth--;
+			}
+			else {
+				/* may reallocate, don't use 'event' after this */
+				trace_event_add_ex(event->name, 'E', time, thread_index);
+			}
+		}
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Trace File Writing
+ * \{ */
+
+struct TraceWriter {
+	FILE *fp;
+	bool is_empty;
+};
+
+static void trace_write_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		const unsigned char c = (unsigned char)*str;
+		if (ELEM(c, '"', '\\')) {
+			fputc('\\', fp);
+			fputc(c, fp);
+		}
+		else if (c < 0x20) {
+			fprintf(fp, "\\u%04x", c);
+		}
+		else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+static void trace_write_separator(TraceWriter *tw)
+{
+	fputs(tw->is_empty ? "" : ",\n", tw->fp);
+	tw->is_empty = false;
+}
+
+/**
+ * \return NULL when the file can't be opened.
+ */
+TraceWriter *BLI_trace_writer_open(const char *filepath)
+{
+	TraceWriter *tw;
+	FILE *fp = BLI_fopen(filepath, "w");
+
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	tw = MEM_mallocN(sizeof(*tw), __func__);
+	tw->fp = fp;
+	tw->is_empty = true;
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	return tw;
+}
+
+/**
+ * Finish and close the file, \a tw is freed.
+ *
+ * \return Success, false when any write failed.
+ */
+bool BLI_trace_writer_close(TraceWriter *tw)
+{
+	bool ok;
+
+	fprintf(tw->fp, "\n]}\n");
+	ok = (ferror(tw->fp) == 0);
+	if (fclose(tw->fp) != 0) {
+		ok = false;
+	}
+	MEM_freeN(tw);
+	return ok;
+}
+
+/**
+ * \param phase: 'B'/'E' for begin/end events, 'X' for complete events which use \a duration.
+ * \param category: Optional.
+ * \param args: Optional, written as-is so it must be a JSON object.
+ */
+void BLI_trace_writer_event(
+        TraceWriter *tw, const char *name, const char *category, const char phase,
+        const double time, const double duration, const int thread_index,
+        const char *args)
+{
+	FILE *fp = tw->fp;
+
+	trace_write_separator(tw);
+	fprintf(fp, "{\"name\": ");
+	trace_write_string(fp, name);
+	if (category) {
+		fprintf(fp, ", \"cat\": ");
+		trace_write_string(fp, category);
+	}
+	fprintf(fp, ", \"ph\": \"%c\", \"ts\": %.3f", phase, time * 1e6);
+	if (phase == 'X') {
+		fprintf(fp, ", \"dur\": %.3f", duration * 1e6);
+	}
+	fprintf(fp, ", \"pid\": 1, \"tid\": %d", thread_index);
+	if (args) {
+		fprintf(fp, ", \"args\": %s", args);
+	}
+	fputc('}', fp);
+}
+
+/**
+ * Label the track of \a thread_index in the viewer.
+ */
+void BLI_trace_writer_thread_name(TraceWriter *tw, const int thread_index, const char *name)
+{
+	FILE *fp = tw->fp;
+
+	trace_write_separator(tw);
+	fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": ",
+	        thread_index);
+	trace_write_string(fp, name);
+	fprintf(fp, "}}");
+}
+
+/** \} */
+
+/**
+ * Stop recording and write the events.
+ *
+ * \return Success, false when not recording or the file can't be written.
+ */
+bool BLI_trace_stop(void)
+{
+	TraceWriter *tw;
+	char *filepath;
+	double time_start;
+	TraceEvent *events;
+	unsigned int events_len;
+	unsigned int i;
+	bool ok = false;
+
+	if (!trace_is_active()) {
+		return false;
+	}
+
+	/* take the events, so they are written & freed while other threads can't add to them */
+	BLI_spin_lock(&g_trace.lock);
+	if (!trace_is_active()) {
+		BLI_spin_unlock(&g_trace.lock);
+		return false;
+	}
+	trace_events_close_open(PIL_check_seconds_timer());
+	atomic_fetch_and_and_uint32(&g_trace.is_active, 0);
+	filepath = g_trace.filepath;
+	time_start = g_trace.time_start;
+	events = g_trace.events;
+	events_len = g_trace.events_len;
+	g_trace.filepath = NULL;
+	g_trace.events = NULL;
+	g_trace.events_len = 0;
+	g_trace.events_alloc = 0;
+	BLI_spin_unlock(&g_trace.lock);
+
+	tw = BLI_trace_writer_open(filepath);
+	if (tw) {
+		for (i = 0; i < events_len; i++) {
+			const TraceEvent *event = &events[i];
+			BLI_trace_writer_event(
+			        tw, event->name, NULL, event->phase,
+			        event->time - time_start, 0.0, event->thread_index, NULL);
+		}
+		ok = BLI_trace_writer_close(tw);
+	}
+
+	if (ok) {
+		printf("Trace written to '%s'\n", filepath);
+	}
+	else {
+		fprintf(stderr, "Unable to write trace to '%s'\n", filepath);
+	}
+
+	if (events) {
+		MEM_freeN(events);
+	}
+	MEM_freeN(filepath);
+
+	return ok;
+}
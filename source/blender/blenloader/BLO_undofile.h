@@ -39,6 +39,8 @@ typedef struct {
 	char *buf;
 	unsigned int ident, size;
 	
+	/* address of the ID this chunk is part of, only used to find it in the next undo step */
+	const void *id;
 } MemFileChunk;
 
 typedef struct MemFile {
@@ -46,8 +48,22 @@ typedef struct MemFile {
 	unsigned int size;
 } MemFile;
 
+/* state while writing a memfile (chunks are shared with 'compare' when identical) */
+typedef struct MemFileWriteData {
+	MemFile *compare, *current;
+	/* next chunk of 'compare' to check for identical data */
+	MemFileChunk *compare_chunk;
+	/* ID address -> first chunk of this ID in 'compare' */
+	struct GHash *id_chunk_map;
+	/* the ID being written */
+	const void *id;
+} MemFileWriteData;
+
 /* actually only used writefile.c */
-extern void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size);
+extern void memfile_write_init(MemFileWriteData *mem_data, MemFile *compare, MemFile *current);
+extern void memfile_write_id_begin(MemFileWriteData *mem_data, const void *id);
+extern void memfile_write_finalize(MemFileWriteData *mem_data);
+extern void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
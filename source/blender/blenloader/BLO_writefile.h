@@ -44,5 +44,14 @@ extern bool BLO_write_file(
 extern bool BLO_write_file_mem(
         struct Main *mainvar, struct MemFile *compare, struct MemFile *current, int write_flags);
 
+typedef struct BlendWriteAsync BlendWriteAsync;
+
+extern BlendWriteAsync *BLO_write_file_async_begin(
+        struct Main *mainvar, const char *filepath, int write_flags,
+        struct ReportList *reports, const struct BlendThumbnail *thumb);
+extern bool BLO_write_file_async_write(BlendWriteAsync *wa, struct ReportList *reports);
+extern const char *BLO_write_file_async_filepath(const BlendWriteAsync *wa);
+extern void BLO_write_file_async_free(BlendWriteAsync *wa);
+
 #endif
 
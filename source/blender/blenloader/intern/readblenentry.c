@@ -46,6 +46,7 @@
 #include "BLI_linklist.h"
 #include "BLI_listbase.h"
 #include "BLI_string.h"
+#include "BLI_trace.h"
 
 #include "DNA_genfile.h"
 #include "DNA_sdna_types.h"
@@ -324,6 +325,8 @@ BlendFileData *BLO_read_from_file(
 	BlendFileData *bfd = NULL;
 	FileData *fd;
 		
+	BLI_trace_begin("BLO_read_from_file");
+
 	fd = blo_openblenderfile(filepath, reports);
 	if (fd) {
 		fd->reports = reports;
@@ -332,6 +335,8 @@ BlendFileData *BLO_read_from_file(
 		blo_freefiledata(fd);
 	}
 
+	BLI_trace_end("BLO_read_from_file");
+
 	return bfd;
 }
 
@@ -351,6 +356,8 @@ BlendFileData *BLO_read_from_memory(
 	BlendFileData *bfd = NULL;
 	FileData *fd;
 		
+	BLI_trace_begin("BLO_read_from_memory");
+
 	fd = blo_openblendermemory(mem, memsize,  reports);
 	if (fd) {
 		fd->reports = reports;
@@ -359,6 +366,8 @@ BlendFileData *BLO_read_from_memory(
 		blo_freefiledata(fd);
 	}
 
+	BLI_trace_end("BLO_read_from_memory");
+
 	return bfd;
 }
 
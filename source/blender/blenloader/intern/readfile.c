@@ -51,6 +51,18 @@
 #  include "BLI_winstuff.h"
 #endif
 
+/* Memory map uncompressed files which match the pointer size and endianness of this build,
+ * BHead's and their data are then accessed in-place instead of being read into allocations.
+ * Only enabled where unaligned access is supported (BHead's are only 4 byte aligned in the file). */
+#if !defined(WIN32) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#  define USE_BHEAD_MMAP
+#endif
+
+#ifdef USE_BHEAD_MMAP
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
 /* allow readfile to use deprecated functionality */
 #define DNA_DEPRECATED_ALLOW
 
@@ -107,9 +119,12 @@
 #include "BLI_endian_switch.h"
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
 
+#include "PIL_time.h"
+
 #include "BLT_translation.h"
 
 #include "BKE_action.h"
@@ -219,6 +234,9 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Use GHash for old-new map lookups which can't use 'lasthit' (speeds up linking) */
+#define USE_GHASH_OLDNEWMAP
+
 /***/
 
 typedef struct OldNew {
@@ -230,10 +248,22 @@ typedef struct OldNew {
 typedef struct OldNewMap {
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
 	int lasthit;
+#ifdef USE_GHASH_OLDNEWMAP
+	/* Map old address to entry index (plus one), created lazily once
+	 * enough lookups missed 'lasthit', see #OLDNEWMAP_HASH_MISS_THRESHOLD. */
+	GHash *entries_hash;
+	int lookup_miss_num;
+#endif
 } OldNewMap;
 
+#ifdef USE_GHASH_OLDNEWMAP
+/* Number of full lookups before building the hash. */
+#  define OLDNEWMAP_HASH_MISS_THRESHOLD 16
+/* Smaller maps are quick to search. */
+#  define OLDNEWMAP_HASH_ENTRIES_MIN 64
+#endif
+
 
 /* local prototypes */
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname);
@@ -284,23 +314,6 @@ static OldNewMap *oldnewmap_new(void)
 	return onm;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
-{
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
-}
-
-
-static void oldnewmap_sort(FileData *fd) 
-{
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
-}
-
 /* nr is zero for data, and ID code for libdata */
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
@@ -317,6 +330,13 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+
+#ifdef USE_GHASH_OLDNEWMAP
+	if (onm->entries_hash) {
+		/* Later entries take precedence, as with a full search. */
+		BLI_ghash_reinsert(onm->entries_hash, (void *)oldaddr, SET_INT_IN_POINTER(onm->nentries), NULL, NULL);
+	}
+#endif
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -330,11 +350,9 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
  * \param lasthit: Use as a reference position to avoid a full search
  * from either end of the array, giving more efficient lookups.
  *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \note The data is written in-order, using the \a lasthit will normally avoid calling this function.
+ * Creating a hash for every map adds overhead for the common-case to optimize the corner-case
+ * (since most entries will never be retrieved), see #oldnewmap_lookup_entry which creates one on demand.
  */
 static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
 {
@@ -374,6 +392,42 @@ static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, i
 	return -1;
 }
 
+#ifdef USE_GHASH_OLDNEWMAP
+static void oldnewmap_hash_ensure(OldNewMap *onm)
+{
+	if (onm->entries_hash == NULL) {
+		int i;
+		onm->entries_hash = BLI_ghash_ptr_new_ex(__func__, (unsigned int)onm->nentries);
+		for (i = 0; i < onm->nentries; i++) {
+			BLI_ghash_reinsert(onm->entries_hash, (void *)onm->entries[i].old, SET_INT_IN_POINTER(i + 1), NULL, NULL);
+		}
+	}
+}
+#endif
+
+/**
+ * Lookup after \a lasthit missed, uses the hash when many lookups miss,
+ * which happens when linking is not done in the order data was written (library data for e.g.).
+ */
+static int oldnewmap_lookup_entry(OldNewMap *onm, const void *addr, int lasthit)
+{
+#ifdef USE_GHASH_OLDNEWMAP
+	if (onm->entries_hash == NULL) {
+		if ((onm->nentries >= OLDNEWMAP_HASH_ENTRIES_MIN) &&
+		    (++onm->lookup_miss_num > OLDNEWMAP_HASH_MISS_THRESHOLD))
+		{
+			oldnewmap_hash_ensure(onm);
+		}
+	}
+
+	if (onm->entries_hash) {
+		return GET_INT_FROM_POINTER(BLI_ghash_lookup(onm->entries_hash, addr)) - 1;
+	}
+#endif
+
+	return oldnewmap_lookup_entry_full(onm, addr, lasthit);
+}
+
 static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool increase_users)
 {
 	int i;
@@ -390,7 +444,7 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 		}
 	}
 	
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry(onm, addr, onm->lasthit);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
 		BLI_assert(entry->old == addr);
@@ -406,32 +460,21 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 /* for libdata, nr has ID code, no increment */
 static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *lib)
 {
+	int i;
+
 	if (addr == NULL) {
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing,
+	 * for libdata the lookup is likely to use the hash. */
+	i = oldnewmap_lookup_entry(onm, addr, -1);
+	if (i != -1) {
+		OldNew *entry = &onm->entries[i];
+		ID *id = entry->newp;
+		BLI_assert(entry->old == addr);
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -455,10 +498,23 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+
+#ifdef USE_GHASH_OLDNEWMAP
+	if (onm->entries_hash) {
+		BLI_ghash_free(onm->entries_hash, NULL, NULL);
+		onm->entries_hash = NULL;
+	}
+	onm->lookup_miss_num = 0;
+#endif
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
+#ifdef USE_GHASH_OLDNEWMAP
+	if (onm->entries_hash) {
+		BLI_ghash_free(onm->entries_hash, NULL, NULL);
+	}
+#endif
 	MEM_freeN(onm->entries);
 	MEM_freeN(onm);
 }
@@ -818,11 +874,103 @@ static BHeadN *get_bhead(FileData *fd)
 	return(new_bhead);
 }
 
+#ifdef USE_BHEAD_MMAP
+
+/**
+ * Return the BHead at \a offset in the mapping,
+ * or NULL when the file ends (or is truncated) before the block does.
+ */
+static BHead *mmap_bhead_at(FileData *fd, size_t offset)
+{
+	BHead *bhead;
+
+	if (fd->mmap_len < sizeof(BHead) || offset > fd->mmap_len - sizeof(BHead)) {
+		return NULL;
+	}
+
+	bhead = (BHead *)(fd->mmap_data + offset);
+	if (bhead->len < 0 || (size_t)bhead->len > fd->mmap_len - sizeof(BHead) - offset) {
+		fd->eof = 1;
+		return NULL;
+	}
+
+	return bhead;
+}
+
+static size_t mmap_bhead_offset_next(FileData *fd, const BHead *bhead)
+{
+	return (size_t)((const char *)(bhead + 1) - fd->mmap_data) + (size_t)bhead->len;
+}
+
+/**
+ * Reading backwards needs all block offsets,
+ * these are only collected once since it's rarely needed (see #find_previous_lib).
+ */
+static void mmap_bhead_array_ensure(FileData *fd)
+{
+	BHead *bhead;
+	int bhead_array_alloc;
+
+	if (fd->mmap_bhead_array) {
+		return;
+	}
+
+	bhead_array_alloc = 1024;
+	fd->mmap_bhead_array = MEM_mallocN(sizeof(*fd->mmap_bhead_array) * (size_t)bhead_array_alloc, __func__);
+	fd->mmap_bhead_array_len = 0;
+
+	for (bhead = mmap_bhead_at(fd, SIZEOFBLENDERHEADER);
+	     bhead;
+	     bhead = (bhead->code == ENDB) ? NULL : mmap_bhead_at(fd, mmap_bhead_offset_next(fd, bhead)))
+	{
+		if (fd->mmap_bhead_array_len == bhead_array_alloc) {
+			bhead_array_alloc *= 2;
+			fd->mmap_bhead_array = MEM_reallocN(
+			        fd->mmap_bhead_array, sizeof(*fd->mmap_bhead_array) * (size_t)bhead_array_alloc);
+		}
+		fd->mmap_bhead_array[fd->mmap_bhead_array_len++] = bhead;
+	}
+}
+
+static BHead *mmap_prevbhead(FileData *fd, BHead *thisblock)
+{
+	int low, high;
+
+	mmap_bhead_array_ensure(fd);
+
+	/* blocks are stored in file order, so the array is sorted by address */
+	low = 0;
+	high = fd->mmap_bhead_array_len - 1;
+	while (low <= high) {
+		const int mid = (low + high) / 2;
+		if (fd->mmap_bhead_array[mid] < thisblock) {
+			low = mid + 1;
+		}
+		else if (fd->mmap_bhead_array[mid] > thisblock) {
+			high = mid - 1;
+		}
+		else {
+			return (mid != 0) ? fd->mmap_bhead_array[mid - 1] : NULL;
+		}
+	}
+
+	BLI_assert(0);
+	return NULL;
+}
+
+#endif  /* USE_BHEAD_MMAP */
+
 BHead *blo_firstbhead(FileData *fd)
 {
 	BHeadN *new_bhead;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_USE_MMAP) {
+		return mmap_bhead_at(fd, SIZEOFBLENDERHEADER);
+	}
+#endif
+
 	/* Rewind the file
 	 * Read in a new block if necessary
 	 */
@@ -838,10 +986,21 @@ BHead *blo_firstbhead(FileData *fd)
 	return(bhead);
 }
 
-BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_prevbhead(FileData *fd, BHead *thisblock)
 {
-	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
-	BHeadN *prev = bheadn->prev;
+	BHeadN *bheadn;
+	BHeadN *prev;
+
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_USE_MMAP) {
+		return mmap_prevbhead(fd, thisblock);
+	}
+#else
+	UNUSED_VARS(fd);
+#endif
+
+	bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
+	prev = bheadn->prev;
 	
 	return (prev) ? &prev->bhead : NULL;
 }
@@ -851,6 +1010,13 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 	BHeadN *new_bhead = NULL;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->flags & FD_FLAGS_USE_MMAP) {
+		/* blocks are contiguous in the file, no need to read anything */
+		return (thisblock) ? mmap_bhead_at(fd, mmap_bhead_offset_next(fd, thisblock)) : NULL;
+	}
+#endif
+
 	if (thisblock) {
 		/* bhead is actually a sub part of BHeadN
 		 * We calculate the BHeadN pointer from the BHead pointer below */
@@ -1013,6 +1179,20 @@ static int fd_read_gzip_from_file(FileData *filedata, void *buffer, unsigned int
 	return (readsize);
 }
 
+#ifdef USE_BHEAD_MMAP
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* only used for the file header, blocks are accessed in-place (see: blo_nextbhead) */
+	const size_t offset = (size_t)filedata->seek;
+	const int readsize = (offset < filedata->mmap_len) ? (int)MIN2((size_t)size, filedata->mmap_len - offset) : 0;
+
+	memcpy(buffer, filedata->mmap_data + offset, (size_t)readsize);
+	filedata->seek += readsize;
+
+	return readsize;
+}
+#endif
+
 static int fd_read_from_memory(FileData *filedata, void *buffer, unsigned int size)
 {
 	/* don't read more bytes then there are available in the buffer */
@@ -1122,11 +1302,327 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+#ifdef USE_BHEAD_MMAP
+/**
+ * Map the file when its blocks can be used in-place,
+ * that is: the file is uncompressed and has the pointer size and endianness of this build.
+ *
+ * \note Saving never overwrites the file in-place (a temporary file is renamed),
+ * so the mapping stays valid even when the file is saved again while it's being read.
+ * Another process truncating the file while it's mapped is not guarded against,
+ * accessing the pages past the new end of the file raises SIGBUS.
+ * This can't be handled safely while reading from multiple threads,
+ * it's the same class of failure as the file being removed from a network share mid-read.
+ *
+ * \return NULL when the file can't be mapped, the caller falls back to regular reading.
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath)
+{
+	const char header_expect[9] = {
+	    'B', 'L', 'E', 'N', 'D', 'E', 'R',
+	    (sizeof(void *) == 8) ? '-' : '_',
+	    (ENDIAN_ORDER == L_ENDIAN) ? 'v' : 'V'};
+	char header[sizeof(header_expect)];
+	struct stat st;
+	void *mmap_data;
+	FileData *fd;
+	int filedes;
+
+	filedes = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (filedes == -1) {
+		return NULL;
+	}
+
+	if ((fstat(filedes, &st) == -1) ||
+	    (!S_ISREG(st.st_mode)) ||
+	    /* too large to map in this address space, fall back to reading */
+	    ((uint64_t)(size_t)st.st_size != (uint64_t)st.st_size) ||
+	    ((size_t)st.st_size < SIZEOFBLENDERHEADER + sizeof(BHead)) ||
+	    (read(filedes, header, sizeof(header)) != sizeof(header)) ||
+	    (memcmp(header, header_expect, sizeof(header)) != 0))
+	{
+		close(filedes);
+		return NULL;
+	}
+
+	/* private & writable: the few in-place changes to blocks must never reach the file */
+	mmap_data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, filedes, 0);
+	/* the mapping keeps its own reference to the file */
+	close(filedes);
+
+	if (mmap_data == MAP_FAILED) {
+		return NULL;
+	}
+
+	/* no access advice: loading reads blocks front to back,
+	 * but linking & appending look blocks up at random (see #mmap_bhead_array_ensure),
+	 * leave it to the default read-ahead which suits both */
+
+	fd = filedata_new();
+	fd->mmap_data = mmap_data;
+	fd->mmap_len = (size_t)st.st_size;
+	fd->read = fd_read_from_mmap;
+	fd->flags |= FD_FLAGS_USE_MMAP;
+
+	return fd;
+}
+#endif  /* USE_BHEAD_MMAP */
+
+typedef struct ZlibMember {
+	const unsigned char *data;
+	size_t data_len;
+	char *data_out;
+	unsigned int data_out_len;
+	bool ok;
+} ZlibMember;
+
+static unsigned int zlib_read_le32(const unsigned char *buf)
+{
+	return ((unsigned int)buf[0]) | ((unsigned int)buf[1] << 8) |
+	       ((unsigned int)buf[2] << 16) | ((unsigned int)buf[3] << 24);
+}
+
+/**
+ * \return The size of the gzip member written by #ww_write_zlib at \a data, or zero.
+ */
+static size_t zlib_member_size(const unsigned char *data, size_t data_len)
+{
+	size_t member_len;
+
+	if ((data_len < BLEND_ZLIB_HEADER_SIZE + BLEND_ZLIB_TRAILER_SIZE) ||
+	    (memcmp(data, "\x1f\x8b\x08\x04", 4) != 0) ||
+	    (memcmp(data + 10, "\x08\x00" "BL" "\x04\x00", 6) != 0))
+	{
+		return 0;
+	}
+
+	member_len = zlib_read_le32(data + 16);
+	if ((member_len < BLEND_ZLIB_HEADER_SIZE + BLEND_ZLIB_TRAILER_SIZE) || (member_len > data_len)) {
+		return 0;
+	}
+	return member_len;
+}
+
+static void zlib_member_inflate_cb(void *userdata, const int index)
+{
+	ZlibMember *member = &((ZlibMember *)userdata)[index];
+	const unsigned char *trailer = member->data + member->data_len - BLEND_ZLIB_TRAILER_SIZE;
+	z_stream strm;
+
+	memset(&strm, 0, sizeof(strm));
+	member->ok = false;
+
+	if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+		return;
+	}
+
+	strm.next_in = (Bytef *)(member->data + BLEND_ZLIB_HEADER_SIZE);
+	strm.avail_in = (uInt)(member->data_len - BLEND_ZLIB_HEADER_SIZE - BLEND_ZLIB_TRAILER_SIZE);
+	strm.next_out = (Bytef *)member->data_out;
+	strm.avail_out = member->data_out_len;
+
+	if ((inflate(&strm, Z_FINISH) == Z_STREAM_END) &&
+	    (strm.total_out == member->data_out_len) &&
+	    (crc32(0, (const Bytef *)member->data_out, member->data_out_len) == zlib_read_le32(trailer)))
+	{
+		member->ok = true;
+	}
+
+	inflateEnd(&strm);
+}
+
+/**
+ * Read the size of all members at \a filedes, without reading their data.
+ *
+ * \return The number of members, or zero when the file isn't entirely made of members from #ww_write_zlib.
+ */
+static int zlib_members_scan(int filedes, size_t file_len, ZlibMember **r_members, size_t *r_buffer_len)
+{
+	ZlibMember *members = NULL;
+	int members_len = 0, members_alloc = 0;
+	size_t offset = 0, buffer_len = 0;
+
+	while (offset < file_len) {
+		unsigned char header[BLEND_ZLIB_HEADER_SIZE];
+		unsigned char isize[4];
+		ZlibMember *member;
+		size_t member_len;
+
+		if ((lseek(filedes, offset, SEEK_SET) == -1) ||
+		    (read(filedes, header, sizeof(header)) != sizeof(header)) ||
+		    ((member_len = zlib_member_size(header, file_len - offset)) == 0) ||
+		    (lseek(filedes, offset + member_len - sizeof(isize), SEEK_SET) == -1) ||
+		    (read(filedes, isize, sizeof(isize)) != sizeof(isize)))
+		{
+			members_len = 0;
+			break;
+		}
+
+		if (members_len == members_alloc) {
+			members_alloc = MAX2(members_alloc * 2, 64);
+			members = MEM_reallocN(members, sizeof(*members) * (size_t)members_alloc);
+		}
+		member = &members[members_len++];
+		member->data = NULL;
+		member->data_len = member_len;
+		member->data_out = NULL;
+		member->data_out_len = zlib_read_le32(isize);
+
+		buffer_len += member->data_out_len;
+		offset += member_len;
+	}
+
+	if ((members_len == 0) && members) {
+		MEM_freeN(members);
+		members = NULL;
+	}
+
+	*r_members = members;
+	*r_buffer_len = buffer_len;
+	return members_len;
+}
+
+/**
+ * Files compressed by #ww_write_zlib are made of independent gzip members,
+ * inflate them in parallel into a single buffer.
+ *
+ * Members are read and inflated in batches (see #BLEND_ZLIB_BLOCKS_MAX),
+ * so the compressed file is never held in memory next to the whole decompressed buffer.
+ *
+ * \return NULL for any other kind of file (including gzip files written by other applications),
+ * the caller falls back to regular (streaming) decompression.
+ */
+static FileData *blo_openblenderfile_zlib_parallel(const char *filepath)
+{
+	unsigned char header[BLEND_ZLIB_HEADER_SIZE];
+	unsigned char *data = NULL;
+	size_t data_alloc = 0;
+	size_t file_len;
+	ZlibMember *members;
+	int members_len, batch_len, i, j;
+	size_t buffer_len;
+	char *buffer;
+	bool ok;
+	int filedes;
+
+	/* cheap check, so regular files are not scanned */
+	filedes = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (filedes == -1) {
+		return NULL;
+	}
+	file_len = BLI_file_size(filepath);
+	ok = ((file_len != (size_t)-1) &&
+	      (read(filedes, header, sizeof(header)) == sizeof(header)) &&
+	      (zlib_member_size(header, file_len) != 0));
+	if (!ok) {
+		close(filedes);
+		return NULL;
+	}
+
+	members_len = zlib_members_scan(filedes, file_len, &members, &buffer_len);
+
+	/* reading from memory is limited to 'int' sizes */
+	if ((members_len == 0) || (buffer_len == 0) || (buffer_len > INT_MAX) ||
+	    (lseek(filedes, 0, SEEK_SET) == -1))
+	{
+		if (members) {
+			MEM_freeN(members);
+		}
+		close(filedes);
+		return NULL;
+	}
+
+	buffer = MEM_mallocN(buffer_len, __func__);
+	batch_len = CLAMPIS(BLI_system_thread_count() * 2, 1, BLEND_ZLIB_BLOCKS_MAX);
+
+	buffer_len = 0;
+	for (i = 0; i < members_len; i++) {
+		members[i].data_out = buffer + buffer_len;
+		buffer_len += members[i].data_out_len;
+	}
+
+	/* members are stored back to back, read each batch with a single read */
+	for (i = 0; ok && (i < members_len); i += batch_len) {
+		const int batch_num = MIN2(batch_len, members_len - i);
+		size_t data_len = 0;
+
+		for (j = 0; j < batch_num; j++) {
+			data_len += members[i + j].data_len;
+		}
+		if (data_len > data_alloc) {
+			if (data) {
+				MEM_freeN(data);
+			}
+			data = MEM_mallocN(data_len, __func__);
+			data_alloc = data_len;
+		}
+		if (read(filedes, data, data_len) != (ssize_t)data_len) {
+			ok = false;
+			break;
+		}
+
+		data_len = 0;
+		for (j = 0; j < batch_num; j++) {
+			members[i + j].data = data + data_len;
+			data_len += members[i + j].data_len;
+		}
+
+		BLI_task_parallel_range(i, i + batch_num, members, zlib_member_inflate_cb, batch_num > 1);
+
+		for (j = 0; j < batch_num; j++) {
+			if (members[i + j].ok == false) {
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	close(filedes);
+	if (data) {
+		MEM_freeN(data);
+	}
+	MEM_freeN(members);
+
+	if (ok) {
+		FileData *fd = filedata_new();
+		fd->buffer = buffer;
+		fd->buffersize = (int)buffer_len;
+		fd->read = fd_read_from_memory;
+		return fd;
+	}
+	else {
+		MEM_freeN(buffer);
+		return NULL;
+	}
+}
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
 	gzFile gzfile;
+
+#ifdef USE_BHEAD_MMAP
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+
+	{
+		FileData *fd = blo_openblenderfile_zlib_parallel(filepath);
+		if (fd) {
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1286,6 +1782,14 @@ void blo_freefiledata(FileData *fd)
 		// Free all BHeadN data blocks
 		BLI_freelistN(&fd->listbase);
 
+#ifdef USE_BHEAD_MMAP
+		if (fd->mmap_data) {
+			munmap((void *)fd->mmap_data, fd->mmap_len);
+			fd->mmap_data = NULL;
+		}
+		MEM_SAFE_FREE(fd->mmap_bhead_array);
+#endif
+
 		if (fd->filesdna)
 			DNA_sdna_free(fd->filesdna);
 		if (fd->compflags)
@@ -1541,9 +2045,6 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 	
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 		
@@ -1572,6 +2073,43 @@ static void change_idid_adr(ListBase *mainlist, FileData *basefd, void *old, voi
 	}
 }
 
+/**
+ * Same as #change_idid_adr, for many placeholders at once.
+ *
+ * \param placeholder_map: Maps placeholder ID's to the ID's read in their place (may be NULL).
+ */
+static void change_idid_adr_multi(ListBase *mainlist, FileData *basefd, GHash *placeholder_map)
+{
+	Main *mainptr;
+
+	for (mainptr = mainlist->first; mainptr; mainptr = mainptr->next) {
+		FileData *fd;
+		int i;
+
+		if (mainptr->curlib)
+			fd = mainptr->curlib->filedata;
+		else
+			fd = basefd;
+
+		if (fd == NULL) {
+			continue;
+		}
+
+		for (i = 0; i < fd->libmap->nentries; i++) {
+			OldNew *entry = &fd->libmap->entries[i];
+
+			if (entry->nr == ID_ID) {
+				void **new_p = BLI_ghash_lookup_p(placeholder_map, entry->newp);
+				if (new_p) {
+					ID *new = *new_p;
+					entry->newp = new;
+					if (new) entry->nr = GS(new->name);
+				}
+			}
+		}
+	}
+}
+
 /* lib linked proxy objects point to our local data, we need
  * to clear that pointer before reading the undo memfile since
  * the object might be removed, it is set again in reading
@@ -8481,8 +9019,6 @@ static void do_versions_after_linking(Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
 		lib_link_windowmanager(fd, main);
@@ -10423,6 +10959,79 @@ static int mainvar_id_tag_any_check(Main *mainvar, const short tag)
 	return false;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Library Read Timing
+ *
+ * Time spent per library, printed with '--debug-io'.
+ * \{ */
+
+typedef struct LibReadTime {
+	const Library *lib;
+	double time_open;
+	double time_read;  /* reading & expanding linked data */
+	double time_versions;  /* versioning & linking */
+} LibReadTime;
+
+static LibReadTime *lib_read_time_ensure(GHash *lib_times, const Library *lib)
+{
+	void **val_p;
+
+	if (!BLI_ghash_ensure_p(lib_times, (void *)lib, &val_p)) {
+		LibReadTime *lib_time = MEM_callocN(sizeof(*lib_time), __func__);
+		lib_time->lib = lib;
+		*val_p = lib_time;
+	}
+	return *val_p;
+}
+
+static int lib_read_time_cmp(const void *a_v, const void *b_v)
+{
+	const LibReadTime *a = *(const LibReadTime **)a_v;
+	const LibReadTime *b = *(const LibReadTime **)b_v;
+	const double a_total = a->time_open + a->time_read + a->time_versions;
+	const double b_total = b->time_open + b->time_read + b->time_versions;
+
+	if      (a_total < b_total) return  1;
+	else if (a_total > b_total) return -1;
+	return 0;
+}
+
+static void lib_read_time_print(GHash *lib_times)
+{
+	GHashIterator gh_iter;
+	LibReadTime **lib_time_array;
+	double total = 0.0;
+	int lib_time_len = 0;
+	int i;
+
+	lib_time_array = MEM_mallocN(sizeof(*lib_time_array) * BLI_ghash_size(lib_times), __func__);
+	GHASH_ITER (gh_iter, lib_times) {
+		LibReadTime *lib_time = BLI_ghashIterator_getValue(&gh_iter);
+		lib_time_array[lib_time_len++] = lib_time;
+		total += lib_time->time_open + lib_time->time_read + lib_time->time_versions;
+	}
+	qsort(lib_time_array, (size_t)lib_time_len, sizeof(*lib_time_array), lib_read_time_cmp);
+
+	printf("Read %d libraries in %.3f sec (open, read, versions & link):\n", lib_time_len, total);
+	for (i = 0; i < lib_time_len; i++) {
+		const LibReadTime *lib_time = lib_time_array[i];
+		printf("  %8.3f %8.3f %8.3f  %s\n",
+		       lib_time->time_open, lib_time->time_read, lib_time->time_versions, lib_time->lib->filepath);
+	}
+
+	MEM_freeN(lib_time_array);
+}
+
+/** \} */
+
+/**
+ * Read all ID's linked from libraries (directly and indirectly), libraries are opened once
+ * and their placeholders are remapped in one pass per library.
+ *
+ * \note Linked data is always read here, up-front: there is no deferred reading of linked ID's
+ * on first access, since all pointers to linked data are resolved while reading.
+ * See #G_DEBUG_IO for the time spent per library.
+ */
 static void read_libraries(FileData *basefd, ListBase *mainlist)
 {
 	Main *mainl = mainlist->first;
@@ -10430,6 +11039,12 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 	ListBase *lbarray[MAX_LIBARRAY];
 	int a;
 	bool do_it = true;
+	/* placeholders of read ID's, freed once all references to them are updated */
+	GHash *placeholder_map = BLI_ghash_ptr_new(__func__);
+	ListBase placeholders = {NULL, NULL};
+	GHash *lib_times = (G.debug & G_DEBUG_IO) ? BLI_ghash_ptr_new(__func__) : NULL;
+	LibReadTime *lib_time = NULL;
+	double time_start = 0.0;
 	
 	/* expander now is callback function */
 	BLO_main_expander(expand_doit_library);
@@ -10445,6 +11060,11 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 
 				FileData *fd = mainptr->curlib->filedata;
 				
+				if (lib_times) {
+					lib_time = lib_read_time_ensure(lib_times, mainptr->curlib);
+					time_start = PIL_check_seconds_timer();
+				}
+
 				if (fd == NULL) {
 					
 					/* printf and reports for now... its important users know this */
@@ -10532,6 +11152,12 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 						blo_reportf_wrap(basefd->reports, RPT_WARNING, TIP_("Cannot find lib '%s'"),
 						                 mainptr->curlib->filepath);
 					}
+
+					if (lib_time) {
+						const double time_end = PIL_check_seconds_timer();
+						lib_time->time_open += time_end - time_start;
+						time_start = time_end;
+					}
 				}
 				if (fd) {
 					do_it = true;
@@ -10552,14 +11178,28 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 							 * (known case: some directly linked shapekey from a missing lib...). */
 							/* BLI_assert(realid != NULL); */
 
-							change_idid_adr(mainlist, basefd, id, realid);
-
-							MEM_freeN(id);
+							/* Updating references is done for all placeholders of this library at once,
+							 * since it has to check the libmap of every library (see: change_idid_adr).
+							 * Placeholders stay allocated until then, so their addresses can't be reused. */
+							BLI_ghash_insert(placeholder_map, id, realid);
+							BLI_addtail(&placeholders, id);
 						}
 						id = idn;
 					}
 				}
+
+				if (placeholders.first) {
+					change_idid_adr_multi(mainlist, basefd, placeholder_map);
+					BLI_ghash_clear(placeholder_map, NULL, NULL);
+					BLI_freelistN(&placeholders);
+				}
+
 				BLO_expand_main(fd, mainptr);
+
+				if (lib_time) {
+					lib_time->time_read += PIL_check_seconds_timer() - time_start;
+					lib_time = NULL;
+				}
 			}
 			
 			mainptr = mainptr->next;
@@ -10597,6 +11237,10 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 	/* do versions, link, and free */
 	Main main_newid = {0};
 	for (mainptr = mainl->next; mainptr; mainptr = mainptr->next) {
+		if (lib_times) {
+			time_start = PIL_check_seconds_timer();
+		}
+
 		/* some mains still have to be read, then versionfile is still zero! */
 		if (mainptr->versionfile) {
 			/* We need to split out IDs already existing, or they will go again through do_versions - bad, very bad! */
@@ -10615,6 +11259,19 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 		
 		if (mainptr->curlib->filedata) blo_freefiledata(mainptr->curlib->filedata);
 		mainptr->curlib->filedata = NULL;
+
+		if (lib_times) {
+			lib_read_time_ensure(lib_times, mainptr->curlib)->time_versions += PIL_check_seconds_timer() - time_start;
+		}
+	}
+
+	BLI_ghash_free(placeholder_map, NULL, NULL);
+
+	if (lib_times) {
+		if (BLI_ghash_size(lib_times) != 0) {
+			lib_read_time_print(lib_times);
+		}
+		BLI_ghash_free(lib_times, NULL, MEM_freeN);
 	}
 }
 
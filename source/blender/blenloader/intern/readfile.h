@@ -62,6 +62,13 @@ typedef struct FileData {
 	int filedes;
 	gzFile gzfiledes;
 
+	// variables needed for reading from a memory mapped file, see: FD_FLAGS_USE_MMAP
+	const char *mmap_data;
+	size_t mmap_len;
+	/* all BHead's of the mapping in file order, only created on demand (for blo_prevbhead) */
+	struct BHead **mmap_bhead_array;
+	int mmap_bhead_array_len;
+
 	// now only in use for library appending
 	char relabase[FILE_MAX];
 	
@@ -120,10 +127,34 @@ enum {
 	FD_FLAGS_FILE_OK               = 1 << 3,
 	FD_FLAGS_NOT_MY_BUFFER         = 1 << 4,
 	FD_FLAGS_NOT_MY_LIBMAP         = 1 << 5,  /* XXX Unused in practice (checked once but never set). */
+	FD_FLAGS_USE_MMAP              = 1 << 6,  /* BHead's point directly into 'mmap_data', 'listbase' is unused. */
 };
 
 #define SIZEOFBLENDERHEADER 12
 
+/**
+ * Compressed files are written as a sequence of gzip members,
+ * each compressing (at most) #BLEND_ZLIB_BLOCK_SIZE bytes independently,
+ * so blocks can be compressed and decompressed in parallel.
+ * Concatenated members are still a valid gzip stream, readable by any gzip reader.
+ *
+ * Every member header stores an extra field (subfield id 'B', 'L')
+ * holding the total size of the member, so members can be located without inflating them.
+ * Member layout (little endian):
+ * - 10 byte gzip header (FEXTRA flag set) + 2 byte extra length (8).
+ * - 'B', 'L', 2 byte subfield length (4), 4 byte member size.
+ * - raw deflate data.
+ * - 4 byte CRC32 + 4 byte uncompressed size.
+ */
+#define BLEND_ZLIB_BLOCK_SIZE (1 << 20)
+/**
+ * Most members compressed or inflated at once (less with fewer threads),
+ * bounds memory use to a few times this many #BLEND_ZLIB_BLOCK_SIZE.
+ */
+#define BLEND_ZLIB_BLOCKS_MAX 16
+#define BLEND_ZLIB_HEADER_SIZE 20
+#define BLEND_ZLIB_TRAILER_SIZE 8
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
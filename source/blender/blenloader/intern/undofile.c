@@ -40,6 +40,7 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 
 #include "BLO_undofile.h"
 
@@ -62,43 +63,99 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
+	/* Chunks of 'second' may share buffers with any chunk of 'first' (not only the one at the same position),
+	 * since ID's are compared with their own data (see: memfile_write_id_begin). */
+	GHash *buf_chunk_map = BLI_ghash_ptr_new(__func__);
 	MemFileChunk *fc, *sc;
-	
-	fc = first->chunks.first;
-	sc = second->chunks.first;
-	while (fc || sc) {
-		if (fc && sc) {
-			if (sc->ident) {
+
+	for (sc = second->chunks.first; sc; sc = sc->next) {
+		if (sc->ident) {
+			void **val_p;
+			if (!BLI_ghash_ensure_p(buf_chunk_map, sc->buf, &val_p)) {
+				*val_p = sc;
+			}
+		}
+	}
+
+	/* hand over ownership of buffers still used by 'second' */
+	for (fc = first->chunks.first; fc; fc = fc->next) {
+		if (fc->ident == 0) {
+			sc = BLI_ghash_popkey(buf_chunk_map, fc->buf, NULL);
+			if (sc) {
 				sc->ident = 0;
 				fc->ident = 1;
 			}
 		}
-		if (fc) fc = fc->next;
-		if (sc) sc = sc->next;
 	}
-	
+
+	BLI_ghash_free(buf_chunk_map, NULL, NULL);
+
 	BLO_memfile_free(first);
 }
 
-void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size)
+void memfile_write_init(MemFileWriteData *mem_data, MemFile *compare, MemFile *current)
 {
-	static MemFileChunk *compchunk = NULL;
-	MemFileChunk *curchunk;
-	
-	/* this function inits when compare != NULL or when current == NULL  */
-	if (compare) {
-		compchunk = compare->chunks.first;
-		return;
+	mem_data->compare = compare;
+	mem_data->current = current;
+	mem_data->compare_chunk = compare ? compare->chunks.first : NULL;
+	mem_data->id_chunk_map = NULL;
+	mem_data->id = NULL;
+
+	/* chunks are split at ID boundaries, so each ID can be compared with its own previous data
+	 * even when other ID's were added, removed or changed in size */
+	if (compare && compare->chunks.first) {
+		MemFileChunk *chunk;
+		const void *id_prev = NULL;
+
+		mem_data->id_chunk_map = BLI_ghash_ptr_new(__func__);
+		for (chunk = compare->chunks.first; chunk; chunk = chunk->next) {
+			if (chunk->id && (chunk->id != id_prev)) {
+				void **val_p;
+				if (!BLI_ghash_ensure_p(mem_data->id_chunk_map, (void *)chunk->id, &val_p)) {
+					*val_p = chunk;
+				}
+			}
+			id_prev = chunk->id;
+		}
 	}
-	if (current == NULL) {
-		compchunk = NULL;
-		return;
+}
+
+/**
+ * Start writing data for a new ID, chunks added after this are compared against the data
+ * stored for the same ID in the previous undo step (when found).
+ */
+void memfile_write_id_begin(MemFileWriteData *mem_data, const void *id)
+{
+	mem_data->id = id;
+
+	if (mem_data->id_chunk_map) {
+		MemFileChunk *chunk = BLI_ghash_lookup(mem_data->id_chunk_map, id);
+		/* otherwise continue comparing in order, e.g: after undo all ID addresses change */
+		if (chunk) {
+			mem_data->compare_chunk = chunk;
+		}
 	}
+}
+
+void memfile_write_finalize(MemFileWriteData *mem_data)
+{
+	if (mem_data->id_chunk_map) {
+		BLI_ghash_free(mem_data->id_chunk_map, NULL, NULL);
+		mem_data->id_chunk_map = NULL;
+	}
+}
+
+void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size)
+{
+	MemFile *current = mem_data->current;
+	MemFileChunk *compchunk = mem_data->compare_chunk;
+	MemFileChunk *curchunk;
 	
 	curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
 	curchunk->size = size;
 	curchunk->buf = NULL;
 	curchunk->ident = 0;
+	curchunk->id = mem_data->id;
 	BLI_addtail(&current->chunks, curchunk);
 	
 	/* we compare compchunk with buf */
@@ -109,7 +166,7 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 				curchunk->ident = 1;
 			}
 		}
-		compchunk = compchunk->next;
+		mem_data->compare_chunk = compchunk->next;
 	}
 	
 	/* not equal... */
@@ -119,4 +176,3 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 		current->size += size;
 	}
 }
-
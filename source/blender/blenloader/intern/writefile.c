@@ -154,6 +154,8 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -215,7 +217,8 @@ struct WriteWrap {
 	/* internal */
 	union {
 		int file_handle;
-		gzFile gz_handle;
+		struct WriteWrapZlib *zlib_handle;
+		MemFile *memfile;
 	} _user_data;
 };
 
@@ -247,31 +250,203 @@ static size_t ww_write_none(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
-/* zlib */
+/* zlib (block parallel, see: BLEND_ZLIB_BLOCK_SIZE) */
 #define FILE_HANDLE(ww) \
-	(ww)->_user_data.gz_handle
+	(ww)->_user_data.zlib_handle
+
+typedef struct WriteWrapZlibBlock {
+	char *data_in;
+	size_t data_in_len;
+	/* compressed gzip member, including header & trailer */
+	char *data_out;
+	size_t data_out_len;
+} WriteWrapZlibBlock;
+
+typedef struct WriteWrapZlib {
+	int file_handle;
+	/* filled in order, compressed (in parallel) once all are full */
+	WriteWrapZlibBlock *blocks;
+	int blocks_len, blocks_used;
+	bool error;
+} WriteWrapZlib;
 
-static bool ww_open_zlib(WriteWrap *ww, const char *filepath)
+static void ww_zlib_write_le32(char *buf, unsigned int value)
+{
+	buf[0] = (char)(value & 0xff);
+	buf[1] = (char)((value >> 8) & 0xff);
+	buf[2] = (char)((value >> 16) & 0xff);
+	buf[3] = (char)((value >> 24) & 0xff);
+}
+
+static void ww_zlib_block_compress_cb(void *userdata, const int index)
 {
-	gzFile file;
+	WriteWrapZlibBlock *block = &((WriteWrapZlibBlock *)userdata)[index];
+	char *header = block->data_out;
+	char *trailer;
+	z_stream strm;
 
-	file = BLI_gzopen(filepath, "wb1");
+	memset(&strm, 0, sizeof(strm));
+	block->data_out_len = 0;
 
-	if (file != Z_NULL) {
-		FILE_HANDLE(ww) = file;
-		return true;
+	/* same compression level as used previously for 'gzopen' */
+	if (deflateInit2(&strm, 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return;
 	}
-	else {
+
+	strm.next_in = (Bytef *)block->data_in;
+	strm.avail_in = (uInt)block->data_in_len;
+	strm.next_out = (Bytef *)(block->data_out + BLEND_ZLIB_HEADER_SIZE);
+	strm.avail_out = (uInt)compressBound(BLEND_ZLIB_BLOCK_SIZE);
+
+	if (deflate(&strm, Z_FINISH) == Z_STREAM_END) {
+		block->data_out_len = BLEND_ZLIB_HEADER_SIZE + strm.total_out + BLEND_ZLIB_TRAILER_SIZE;
+
+		/* gzip header: magic, deflate, FEXTRA, no time-stamp, no extra flags, unknown OS */
+		memcpy(header, "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff", 10);
+		/* extra field: 8 bytes, with a single 'BL' subfield of 4 bytes */
+		memcpy(header + 10, "\x08\x00" "BL" "\x04\x00", 6);
+		ww_zlib_write_le32(header + 16, (unsigned int)block->data_out_len);
+
+		trailer = block->data_out + block->data_out_len - BLEND_ZLIB_TRAILER_SIZE;
+		ww_zlib_write_le32(trailer, (unsigned int)crc32(0, (const Bytef *)block->data_in, (uInt)block->data_in_len));
+		ww_zlib_write_le32(trailer + 4, (unsigned int)block->data_in_len);
+	}
+
+	deflateEnd(&strm);
+}
+
+static void ww_zlib_flush(WriteWrapZlib *zlib)
+{
+	int i;
+
+	if (zlib->blocks_used == 0) {
+		return;
+	}
+
+	BLI_task_parallel_range(
+	        0, zlib->blocks_used, zlib->blocks, ww_zlib_block_compress_cb,
+	        zlib->blocks_used > 1);
+
+	for (i = 0; i < zlib->blocks_used; i++) {
+		WriteWrapZlibBlock *block = &zlib->blocks[i];
+		if ((zlib->error == false) &&
+		    ((block->data_out_len == 0) ||
+		     (write(zlib->file_handle, block->data_out, block->data_out_len) != (ssize_t)block->data_out_len)))
+		{
+			zlib->error = true;
+		}
+		block->data_in_len = 0;
+	}
+	zlib->blocks_used = 0;
+}
+
+static bool ww_open_zlib(WriteWrap *ww, const char *filepath)
+{
+	WriteWrapZlib *zlib;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+	if (file == -1) {
 		return false;
 	}
+
+	zlib = MEM_callocN(sizeof(*zlib), __func__);
+	zlib->file_handle = file;
+	/* some extra blocks so threads stay busy when blocks compress at different speeds,
+	 * buffers are allocated once a block is used, so small files only allocate what they need */
+	zlib->blocks_len = CLAMPIS(BLI_system_thread_count() * 2, 1, BLEND_ZLIB_BLOCKS_MAX);
+	zlib->blocks = MEM_callocN(sizeof(*zlib->blocks) * (size_t)zlib->blocks_len, __func__);
+
+	FILE_HANDLE(ww) = zlib;
+	return true;
 }
 static bool ww_close_zlib(WriteWrap *ww)
 {
-	return (gzclose(FILE_HANDLE(ww)) == Z_OK);
+	WriteWrapZlib *zlib = FILE_HANDLE(ww);
+	bool ok;
+	int i;
+
+	/* include the last (partially filled) block */
+	if ((zlib->blocks_used != zlib->blocks_len) && (zlib->blocks[zlib->blocks_used].data_in_len != 0)) {
+		zlib->blocks_used++;
+	}
+	ww_zlib_flush(zlib);
+	ok = (zlib->error == false);
+
+	if (close(zlib->file_handle) == -1) {
+		ok = false;
+	}
+
+	for (i = 0; i < zlib->blocks_len; i++) {
+		if (zlib->blocks[i].data_in) {
+			MEM_freeN(zlib->blocks[i].data_in);
+			MEM_freeN(zlib->blocks[i].data_out);
+		}
+	}
+	MEM_freeN(zlib->blocks);
+	MEM_freeN(zlib);
+
+	return ok;
 }
 static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 {
-	return gzwrite(FILE_HANDLE(ww), buf, buf_len);
+	WriteWrapZlib *zlib = FILE_HANDLE(ww);
+	size_t written = 0;
+
+	while (written < buf_len) {
+		WriteWrapZlibBlock *block;
+		size_t len;
+
+		if (zlib->blocks_used == zlib->blocks_len) {
+			ww_zlib_flush(zlib);
+		}
+
+		block = &zlib->blocks[zlib->blocks_used];
+		if (block->data_in == NULL) {
+			block->data_in = MEM_mallocN(BLEND_ZLIB_BLOCK_SIZE, __func__);
+			block->data_out = MEM_mallocN(
+			        BLEND_ZLIB_HEADER_SIZE + compressBound(BLEND_ZLIB_BLOCK_SIZE) + BLEND_ZLIB_TRAILER_SIZE, __func__);
+		}
+		len = MIN2(buf_len - written, BLEND_ZLIB_BLOCK_SIZE - block->data_in_len);
+		memcpy(block->data_in + block->data_in_len, buf + written, len);
+		block->data_in_len += len;
+		written += len;
+
+		if (block->data_in_len == BLEND_ZLIB_BLOCK_SIZE) {
+			zlib->blocks_used++;
+		}
+	}
+
+	/* report errors from previously flushed blocks, the caller stops writing */
+	return zlib->error ? 0 : written;
+}
+#undef FILE_HANDLE
+
+/* memory (snapshot for asynchronous writing, see: BLO_write_file_async_begin) */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.memfile
+
+static bool ww_close_memfile(WriteWrap *UNUSED(ww))
+{
+	return true;
+}
+static size_t ww_write_memfile(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	MemFile *memfile = FILE_HANDLE(ww);
+	MemFileChunk *chunk = MEM_mallocN(sizeof(*chunk), "MemFileChunk");
+
+	/* chunks are never shared (unlike undo), they are written out and freed as a whole */
+	chunk->buf = MEM_mallocN(buf_len, "Chunk buffer");
+	chunk->size = (unsigned int)buf_len;
+	chunk->ident = 0;
+	chunk->id = NULL;
+	memcpy(chunk->buf, buf, buf_len);
+
+	BLI_addtail(&memfile->chunks, chunk);
+	memfile->size += chunk->size;
+
+	return buf_len;
 }
 #undef FILE_HANDLE
 
@@ -308,6 +483,8 @@ typedef struct {
 
 	unsigned char *buf;
 	MemFile *compare, *current;
+	/* state for sharing identical chunks with 'compare' (undo only) */
+	MemFileWriteData mem_data;
 
 	int tot, count;
 	bool error;
@@ -347,7 +524,7 @@ static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 
 	/* memory based save */
 	if (wd->current) {
-		memfile_chunk_add(NULL, wd->current, mem, memlen);
+		memfile_chunk_add(&wd->mem_data, mem, memlen);
 	}
 	else {
 		if (wd->ww->write(wd->ww, mem, memlen) != memlen) {
@@ -424,6 +601,17 @@ static void mywrite(WriteData *wd, const void *adr, int len)
 	wd->count += len;
 }
 
+/**
+ * Undo: keep the data of each ID in its own chunks,
+ * so an unchanged ID shares all its memory with the previous undo step,
+ * no matter what changed before it in the file.
+ */
+static void mywrite_id_begin(WriteData *wd, const void *id)
+{
+	mywrite_flush(wd);
+	memfile_write_id_begin(&wd->mem_data, id);
+}
+
 /**
  * BeGiN initializer for mywrite
  * \param ww: File write wrapper.
@@ -441,8 +629,10 @@ static WriteData *bgnwrite(WriteWrap *ww, MemFile *compare, MemFile *current)
 
 	wd->compare = compare;
 	wd->current = current;
-	/* this inits comparing */
-	memfile_chunk_add(compare, NULL, NULL, 0);
+	if (current) {
+		/* this inits comparing */
+		memfile_write_init(&wd->mem_data, compare, current);
+	}
 
 	return wd;
 }
@@ -460,6 +650,10 @@ static bool endwrite(WriteData *wd)
 		wd->count = 0;
 	}
 
+	if (wd->current) {
+		memfile_write_finalize(&wd->mem_data);
+	}
+
 	const bool err = wd->error;
 	writedata_free(wd);
 
@@ -495,6 +689,11 @@ static void writestruct_at_address_nr(
 		return;
 	}
 
+	if (wd->current && !ELEM(filecode, DATA, GLOB, TEST, REND, USER, DNA1, ENDB)) {
+		/* start of an ID */
+		mywrite_id_begin(wd, adr);
+	}
+
 	mywrite(wd, &bh, sizeof(BHead));
 	mywrite(wd, data, bh.len);
 }
@@ -4031,44 +4230,22 @@ static bool do_history(const char *name, ReportList *reports)
 }
 
 /**
- * \return Success.
+ * Remap relative paths for writing to \a filepath.
+ *
+ * \return Paths to restore with #write_file_paths_restore (only when saving a copy).
  */
-bool BLO_write_file(
-        Main *mainvar, const char *filepath, int write_flags,
-        ReportList *reports, const BlendThumbnail *thumb)
+static void *write_file_paths_remap(Main *mainvar, const char *filepath, int *r_write_flags)
 {
-	char tempname[FILE_MAX + 1];
-	eWriteWrapType ww_type;
-	WriteWrap ww;
-
-	/* path backup/restore */
-	void     *path_list_backup = NULL;
+	void *path_list_backup = NULL;
 	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
 
-	/* open temporary file, so we preserve the original in case we crash */
-	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
-
-	if (write_flags & G_FILE_COMPRESS) {
-		ww_type = WW_WRAP_ZLIB;
-	}
-	else {
-		ww_type = WW_WRAP_NONE;
-	}
-
-	ww_handle_init(ww_type, &ww);
-
-	if (ww.open(&ww, tempname) == false) {
-		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
-		return 0;
-	}
-
 	/* check if we need to backup and restore paths */
-	if (UNLIKELY((write_flags & G_FILE_RELATIVE_REMAP) && (G_FILE_SAVE_COPY & write_flags))) {
+	if (UNLIKELY((*r_write_flags & G_FILE_RELATIVE_REMAP) && (G_FILE_SAVE_COPY & *r_write_flags))) {
 		path_list_backup = BKE_bpath_list_backup(mainvar, path_list_flag);
 	}
 
 	/* remapping of relative paths to new file location */
-	if (write_flags & G_FILE_RELATIVE_REMAP) {
+	if (*r_write_flags & G_FILE_RELATIVE_REMAP) {
 		char dir1[FILE_MAX];
 		char dir2[FILE_MAX];
 		BLI_split_dir_part(filepath, dir1, sizeof(dir1));
@@ -4079,7 +4256,7 @@ bool BLO_write_file(
 		BLI_cleanup_dir(mainvar->name, dir2);
 
 		if (G.relbase_valid && (BLI_path_cmp(dir1, dir2) == 0)) {
-			write_flags &= ~G_FILE_RELATIVE_REMAP;
+			*r_write_flags &= ~G_FILE_RELATIVE_REMAP;
 		}
 		else {
 			if (G.relbase_valid) {
@@ -4092,28 +4269,31 @@ bool BLO_write_file(
 		}
 	}
 
-	if (write_flags & G_FILE_RELATIVE_REMAP) {
+	if (*r_write_flags & G_FILE_RELATIVE_REMAP) {
 		/* note, making relative to something OTHER then G.main->name */
 		BKE_bpath_relative_convert(mainvar, filepath, NULL);
 	}
 
-	/* actual file writing */
-	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+	return path_list_backup;
+}
 
-	ww.close(&ww);
+static void write_file_paths_restore(Main *mainvar, void *path_list_backup)
+{
+	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
 
 	if (UNLIKELY(path_list_backup)) {
 		BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
 		BKE_bpath_list_free(path_list_backup);
 	}
+}
 
-	if (err) {
-		BKE_report(reports, RPT_ERROR, strerror(errno));
-		remove(tempname);
-
-		return 0;
-	}
-
+/**
+ * Move the successfully written \a tempname over \a filepath.
+ *
+ * \return Success.
+ */
+static bool write_file_finalize(const char *tempname, const char *filepath, int write_flags, ReportList *reports)
+{
 	/* file save to temporary file was successful */
 	/* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1) */
 	if (write_flags & G_FILE_HISTORY) {
@@ -4132,6 +4312,170 @@ bool BLO_write_file(
 	return 1;
 }
 
+/**
+ * \return Success.
+ */
+bool BLO_write_file(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	char tempname[FILE_MAX + 1];
+	eWriteWrapType ww_type;
+	WriteWrap ww;
+
+	/* path backup/restore */
+	void     *path_list_backup = NULL;
+
+	/* open temporary file, so we preserve the original in case we crash */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
+
+	if (write_flags & G_FILE_COMPRESS) {
+		ww_type = WW_WRAP_ZLIB;
+	}
+	else {
+		ww_type = WW_WRAP_NONE;
+	}
+
+	ww_handle_init(ww_type, &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	path_list_backup = write_file_paths_remap(mainvar, filepath, &write_flags);
+
+	/* actual file writing */
+	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+
+	ww.close(&ww);
+
+	write_file_paths_restore(mainvar, path_list_backup);
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finalize(tempname, filepath, write_flags, reports);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Asynchronous Writing
+ *
+ * Serializing #Main needs exclusive access to it, but compressing & writing the result to disk doesn't.
+ * #BLO_write_file_async_begin stores the file in memory (which is fast, as done for undo),
+ * #BLO_write_file_async_write then writes it out and may run in a thread.
+ * \{ */
+
+struct BlendWriteAsync {
+	MemFile memfile;
+	char filepath[FILE_MAX];
+	int write_flags;
+};
+
+/**
+ * Serialize \a mainvar into memory, must be called from the main thread.
+ *
+ * \return The data to pass to #BLO_write_file_async_write (NULL on failure).
+ */
+BlendWriteAsync *BLO_write_file_async_begin(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	BlendWriteAsync *wa;
+	WriteWrap ww;
+	void *path_list_backup;
+
+	if (strlen(filepath) + 1 >= sizeof(wa->filepath)) {
+		BKE_report(reports, RPT_ERROR, "Path too long, cannot save");
+		return NULL;
+	}
+
+	wa = MEM_callocN(sizeof(*wa), __func__);
+	BLI_strncpy(wa->filepath, filepath, sizeof(wa->filepath));
+
+	memset(&ww, 0, sizeof(ww));
+	ww.close = ww_close_memfile;
+	ww.write = ww_write_memfile;
+	ww._user_data.memfile = &wa->memfile;
+
+	path_list_backup = write_file_paths_remap(mainvar, filepath, &write_flags);
+
+	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+
+	write_file_paths_restore(mainvar, path_list_backup);
+
+	wa->write_flags = write_flags;
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, "Failed to store file in memory for saving");
+		BLO_write_file_async_free(wa);
+		return NULL;
+	}
+
+	return wa;
+}
+
+/**
+ * Write the data stored by #BLO_write_file_async_begin to disk,
+ * may be called from any thread since it doesn't access #Main.
+ *
+ * \param reports: Must not be shared with other threads.
+ * \return Success.
+ */
+bool BLO_write_file_async_write(BlendWriteAsync *wa, ReportList *reports)
+{
+	char tempname[FILE_MAX + 1];
+	WriteWrap ww;
+	MemFileChunk *chunk;
+	bool err = false;
+
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", wa->filepath);
+
+	ww_handle_init((wa->write_flags & G_FILE_COMPRESS) ? WW_WRAP_ZLIB : WW_WRAP_NONE, &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	for (chunk = wa->memfile.chunks.first; chunk; chunk = chunk->next) {
+		if (ww.write(&ww, chunk->buf, chunk->size) != chunk->size) {
+			err = true;
+			break;
+		}
+	}
+
+	if (ww.close(&ww) == false) {
+		err = true;
+	}
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finalize(tempname, wa->filepath, wa->write_flags, reports);
+}
+
+const char *BLO_write_file_async_filepath(const BlendWriteAsync *wa)
+{
+	return wa->filepath;
+}
+
+void BLO_write_file_async_free(BlendWriteAsync *wa)
+{
+	BLO_memfile_free(&wa->memfile);
+	MEM_freeN(wa);
+}
+
+/** \} */
+
 /**
  * \return Success.
  */
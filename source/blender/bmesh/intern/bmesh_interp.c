@@ -888,6 +888,70 @@ void BM_data_layer_copy(BMesh *bm, CustomData *data, int type, int src_n, int ds
 	}
 }
 
+static void bm_data_layer_array_copy(
+        BMesh *bm, const char htype, const int cd_offset, const size_t data_size,
+        char *array, const bool to_array)
+{
+	BMIter iter;
+
+	BLI_assert(cd_offset != -1);
+
+#define ELEM_DATA_COPY(ele) \
+	{ \
+		void *ele_data = BM_ELEM_CD_GET_VOID_P(ele, cd_offset); \
+		if (to_array) memcpy(array, ele_data, data_size); \
+		else          memcpy(ele_data, array, data_size); \
+		array += data_size; \
+	} (void)0
+
+	if (htype == BM_LOOP) {
+		BMFace *f;
+		BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
+			BMLoop *l_iter, *l_first;
+			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			do {
+				ELEM_DATA_COPY(l_iter);
+			} while ((l_iter = l_iter->next) != l_first);
+		}
+	}
+	else {
+		const char itype = (htype == BM_VERT) ? BM_VERTS_OF_MESH :
+		                   (htype == BM_EDGE) ? BM_EDGES_OF_MESH : BM_FACES_OF_MESH;
+		BMElem *ele;
+
+		BLI_assert(ELEM(htype, BM_VERT, BM_EDGE, BM_FACE));
+
+		BM_ITER_MESH (ele, &iter, bm, itype) {
+			ELEM_DATA_COPY(ele);
+		}
+	}
+
+#undef ELEM_DATA_COPY
+}
+
+/**
+ * Copy one custom-data layer of all elements of \a htype into a contiguous array
+ * (one layer at a time, instead of the per-element blocks BMesh uses).
+ * The array is in iteration order, which matches element indices when they're valid.
+ *
+ * Loops that only work on a single layer can run on the array without
+ * striding over unrelated layers, writing the result back with #BM_data_layer_from_array.
+ *
+ * \note Data is copied as-is, don't use for layers which own allocated memory (#CD_MDISPS for eg).
+ */
+void BM_data_layer_to_array(BMesh *bm, const char htype, const int cd_offset, const size_t data_size, void *r_array)
+{
+	bm_data_layer_array_copy(bm, htype, cd_offset, data_size, r_array, true);
+}
+
+/**
+ * Write back an array filled by #BM_data_layer_to_array.
+ */
+void BM_data_layer_from_array(BMesh *bm, const char htype, const int cd_offset, const size_t data_size, const void *array)
+{
+	bm_data_layer_array_copy(bm, htype, cd_offset, data_size, (char *)array, false);
+}
+
 float BM_elem_float_data_get(CustomData *cd, void *element, int type)
 {
 	const float *f = CustomData_bmesh_get(cd, ((BMHeader *)element)->data, type);
@@ -51,6 +51,10 @@ void  BM_data_layer_add_named(BMesh *bm, CustomData *data, int type, const char
 void  BM_data_layer_free(BMesh *bm, CustomData *data, int type);
 void  BM_data_layer_free_n(BMesh *bm, CustomData *data, int type, int n);
 void  BM_data_layer_copy(BMesh *bm, CustomData *data, int type, int src_n, int dst_n);
+void  BM_data_layer_to_array(
+        BMesh *bm, const char htype, const int cd_offset, const size_t data_size, void *r_array);
+void  BM_data_layer_from_array(
+        BMesh *bm, const char htype, const int cd_offset, const size_t data_size, const void *array);
 
 float BM_elem_float_data_get(CustomData *cd, void *element, int type);
 void  BM_elem_float_data_set(CustomData *cd, void *element, int type, const float val);
@@ -86,8 +86,10 @@
 #include "BLI_listbase.h"
 #include "BLI_alloca.h"
 #include "BLI_math_vector.h"
+#include "BLI_task.h"
 
 #include "BKE_mesh.h"
+#include "BKE_mesh_mapping.h"
 #include "BKE_customdata.h"
 #include "BKE_multires.h"
 
@@ -217,6 +219,525 @@ static BMFace *bm_face_create_from_mpoly(
 }
 
 
+typedef struct BMeshFromMeshData {
+	BMesh *bm;
+	Mesh *me;
+	const struct BMeshFromMeshParams *params;
+
+	/* active shape key coordinates (when used) */
+	const float (*keyco)[3];
+	const float (**shape_key_table)[3];
+	int tot_shape_keys;
+
+	int cd_vert_bweight_offset;
+	int cd_edge_bweight_offset;
+	int cd_edge_crease_offset;
+	int cd_shape_key_offset;
+	int cd_shape_keyindex_offset;
+
+	BMVert **vtable;
+	BMEdge **etable;
+
+	/* only used by the bulk path */
+	BMFace **ftable;
+	MeshElemMap *vert_edge_map;
+	/* loops of each edge in creation order, edge 'i' uses
+	 * 'edge_loops[edge_loops_offset[i]]' up to 'edge_loops[edge_loops_offset[i + 1]]' */
+	BMLoop **edge_loops;
+	int *edge_loops_offset;
+} BMeshFromMeshData;
+
+typedef struct BMeshFromMeshSelectChunk {
+	int totsel;
+} BMeshFromMeshSelectChunk;
+
+/**
+ * Set everything besides selection, which is handled by the caller
+ * since it has to keep the selection counters in sync.
+ */
+static void bm_vert_attrs_from_mvert(
+        const BMeshFromMeshData *data, BMVert *v, const MVert *mvert, const int i)
+{
+	BMesh *bm = data->bm;
+
+	/* transfer flag */
+	v->head.hflag = BM_vert_flag_from_mflag(mvert->flag & ~SELECT);
+
+	normal_short_to_float_v3(v->no, mvert->no);
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&data->me->vdata, &bm->vdata, i, &v->head.data, true);
+
+	if (data->cd_vert_bweight_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(v, data->cd_vert_bweight_offset, (float)mvert->bweight / 255.0f);
+	}
+
+	/* set shape key original index */
+	if (data->cd_shape_keyindex_offset != -1) {
+		BM_ELEM_CD_SET_INT(v, data->cd_shape_keyindex_offset, i);
+	}
+
+	/* set shapekey data */
+	if (data->tot_shape_keys) {
+		float (*co_dst)[3] = BM_ELEM_CD_GET_VOID_P(v, data->cd_shape_key_offset);
+		int j;
+		for (j = 0; j < data->tot_shape_keys; j++, co_dst++) {
+			copy_v3_v3(*co_dst, data->shape_key_table[j][i]);
+		}
+	}
+}
+
+static void bm_edge_attrs_from_medge(
+        const BMeshFromMeshData *data, BMEdge *e, const MEdge *medge, const int i)
+{
+	BMesh *bm = data->bm;
+
+	/* transfer flags */
+	e->head.hflag = BM_edge_flag_from_mflag(medge->flag & ~SELECT);
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&data->me->edata, &bm->edata, i, &e->head.data, true);
+
+	if (data->cd_edge_bweight_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(e, data->cd_edge_bweight_offset, (float)medge->bweight / 255.0f);
+	}
+	if (data->cd_edge_crease_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(e, data->cd_edge_crease_offset, (float)medge->crease / 255.0f);
+	}
+}
+
+static void bm_face_attrs_from_mpoly(
+        const BMeshFromMeshData *data, BMFace *f, const MPoly *mp, const int i)
+{
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMLoop *l_iter, *l_first;
+	int j;
+
+	/* transfer flag */
+	f->head.hflag = BM_face_flag_from_mflag(mp->flag & ~ME_FACE_SEL);
+
+	f->mat_nr = mp->mat_nr;
+
+	j = mp->loopstart;
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do {
+		/* Save index of correspsonding MLoop */
+		CustomData_to_bmesh_block(&me->ldata, &bm->ldata, j++, &l_iter->head.data, true);
+	} while ((l_iter = l_iter->next) != l_first);
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
+
+	if (data->params->calc_face_normal) {
+		BM_face_normal_update(f);
+	}
+}
+
+/**
+ * Create elements one at a time using the regular BMesh API,
+ * this handles any input (including faces that fail to be created).
+ */
+static void bm_mesh_elems_from_me_serial(BMeshFromMeshData *data)
+{
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMVert *v, **vtable = data->vtable;
+	BMEdge *e, **etable = data->etable;
+	BMFace *f;
+	MVert *mvert;
+	MEdge *medge;
+	MPoly *mp;
+	int i, totloops;
+
+	for (i = 0, mvert = me->mvert; i < me->totvert; i++, mvert++) {
+		v = vtable[i] = BM_vert_create(
+		        bm, data->keyco ? data->keyco[i] : mvert->co, NULL,
+		        BM_CREATE_SKIP_CD);
+		BM_elem_index_set(v, i); /* set_ok */
+
+		bm_vert_attrs_from_mvert(data, v, mvert, i);
+
+		/* this is necessary for selection counts to work properly */
+		if (mvert->flag & SELECT) {
+			BM_vert_select_set(bm, v, true);
+		}
+	}
+
+	bm->elem_index_dirty &= ~BM_VERT; /* added in order, clear dirty flag */
+
+	if (!me->totedge) {
+		return;
+	}
+
+	for (i = 0, medge = me->medge; i < me->totedge; i++, medge++) {
+		e = etable[i] = BM_edge_create(bm, vtable[medge->v1], vtable[medge->v2], NULL, BM_CREATE_SKIP_CD);
+		BM_elem_index_set(e, i); /* set_ok */
+
+		bm_edge_attrs_from_medge(data, e, medge, i);
+
+		/* this is necessary for selection counts to work properly */
+		if (medge->flag & SELECT) {
+			BM_edge_select_set(bm, e, true);
+		}
+	}
+
+	bm->elem_index_dirty &= ~BM_EDGE; /* added in order, clear dirty flag */
+
+	for (i = 0, totloops = 0, mp = me->mpoly; i < me->totpoly; i++, mp++) {
+		BMLoop *l_iter;
+		BMLoop *l_first;
+
+		f = bm_face_create_from_mpoly(mp, me->mloop + mp->loopstart,
+		                              bm, vtable, etable);
+
+		if (UNLIKELY(f == NULL)) {
+			printf("%s: Warning! Bad face in mesh"
+			       " \"%s\" at index %d!, skipping\n",
+			       __func__, me->id.name + 2, i);
+			continue;
+		}
+
+		/* don't use 'i' since we may have skipped the face */
+		BM_elem_index_set(f, bm->totface - 1); /* set_ok */
+
+		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+		do {
+			/* don't use 'j' since we may have skipped some faces, hence some loops. */
+			BM_elem_index_set(l_iter, totloops++); /* set_ok */
+		} while ((l_iter = l_iter->next) != l_first);
+
+		bm_face_attrs_from_mpoly(data, f, mp, i);
+
+		/* this is necessary for selection counts to work properly */
+		if (mp->flag & ME_FACE_SEL) {
+			BM_face_select_set(bm, f, true);
+		}
+
+		if (i == me->act_face) bm->act_face = f;
+	}
+
+	bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP); /* added in order, clear dirty flag */
+}
+
+#ifndef USE_BMESH_HOLES
+
+/* Bulk construction callbacks, run in order: vertices, faces, edges, then vertices again
+ * (face normals need vertex coordinates, edge and vertex selection depend on faces). */
+
+static void bm_mesh_bulk_vert_cb(void *userdata, const int i)
+{
+	const BMeshFromMeshData *data = userdata;
+	const MVert *mvert = &data->me->mvert[i];
+	BMVert *v = data->vtable[i];
+
+	v->head.htype = BM_VERT;
+	v->head.api_flag = 0;
+	BM_elem_index_set(v, i); /* set_ok */
+
+	copy_v3_v3(v->co, data->keyco ? data->keyco[i] : mvert->co);
+
+	bm_vert_attrs_from_mvert(data, v, mvert, i);
+}
+
+static void bm_mesh_bulk_face_cb(void *userdata, void *userdata_chunk, const int i, const int UNUSED(threadid))
+{
+	const BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	const MPoly *mp = &data->me->mpoly[i];
+	BMFace *f = data->ftable[i];
+
+	f->head.htype = BM_FACE;
+	f->head.api_flag = 0;
+	BM_elem_index_set(f, i); /* set_ok */
+
+	f->len = mp->totloop;
+	zero_v3(f->no);
+
+	bm_face_attrs_from_mpoly(data, f, mp, i);
+
+	if ((mp->flag & ME_FACE_SEL) && !BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
+		BM_elem_flag_enable(f, BM_ELEM_SELECT);
+		chunk->totsel++;
+	}
+}
+
+static void bm_mesh_bulk_edge_cb(void *userdata, void *userdata_chunk, const int i, const int UNUSED(threadid))
+{
+	const BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	const MEdge *medge = &data->me->medge[i];
+	BMEdge *e = data->etable[i];
+	BMLoop **loops = &data->edge_loops[data->edge_loops_offset[i]];
+	const int loops_len = data->edge_loops_offset[i + 1] - data->edge_loops_offset[i];
+	bool is_select = (medge->flag & SELECT) != 0;
+	int j;
+
+	e->head.htype = BM_EDGE;
+	e->head.api_flag = 0;
+	BM_elem_index_set(e, i); /* set_ok */
+
+	e->v1 = data->vtable[medge->v1];
+	e->v2 = data->vtable[medge->v2];
+
+	/* radial cycle, matches the result of appending loops as they're created */
+	for (j = 0; j < loops_len; j++) {
+		BMLoop *l = loops[j];
+		l->radial_next = loops[(j + 1) % loops_len];
+		l->radial_prev = loops[(j + loops_len - 1) % loops_len];
+		if (BM_elem_flag_test(l->f, BM_ELEM_SELECT)) {
+			is_select = true;
+		}
+	}
+	e->l = loops_len ? loops[loops_len - 1] : NULL;
+
+	bm_edge_attrs_from_medge(data, e, medge, i);
+
+	if (is_select && !BM_elem_flag_test(e, BM_ELEM_HIDDEN)) {
+		BM_elem_flag_enable(e, BM_ELEM_SELECT);
+		chunk->totsel++;
+	}
+}
+
+static void bm_mesh_bulk_vert_disk_cb(void *userdata, void *userdata_chunk, const int i, const int UNUSED(threadid))
+{
+	const BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	const MeshElemMap *map = &data->vert_edge_map[i];
+	BMEdge **etable = data->etable;
+	BMVert *v = data->vtable[i];
+	bool is_select = (data->me->mvert[i].flag & SELECT) != 0;
+	int j;
+
+	/* disk cycle, matches the result of appending edges as they're created */
+	for (j = 0; j < map->count; j++) {
+		BMEdge *e = etable[map->indices[j]];
+		BMDiskLink *dl = bmesh_disk_edge_link_from_vert(e, v);
+		dl->next = etable[map->indices[(j + 1) % map->count]];
+		dl->prev = etable[map->indices[(j + map->count - 1) % map->count]];
+
+		if (!is_select) {
+			if (BM_elem_flag_test(e, BM_ELEM_SELECT)) {
+				is_select = true;
+			}
+			else if (e->l) {
+				/* faces may be selected while their edges are hidden */
+				BMLoop *l_iter, *l_first;
+				l_iter = l_first = e->l;
+				do {
+					if (BM_elem_flag_test(l_iter->f, BM_ELEM_SELECT)) {
+						is_select = true;
+						break;
+					}
+				} while ((l_iter = l_iter->radial_next) != l_first);
+			}
+		}
+	}
+	v->e = map->count ? etable[map->indices[0]] : NULL;
+
+	if (is_select && !BM_elem_flag_test(v, BM_ELEM_HIDDEN)) {
+		BM_elem_flag_enable(v, BM_ELEM_SELECT);
+		chunk->totsel++;
+	}
+}
+
+static void bm_mesh_bulk_select_vert_finalize(void *userdata, void *userdata_chunk)
+{
+	BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	data->bm->totvertsel += chunk->totsel;
+}
+
+static void bm_mesh_bulk_select_edge_finalize(void *userdata, void *userdata_chunk)
+{
+	BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	data->bm->totedgesel += chunk->totsel;
+}
+
+static void bm_mesh_bulk_select_face_finalize(void *userdata, void *userdata_chunk)
+{
+	BMeshFromMeshData *data = userdata;
+	BMeshFromMeshSelectChunk *chunk = userdata_chunk;
+	data->bm->totfacesel += chunk->totsel;
+}
+
+#endif  /* USE_BMESH_HOLES */
+
+/**
+ * Allocate all elements up front, then fill in their members, custom-data
+ * and the disk & radial cycles in parallel.
+ *
+ * Gives the same result as #bm_mesh_elems_from_me_serial
+ * (element order, cycle order & selection), for meshes without degenerate geometry.
+ *
+ * \return false when the mesh can't be handled, in this case nothing has been changed.
+ */
+static bool bm_mesh_elems_from_me_bulk(BMeshFromMeshData *data)
+{
+#ifdef USE_BMESH_HOLES
+	UNUSED_VARS(data);
+	return false;
+#else
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMVert **vtable = data->vtable;
+	BMEdge **etable = data->etable;
+	BMFace **ftable;
+	const MEdge *medge;
+	const MPoly *mp;
+	const MLoop *ml;
+	BMLoop **edge_loops;
+	int *edge_loops_offset;
+	int *vert_edge_mem;
+	int i, j, totloop;
+	BMeshFromMeshSelectChunk chunk = {0};
+
+	if ((bm->totvert != 0) || (bm->totedge != 0) || (bm->totface != 0) || (me->totedge == 0)) {
+		return false;
+	}
+
+	/* degenerate geometry is left to the regular API */
+	for (i = 0, medge = me->medge; i < me->totedge; i++, medge++) {
+		if ((medge->v1 == medge->v2) ||
+		    (medge->v1 >= (unsigned int)me->totvert) ||
+		    (medge->v2 >= (unsigned int)me->totvert))
+		{
+			return false;
+		}
+	}
+	for (i = 0, totloop = 0, mp = me->mpoly; i < me->totpoly; i++, mp++) {
+		if ((mp->totloop <= 0) || (mp->loopstart < 0) || (mp->loopstart + mp->totloop > me->totloop)) {
+			return false;
+		}
+		for (j = 0, ml = &me->mloop[mp->loopstart]; j < mp->totloop; j++, ml++) {
+			if ((ml->v >= (unsigned int)me->totvert) || (ml->e >= (unsigned int)me->totedge)) {
+				return false;
+			}
+		}
+		totloop += mp->totloop;
+	}
+
+	const bool use_threading = (me->totvert + me->totedge + me->totpoly >= BM_OMP_LIMIT);
+
+	ftable = data->ftable = MEM_mallocN(sizeof(*ftable) * (size_t)max_ii(me->totpoly, 1), __func__);
+	edge_loops = data->edge_loops = MEM_mallocN(sizeof(*edge_loops) * (size_t)max_ii(totloop, 1), __func__);
+	edge_loops_offset = data->edge_loops_offset = MEM_callocN(sizeof(*edge_loops_offset) * (size_t)(me->totedge + 1), __func__);
+	BKE_mesh_vert_edge_map_create(&data->vert_edge_map, &vert_edge_mem, me->medge, me->totvert, me->totedge);
+
+	/* count the loops using each edge, then offset into 'edge_loops' */
+	for (i = 0, mp = me->mpoly; i < me->totpoly; i++, mp++) {
+		for (j = 0, ml = &me->mloop[mp->loopstart]; j < mp->totloop; j++, ml++) {
+			edge_loops_offset[ml->e + 1]++;
+		}
+	}
+	for (i = 0; i < me->totedge; i++) {
+		edge_loops_offset[i + 1] += edge_loops_offset[i];
+	}
+
+	/* Allocate all elements in the same order as the regular API does,
+	 * so the resulting memory layout (and iteration order) is unchanged. */
+	for (i = 0; i < me->totvert; i++) {
+		BMVert *v = vtable[i] = BLI_mempool_alloc(bm->vpool);
+		v->head.data = (bm->vdata.totsize > 0) ? BLI_mempool_alloc(bm->vdata.pool) : NULL;
+		if (bm->use_toolflags) {
+			((BMVert_OFlag *)v)->oflags = bm->vtoolflagpool ? BLI_mempool_calloc(bm->vtoolflagpool) : NULL;
+		}
+	}
+
+	for (i = 0; i < me->totedge; i++) {
+		BMEdge *e = etable[i] = BLI_mempool_alloc(bm->epool);
+		e->head.data = (bm->edata.totsize > 0) ? BLI_mempool_alloc(bm->edata.pool) : NULL;
+		if (bm->use_toolflags) {
+			((BMEdge_OFlag *)e)->oflags = bm->etoolflagpool ? BLI_mempool_calloc(bm->etoolflagpool) : NULL;
+		}
+	}
+
+	for (i = 0, totloop = 0, mp = me->mpoly; i < me->totpoly; i++, mp++) {
+		BMFace *f = ftable[i] = BLI_mempool_alloc(bm->fpool);
+		BMLoop *l_prev = NULL, *l_first = NULL;
+
+		f->head.data = (bm->pdata.totsize > 0) ? BLI_mempool_alloc(bm->pdata.pool) : NULL;
+		if (bm->use_toolflags) {
+			((BMFace_OFlag *)f)->oflags = bm->ftoolflagpool ? BLI_mempool_calloc(bm->ftoolflagpool) : NULL;
+		}
+
+		for (j = 0, ml = &me->mloop[mp->loopstart]; j < mp->totloop; j++, ml++) {
+			BMLoop *l = BLI_mempool_alloc(bm->lpool);
+
+			l->head.data = (bm->ldata.totsize > 0) ? BLI_mempool_alloc(bm->ldata.pool) : NULL;
+			l->head.htype = BM_LOOP;
+			l->head.hflag = 0;
+			l->head.api_flag = 0;
+			BM_elem_index_set(l, totloop++); /* set_ok */
+
+			l->v = vtable[ml->v];
+			l->e = etable[ml->e];
+			l->f = f;
+
+			if (l_prev) {
+				l->prev = l_prev;
+				l_prev->next = l;
+			}
+			else {
+				l_first = l;
+			}
+			l_prev = l;
+
+			edge_loops[edge_loops_offset[ml->e]++] = l;
+		}
+
+		l_first->prev = l_prev;
+		l_prev->next = l_first;
+		f->l_first = l_first;
+	}
+
+	/* filling 'edge_loops' moved each offset to the start of the next edge, shift them back */
+	for (i = me->totedge; i > 0; i--) {
+		edge_loops_offset[i] = edge_loops_offset[i - 1];
+	}
+	edge_loops_offset[0] = 0;
+
+	BLI_task_parallel_range(
+	        0, me->totvert, data,
+	        bm_mesh_bulk_vert_cb, use_threading);
+
+	BLI_task_parallel_range_finalize(
+	        0, me->totpoly, data, &chunk, sizeof(chunk),
+	        bm_mesh_bulk_face_cb, bm_mesh_bulk_select_face_finalize, use_threading, false);
+
+	BLI_task_parallel_range_finalize(
+	        0, me->totedge, data, &chunk, sizeof(chunk),
+	        bm_mesh_bulk_edge_cb, bm_mesh_bulk_select_edge_finalize, use_threading, false);
+
+	BLI_task_parallel_range_finalize(
+	        0, me->totvert, data, &chunk, sizeof(chunk),
+	        bm_mesh_bulk_vert_disk_cb, bm_mesh_bulk_select_vert_finalize, use_threading, false);
+
+	bm->totvert = me->totvert;
+	bm->totedge = me->totedge;
+	bm->totface = me->totpoly;
+	bm->totloop = totloop;
+
+	/* added in order, clear dirty flag */
+	bm->elem_index_dirty &= ~(BM_VERT | BM_EDGE | BM_FACE | BM_LOOP);
+	bm->elem_table_dirty |= (BM_VERT | BM_EDGE | BM_FACE);
+
+	if ((me->act_face >= 0) && (me->act_face < me->totpoly)) {
+		bm->act_face = ftable[me->act_face];
+	}
+
+	MEM_freeN(data->vert_edge_map);
+	MEM_freeN(vert_edge_mem);
+	MEM_freeN(edge_loops);
+	MEM_freeN(edge_loops_offset);
+	MEM_freeN(ftable);
+
+	return true;
+#endif  /* USE_BMESH_HOLES */
+}
+
+
 /**
  * \brief Mesh -> BMesh
  *
@@ -226,16 +747,11 @@ void BM_mesh_bm_from_me(
         BMesh *bm, Mesh *me,
         const struct BMeshFromMeshParams *params)
 {
-	MVert *mvert;
-	MEdge *medge;
-	MLoop *mloop;
-	MPoly *mp;
 	KeyBlock *actkey, *block;
-	BMVert *v, **vtable = NULL;
-	BMEdge *e, **etable = NULL;
-	BMFace *f;
+	BMVert **vtable = NULL;
+	BMEdge **etable = NULL;
 	float (*keyco)[3] = NULL;
-	int totuv, totloops, i, j;
+	int totuv, i, j;
 
 	/* free custom data */
 	/* this isnt needed in most cases but do just incase */
@@ -326,128 +842,35 @@ void BM_mesh_bm_from_me(
 
 	BM_mesh_cd_flag_apply(bm, me->cd_flag);
 
-	const int cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
-	const int cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
-	const int cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE);
-	const int cd_shape_key_offset = me->key ? CustomData_get_offset(&bm->vdata, CD_SHAPEKEY) : -1;
-	const int cd_shape_keyindex_offset = (tot_shape_keys || params->add_key_index) ?
-	          CustomData_get_offset(&bm->vdata, CD_SHAPE_KEYINDEX) : -1;
-
-	for (i = 0, mvert = me->mvert; i < me->totvert; i++, mvert++) {
-		v = vtable[i] = BM_vert_create(
-		        bm, keyco && params->use_shapekey ? keyco[i] : mvert->co, NULL,
-		        BM_CREATE_SKIP_CD);
-		BM_elem_index_set(v, i); /* set_ok */
-
-		/* transfer flag */
-		v->head.hflag = BM_vert_flag_from_mflag(mvert->flag & ~SELECT);
-
-		/* this is necessary for selection counts to work properly */
-		if (mvert->flag & SELECT) {
-			BM_vert_select_set(bm, v, true);
-		}
-
-		normal_short_to_float_v3(v->no, mvert->no);
-
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i, &v->head.data, true);
+	BMeshFromMeshData data = {
+	        .bm = bm, .me = me, .params = params,
+	        .keyco = params->use_shapekey ? (const float (*)[3])keyco : NULL,
+	        .shape_key_table = shape_key_table,
+	        .tot_shape_keys = tot_shape_keys,
 
-		if (cd_vert_bweight_offset != -1) BM_ELEM_CD_SET_FLOAT(v, cd_vert_bweight_offset, (float)mvert->bweight / 255.0f);
+	        .cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT),
+	        .cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT),
+	        .cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE),
+	        .cd_shape_key_offset = me->key ? CustomData_get_offset(&bm->vdata, CD_SHAPEKEY) : -1,
+	        .cd_shape_keyindex_offset = (tot_shape_keys || params->add_key_index) ?
+	                                    CustomData_get_offset(&bm->vdata, CD_SHAPE_KEYINDEX) : -1,
 
-		/* set shape key original index */
-		if (cd_shape_keyindex_offset != -1) BM_ELEM_CD_SET_INT(v, cd_shape_keyindex_offset, i);
+	        .vtable = vtable,
+	};
 
-		/* set shapekey data */
-		if (tot_shape_keys) {
-			float (*co_dst)[3] = BM_ELEM_CD_GET_VOID_P(v, cd_shape_key_offset);
-			for (j = 0; j < tot_shape_keys; j++, co_dst++) {
-				copy_v3_v3(*co_dst, shape_key_table[j][i]);
-			}
-		}
+	if (me->totedge) {
+		etable = data.etable = MEM_mallocN(sizeof(void **) * me->totedge, "mesh to bmesh etable");
 	}
 
-	bm->elem_index_dirty &= ~BM_VERT; /* added in order, clear dirty flag */
+	if (params->use_serial || !bm_mesh_elems_from_me_bulk(&data)) {
+		bm_mesh_elems_from_me_serial(&data);
+	}
 
 	if (!me->totedge) {
 		MEM_freeN(vtable);
 		return;
 	}
 
-	etable = MEM_mallocN(sizeof(void **) * me->totedge, "mesh to bmesh etable");
-
-	medge = me->medge;
-	for (i = 0; i < me->totedge; i++, medge++) {
-		e = etable[i] = BM_edge_create(bm, vtable[medge->v1], vtable[medge->v2], NULL, BM_CREATE_SKIP_CD);
-		BM_elem_index_set(e, i); /* set_ok */
-
-		/* transfer flags */
-		e->head.hflag = BM_edge_flag_from_mflag(medge->flag & ~SELECT);
-
-		/* this is necessary for selection counts to work properly */
-		if (medge->flag & SELECT) {
-			BM_edge_select_set(bm, e, true);
-		}
-
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->edata, &bm->edata, i, &e->head.data, true);
-
-		if (cd_edge_bweight_offset != -1) BM_ELEM_CD_SET_FLOAT(e, cd_edge_bweight_offset, (float)medge->bweight / 255.0f);
-		if (cd_edge_crease_offset  != -1) BM_ELEM_CD_SET_FLOAT(e, cd_edge_crease_offset,  (float)medge->crease  / 255.0f);
-
-	}
-
-	bm->elem_index_dirty &= ~BM_EDGE; /* added in order, clear dirty flag */
-
-	mloop = me->mloop;
-	mp = me->mpoly;
-	for (i = 0, totloops = 0; i < me->totpoly; i++, mp++) {
-		BMLoop *l_iter;
-		BMLoop *l_first;
-
-		f = bm_face_create_from_mpoly(mp, mloop + mp->loopstart,
-		                              bm, vtable, etable);
-
-		if (UNLIKELY(f == NULL)) {
-			printf("%s: Warning! Bad face in mesh"
-			       " \"%s\" at index %d!, skipping\n",
-			       __func__, me->id.name + 2, i);
-			continue;
-		}
-
-		/* don't use 'i' since we may have skipped the face */
-		BM_elem_index_set(f, bm->totface - 1); /* set_ok */
-
-		/* transfer flag */
-		f->head.hflag = BM_face_flag_from_mflag(mp->flag & ~ME_FACE_SEL);
-
-		/* this is necessary for selection counts to work properly */
-		if (mp->flag & ME_FACE_SEL) {
-			BM_face_select_set(bm, f, true);
-		}
-
-		f->mat_nr = mp->mat_nr;
-		if (i == me->act_face) bm->act_face = f;
-
-		j = mp->loopstart;
-		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-		do {
-			/* don't use 'j' since we may have skipped some faces, hence some loops. */
-			BM_elem_index_set(l_iter, totloops++); /* set_ok */
-
-			/* Save index of correspsonding MLoop */
-			CustomData_to_bmesh_block(&me->ldata, &bm->ldata, j++, &l_iter->head.data, true);
-		} while ((l_iter = l_iter->next) != l_first);
-
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
-
-		if (params->calc_face_normal) {
-			BM_face_normal_update(f);
-		}
-	}
-
-	bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP); /* added in order, clear dirty flag */
-
 	if (me->mselect && me->totselect != 0) {
 
 		BMVert **vert_array = MEM_mallocN(sizeof(BMVert *) * bm->totvert, "VSelConv");
@@ -576,6 +999,104 @@ BLI_INLINE void bmesh_quick_edgedraw_flag(MEdge *med, BMEdge *e)
 	}
 }
 
+typedef struct BMeshToMeshData {
+	BMesh *bm;
+	Mesh *me;
+
+	int cd_vert_bweight_offset;
+	int cd_edge_bweight_offset;
+	int cd_edge_crease_offset;
+} BMeshToMeshData;
+
+static void bm_to_mesh_vert_cb(void *userdata, const int i)
+{
+	const BMeshToMeshData *data = userdata;
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMVert *v = bm->vtable[i];
+	MVert *mvert = &me->mvert[i];
+
+	copy_v3_v3(mvert->co, v->co);
+	normal_float_to_short_v3(mvert->no, v->no);
+
+	mvert->flag = BM_vert_flag_to_mflag(v);
+
+	BM_elem_index_set(v, i); /* set_inline */
+
+	/* copy over customdat */
+	CustomData_from_bmesh_block(&bm->vdata, &me->vdata, v->head.data, i);
+
+	if (data->cd_vert_bweight_offset != -1) mvert->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, data->cd_vert_bweight_offset);
+
+	BM_CHECK_ELEMENT(v);
+}
+
+static void bm_to_mesh_edge_cb(void *userdata, const int i)
+{
+	const BMeshToMeshData *data = userdata;
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMEdge *e = bm->etable[i];
+	MEdge *med = &me->medge[i];
+
+	med->v1 = BM_elem_index_get(e->v1);
+	med->v2 = BM_elem_index_get(e->v2);
+
+	med->flag = BM_edge_flag_to_mflag(e);
+
+	BM_elem_index_set(e, i); /* set_inline */
+
+	/* copy over customdata */
+	CustomData_from_bmesh_block(&bm->edata, &me->edata, e->head.data, i);
+
+	bmesh_quick_edgedraw_flag(med, e);
+
+	if (data->cd_edge_crease_offset  != -1) med->crease  = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, data->cd_edge_crease_offset);
+	if (data->cd_edge_bweight_offset != -1) med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, data->cd_edge_bweight_offset);
+
+	BM_CHECK_ELEMENT(e);
+}
+
+/* needs 'MPoly.loopstart' to be set */
+static void bm_to_mesh_face_cb(void *userdata, const int i)
+{
+	const BMeshToMeshData *data = userdata;
+	BMesh *bm = data->bm;
+	Mesh *me = data->me;
+	BMFace *f = bm->ftable[i];
+	MPoly *mpoly = &me->mpoly[i];
+	BMLoop *l_iter, *l_first;
+	int j = mpoly->loopstart;
+	MLoop *mloop = &me->mloop[j];
+
+	mpoly->totloop = f->len;
+	mpoly->mat_nr = f->mat_nr;
+	mpoly->flag = BM_face_flag_to_mflag(f);
+
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do {
+		mloop->e = BM_elem_index_get(l_iter->e);
+		mloop->v = BM_elem_index_get(l_iter->v);
+
+		/* copy over customdata */
+		CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
+
+		j++;
+		mloop++;
+		BM_CHECK_ELEMENT(l_iter);
+		BM_CHECK_ELEMENT(l_iter->e);
+		BM_CHECK_ELEMENT(l_iter->v);
+	} while ((l_iter = l_iter->next) != l_first);
+
+	/* only a single face can match */
+	if (f == bm->act_face) me->act_face = i;
+
+	/* copy over customdata */
+	CustomData_from_bmesh_block(&bm->pdata, &me->pdata, f->head.data, i);
+
+	BM_CHECK_ELEMENT(f);
+}
+
 void BM_mesh_bm_to_me(
         BMesh *bm, Mesh *me,
         const struct BMeshToMeshParams *params)
@@ -583,10 +1104,8 @@ void BM_mesh_bm_to_me(
 	MLoop *mloop;
 	MPoly *mpoly;
 	MVert *mvert, *oldverts;
-	MEdge *med, *medge;
-	BMVert *v, *eve;
-	BMEdge *e;
-	BMFace *f;
+	MEdge *medge;
+	BMVert *eve;
 	BMIter iter;
 	int i, j, ototvert;
 
@@ -657,83 +1176,31 @@ void BM_mesh_bm_to_me(
 	/* this is called again, 'dotess' arg is used there */
 	BKE_mesh_update_customdata_pointers(me, 0);
 
-	i = 0;
-	BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
-		copy_v3_v3(mvert->co, v->co);
-		normal_float_to_short_v3(mvert->no, v->no);
-
-		mvert->flag = BM_vert_flag_to_mflag(v);
-
-		BM_elem_index_set(v, i); /* set_inline */
-
-		/* copy over customdat */
-		CustomData_from_bmesh_block(&bm->vdata, &me->vdata, v->head.data, i);
-
-		if (cd_vert_bweight_offset != -1) mvert->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, cd_vert_bweight_offset);
-
-		i++;
-		mvert++;
-
-		BM_CHECK_ELEMENT(v);
-	}
-	bm->elem_index_dirty &= ~BM_VERT;
-
-	med = medge;
-	i = 0;
-	BM_ITER_MESH (e, &iter, bm, BM_EDGES_OF_MESH) {
-		med->v1 = BM_elem_index_get(e->v1);
-		med->v2 = BM_elem_index_get(e->v2);
-
-		med->flag = BM_edge_flag_to_mflag(e);
-
-		BM_elem_index_set(e, i); /* set_inline */
-
-		/* copy over customdata */
-		CustomData_from_bmesh_block(&bm->edata, &me->edata, e->head.data, i);
-
-		bmesh_quick_edgedraw_flag(med, e);
-
-		if (cd_edge_crease_offset  != -1) med->crease  = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_crease_offset);
-		if (cd_edge_bweight_offset != -1) med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_bweight_offset);
-
-		i++;
-		med++;
-		BM_CHECK_ELEMENT(e);
-	}
-	bm->elem_index_dirty &= ~BM_EDGE;
-
-	i = 0;
-	j = 0;
-	BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
-		BMLoop *l_iter, *l_first;
-		mpoly->loopstart = j;
-		mpoly->totloop = f->len;
-		mpoly->mat_nr = f->mat_nr;
-		mpoly->flag = BM_face_flag_to_mflag(f);
-
-		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-		do {
-			mloop->e = BM_elem_index_get(l_iter->e);
-			mloop->v = BM_elem_index_get(l_iter->v);
-
-			/* copy over customdata */
-			CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
-
-			j++;
-			mloop++;
-			BM_CHECK_ELEMENT(l_iter);
-			BM_CHECK_ELEMENT(l_iter->e);
-			BM_CHECK_ELEMENT(l_iter->v);
-		} while ((l_iter = l_iter->next) != l_first);
-
-		if (f == bm->act_face) me->act_face = i;
-
-		/* copy over customdata */
-		CustomData_from_bmesh_block(&bm->pdata, &me->pdata, f->head.data, i);
+	{
+		BMeshToMeshData data = {
+		        .bm = bm, .me = me,
+		        .cd_vert_bweight_offset = cd_vert_bweight_offset,
+		        .cd_edge_bweight_offset = cd_edge_bweight_offset,
+		        .cd_edge_crease_offset = cd_edge_crease_offset,
+		};
+		const bool use_threading = (bm->totvert + bm->totedge + bm->totface >= BM_OMP_LIMIT);
+
+		BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
+
+		BLI_task_parallel_range(0, bm->totvert, &data, bm_to_mesh_vert_cb, use_threading);
+		bm->elem_index_dirty &= ~BM_VERT;
+
+		/* edges read vertex indices */
+		BLI_task_parallel_range(0, bm->totedge, &data, bm_to_mesh_edge_cb, use_threading);
+		bm->elem_index_dirty &= ~BM_EDGE;
+
+		for (i = 0, j = 0; i < bm->totface; i++) {
+			mpoly[i].loopstart = j;
+			j += bm->ftable[i]->len;
+		}
 
-		i++;
-		mpoly++;
-		BM_CHECK_ELEMENT(f);
+		/* faces & loops read vertex and edge indices */
+		BLI_task_parallel_range(0, bm->totface, &data, bm_to_mesh_face_cb, use_threading);
 	}
 
 	/* patch hook indices and vertex parents */
@@ -906,53 +1373,65 @@ void BM_mesh_bm_to_me(
 			fp = newkey = MEM_callocN(me->key->elemsize * bm->totvert,  "currkey->data");
 			oldkey = currkey->data;
 
-			mvert = me->mvert;
-			BM_ITER_MESH (eve, &iter, bm, BM_VERTS_OF_MESH) {
-
-				if (currkey == actkey) {
-					copy_v3_v3(fp, eve->co);
+			if ((currkey != actkey) && (j != -1)) {
+				/* in most cases this runs, copy the whole layer at once */
+				BM_data_layer_to_array(bm, BM_VERT, cd_shape_offset, sizeof(float[3]), newkey);
 
-					if (actkey != me->key->refkey) { /* important see bug [#30771] */
-						if (cd_shape_keyindex_offset != -1) {
-							if (oldverts) {
-								keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset);
-								if (keyi != ORIGINDEX_NONE && keyi < currkey->totelem) { /* valid old vertex */
-									copy_v3_v3(mvert->co, oldverts[keyi].co);
+				/* propagate edited basis offsets to other shapes */
+				if (apply_offset) {
+					float (*newkey_co)[3] = (float (*)[3])newkey;
+					for (i = 0; i < bm->totvert; i++) {
+						add_v3_v3(newkey_co[i], ofs[i]);
+					}
+					/* apply back into the BMesh too, see T50524 */
+					BM_data_layer_from_array(bm, BM_VERT, cd_shape_offset, sizeof(float[3]), newkey);
+				}
+			}
+			else {
+				mvert = me->mvert;
+				BM_ITER_MESH (eve, &iter, bm, BM_VERTS_OF_MESH) {
+
+					if (currkey == actkey) {
+						copy_v3_v3(fp, eve->co);
+
+						if (actkey != me->key->refkey) { /* important see bug [#30771] */
+							if (cd_shape_keyindex_offset != -1) {
+								if (oldverts) {
+									keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset);
+									if (keyi != ORIGINDEX_NONE && keyi < currkey->totelem) { /* valid old vertex */
+										copy_v3_v3(mvert->co, oldverts[keyi].co);
+									}
 								}
 							}
 						}
 					}
-				}
-				else if (j != -1) {
-					/* in most cases this runs */
-					copy_v3_v3(fp, BM_ELEM_CD_GET_VOID_P(eve, cd_shape_offset));
-				}
-				else if ((oldkey != NULL) &&
-				         (cd_shape_keyindex_offset != -1) &&
-				         ((keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset)) != ORIGINDEX_NONE) &&
-				         (keyi < currkey->totelem))
-				{
-					/* old method of reconstructing keys via vertice's original key indices,
-					 * currently used if the new method above fails (which is theoretically
-					 * possible in certain cases of undo) */
-					copy_v3_v3(fp, oldkey[keyi]);
-				}
-				else {
-					/* fail! fill in with dummy value */
-					copy_v3_v3(fp, mvert->co);
-				}
+					else if ((oldkey != NULL) &&
+					         (cd_shape_keyindex_offset != -1) &&
+					         ((keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset)) != ORIGINDEX_NONE) &&
+					         (keyi < currkey->totelem))
+					{
+						/* old method of reconstructing keys via vertice's original key indices,
+						 * currently used if the new method above fails (which is theoretically
+						 * possible in certain cases of undo) */
+						copy_v3_v3(fp, oldkey[keyi]);
+					}
+					else {
+						/* fail! fill in with dummy value */
+						copy_v3_v3(fp, mvert->co);
+					}
 
-				/* propagate edited basis offsets to other shapes */
-				if (apply_offset) {
-					add_v3_v3(fp, *ofs_pt++);
-					/* Apply back new coordinates of offsetted shapekeys into BMesh.
-					 * Otherwise, in case we call again BM_mesh_bm_to_me on same BMesh, we'll apply diff from previous
-					 * call to BM_mesh_bm_to_me, to shapekey values from *original creation of the BMesh*. See T50524. */
-					copy_v3_v3(BM_ELEM_CD_GET_VOID_P(eve, cd_shape_offset), fp);
-				}
+					/* propagate edited basis offsets to other shapes */
+					if (apply_offset) {
+						add_v3_v3(fp, *ofs_pt++);
+						/* Apply back new coordinates of offsetted shapekeys into BMesh.
+						 * Otherwise, in case we call again BM_mesh_bm_to_me on same BMesh, we'll apply diff from previous
+						 * call to BM_mesh_bm_to_me, to shapekey values from *original creation of the BMesh*. See T50524. */
+						copy_v3_v3(BM_ELEM_CD_GET_VOID_P(eve, cd_shape_offset), fp);
+					}
 
-				fp += 3;
-				mvert++;
+					fp += 3;
+					mvert++;
+				}
 			}
 
 			currkey->totelem = bm->totvert;
@@ -46,6 +46,8 @@ struct BMeshFromMeshParams {
 	unsigned int add_key_index : 1;
 	/* set vertex coordinates from the shapekey */
 	unsigned int use_shapekey : 1;
+	/* create elements one at a time, without bulk construction (gives the same result, for testing) */
+	unsigned int use_serial : 1;
 	/* define the active shape key (index + 1) */
 	int active_shapekey;
 };
@@ -1941,6 +1941,22 @@ static void build_boundary(BevelParams *bp, BevVert *bv, bool construct)
 	}
 }
 
+typedef struct BevVertSearchOrder {
+	int index;
+	int order;  /* position in the hash, to break ties the same way on every run */
+	BevVert *bv;
+} BevVertSearchOrder;
+
+static int bevvert_search_order_cmp(const void *a_, const void *b_)
+{
+	const BevVertSearchOrder *a = a_, *b = b_;
+
+	if (a->index != b->index) {
+		return (a->index < b->index) ? -1 : 1;
+	}
+	return (a->order < b->order) ? -1 : (a->order > b->order);
+}
+
 /* Do a global pass to try to make offsets as even as possible.
  * Consider this graph:
  *   nodes = BevVerts
@@ -1966,32 +1982,41 @@ static void build_boundary(BevelParams *bp, BevVert *bv, bool construct)
 static void adjust_offsets(BevelParams *bp)
 {
 	BevVert *bv, *searchbv, *bvother;
-	int i, searchi;
+	BevVertSearchOrder *search_order;
+	int i, search_order_len, search_order_index;
 	GHashIterator giter;
 	EdgeHalf *e, *efirst, *eother;
 	GSQueue *q;
 	float max_rel_adj;
 
 	BLI_assert(!bp->vertex_only);
-	GHASH_ITER(giter, bp->vert_hash) {
+
+	search_order_len = BLI_ghash_size(bp->vert_hash);
+	search_order = MEM_mallocN(sizeof(*search_order) * (size_t)max_ii(search_order_len, 1), __func__);
+	GHASH_ITER_INDEX(giter, bp->vert_hash, i) {
 		bv = BLI_ghashIterator_getValue(&giter);
 		bv->visited = false;
+		search_order[i].index = BM_elem_index_get(bv->v);
+		search_order[i].order = i;
+		search_order[i].bv = bv;
 	}
 
+	/* Roots are picked in vertex index order. An unvisited BevVert only changes its offsets once visited,
+	 * so sorting once and walking forward gives the same roots as searching all BevVerts
+	 * for each connected component, which is quadratic with many separate regions. */
+	qsort(search_order, (size_t)search_order_len, sizeof(*search_order), bevvert_search_order_cmp);
+	search_order_index = 0;
+
 	q = BLI_gsqueue_new(sizeof(BevVert *));
 	/* the following loop terminates because at least one node is visited each time */
 	for (;;) {
 		/* look for root of a connected component in search graph */
 		searchbv = NULL;
-		searchi = -1;
-		GHASH_ITER(giter, bp->vert_hash) {
-			bv = BLI_ghashIterator_getValue(&giter);
+		for (; search_order_index < search_order_len; search_order_index++) {
+			bv = search_order[search_order_index].bv;
 			if (!bv->visited && max_edge_half_offset_rel_change(bv) > 0.0f) {
-				i = BM_elem_index_get(bv->v);
-				if (!searchbv || i < searchi) {
-					searchbv = bv;
-					searchi = i;
-				}
+				searchbv = bv;
+				break;
 			}
 		}
 		if (searchbv == NULL)
@@ -2016,6 +2041,7 @@ static void adjust_offsets(BevelParams *bp)
 		}
 	}
 	BLI_gsqueue_free(q);
+	MEM_freeN(search_order);
 
 	/* Should we auto-limit the error accumulation? Typically, spirals can lead to 100x relative adjustments,
 	 * and somewhat hacky mechanism of using bp->limit_offset to indicate "clamp the adjustments" is not
@@ -51,6 +51,7 @@
 
 #include "BLI_kdopbvh.h"
 #include "BLI_buffer.h"
+#include "BLI_task.h"
 
 #include "bmesh.h"
 #include "intern/bmesh_private.h"
@@ -137,7 +138,8 @@ struct ISectState {
 	BMesh *bm;
 	GHash *edgetri_cache;  /* int[4]: BMVert */
 	GHash *edge_verts;  /* BMEdge: LinkList(of verts), new and original edges */
-	GHash *face_edges;  /* BMFace-index: LinkList(of edges), only original faces */
+	struct LinkBase *face_edges;  /* BMFace-index: LinkList(of edges), only original faces */
+	unsigned int face_edges_tot;  /* number of faces in 'face_edges' with edges added */
 	GSet  *wire_edges;  /* BMEdge  (could use tags instead) */
 	LinkNode *vert_dissolve;  /* BMVert's */
 
@@ -155,13 +157,31 @@ struct LinkBase {
 	unsigned int list_len;
 };
 
+static bool linkbase_insert_link(
+        struct LinkBase *ls_base, void *val, bool use_test,
+        MemArena *mem_arena)
+{
+	LinkNode *ls;
+
+	if (use_test && (BLI_linklist_index(ls_base->list, val) != -1)) {
+		return false;
+	}
+
+	ls = BLI_memarena_alloc(mem_arena, sizeof(*ls));
+	ls->next = ls_base->list;
+	ls->link = val;
+	ls_base->list = ls;
+	ls_base->list_len += 1;
+
+	return true;
+}
+
 static bool ghash_insert_link(
         GHash *gh, void *key, void *val, bool use_test,
         MemArena *mem_arena)
 {
 	void           **ls_base_p;
 	struct LinkBase *ls_base;
-	LinkNode *ls;
 
 	if (!BLI_ghash_ensure_p(gh, key, &ls_base_p)) {
 		ls_base = *ls_base_p = BLI_memarena_alloc(mem_arena, sizeof(*ls_base));
@@ -170,18 +190,9 @@ static bool ghash_insert_link(
 	}
 	else {
 		ls_base = *ls_base_p;
-		if (use_test && (BLI_linklist_index(ls_base->list, val) != -1)) {
-			return false;
-		}
 	}
 
-	ls = BLI_memarena_alloc(mem_arena, sizeof(*ls));
-	ls->next = ls_base->list;
-	ls->link = val;
-	ls_base->list = ls;
-	ls_base->list_len += 1;
-
-	return true;
+	return linkbase_insert_link(ls_base, val, use_test, mem_arena);
 }
 
 struct vert_sort_t {
@@ -232,12 +243,16 @@ static void face_edges_add(
         BMEdge *e,
         const bool use_test)
 {
-	void *f_index_key = SET_INT_IN_POINTER(f_index);
+	struct LinkBase *e_ls_base = &s->face_edges[f_index];
 	BLI_assert(e->head.htype == BM_EDGE);
+	BLI_assert(f_index >= 0 && f_index < s->bm->totface);
 	BLI_assert(BM_edge_in_face(e, s->bm->ftable[f_index]) == false);
 	BLI_assert(BM_elem_index_get(s->bm->ftable[f_index]) == f_index);
 
-	ghash_insert_link(s->face_edges, f_index_key, e, use_test, s->mem_arena);
+	if (e_ls_base->list_len == 0) {
+		s->face_edges_tot += 1;
+	}
+	linkbase_insert_link(e_ls_base, e, use_test, s->mem_arena);
 }
 
 #ifdef USE_NET
@@ -858,6 +873,94 @@ finally:
 
 #ifdef USE_BVH
 
+/**
+ * Looptri normals, calculated once up front since each triangle is typically part of many overlap pairs.
+ */
+struct LoopTriNormalData {
+	struct BMLoop *(*looptris)[3];
+	float (*looptri_nors)[3];
+};
+
+static void looptri_normal_cb(void *userdata, const int index)
+{
+	struct LoopTriNormalData *data = userdata;
+	BMLoop **lt = data->looptris[index];
+
+	normal_tri_v3(data->looptri_nors[index], lt[0]->v->co, lt[1]->v->co, lt[2]->v->co);
+}
+
+/**
+ * Return true when the triangle is on one side of the plane (and further away than \a margin).
+ *
+ * Intersection points found by #bm_isect_tri_tri may lie on an edge's extension by up to
+ * \a eps (as a factor of its length), so the range is expanded to account for this.
+ */
+static bool isect_tri_plane_is_separate(
+        const float *t_cos[3], const float plane_co[3], const float plane_no[3],
+        const float eps, const float margin)
+{
+	float dist_min, dist_max;
+	unsigned int i;
+
+	dist_min = dist_max = dot_v3v3(plane_no, t_cos[0]) - dot_v3v3(plane_no, plane_co);
+	for (i = 1; i < 3; i++) {
+		const float dist = dot_v3v3(plane_no, t_cos[i]) - dot_v3v3(plane_no, plane_co);
+		if (dist < dist_min) {
+			dist_min = dist;
+		}
+		else if (dist > dist_max) {
+			dist_max = dist;
+		}
+	}
+
+	{
+		const float dist_extend = (dist_max - dist_min) * eps;
+		dist_min -= dist_extend;
+		dist_max += dist_extend;
+	}
+
+	return ((dist_min > margin) || (dist_max < -margin));
+}
+
+struct LoopTriOverlapData {
+	struct BMLoop *(*looptris)[3];
+	const float (*looptri_nors)[3];
+	float eps;
+	float margin;
+};
+
+/**
+ * Cheap, conservative rejection of overlap pairs before they reach #bm_isect_tri_tri.
+ *
+ * Runs from the (threaded) BVH overlap, so only reads original geometry.
+ * Pairs which share a vertex or are separated by either triangle's plane can't intersect.
+ */
+static bool bm_isect_tri_tri_overlap_cb(void *userdata, int index_a, int index_b, int UNUSED(thread))
+{
+	const struct LoopTriOverlapData *data = userdata;
+	BMLoop **a = data->looptris[index_a];
+	BMLoop **b = data->looptris[index_b];
+	const BMVert *fv_a[3] = {UNPACK3_EX(, a, ->v)};
+	const BMVert *fv_b[3] = {UNPACK3_EX(, b, ->v)};
+	const float *f_a_cos[3] = {UNPACK3_EX(, fv_a, ->co)};
+	const float *f_b_cos[3] = {UNPACK3_EX(, fv_b, ->co)};
+
+	if (UNLIKELY(ELEM(fv_a[0], UNPACK3(fv_b)) ||
+	             ELEM(fv_a[1], UNPACK3(fv_b)) ||
+	             ELEM(fv_a[2], UNPACK3(fv_b))))
+	{
+		return false;
+	}
+
+	if (isect_tri_plane_is_separate(f_a_cos, f_b_cos[0], data->looptri_nors[index_b], data->eps, data->margin) ||
+	    isect_tri_plane_is_separate(f_b_cos, f_a_cos[0], data->looptri_nors[index_a], data->eps, data->margin))
+	{
+		return false;
+	}
+
+	return true;
+}
+
 struct RaycastData {
 	const float **looptris;
 	BLI_Buffer *z_buffer;
@@ -1015,7 +1118,8 @@ bool BM_mesh_intersect(
 	s.edgetri_cache = BLI_ghash_new(BLI_ghashutil_inthash_v4_p, BLI_ghashutil_inthash_v4_cmp, __func__);
 
 	s.edge_verts = BLI_ghash_ptr_new(__func__);
-	s.face_edges = BLI_ghash_int_new(__func__);
+	s.face_edges = MEM_callocN(sizeof(*s.face_edges) * (size_t)totface_orig, __func__);
+	s.face_edges_tot = 0;
 	s.wire_edges = BLI_gset_ptr_new(__func__);
 	s.vert_dissolve = NULL;
 
@@ -1114,7 +1218,30 @@ bool BM_mesh_intersect(
 		tree_b = tree_a;
 	}
 
-	overlap = BLI_bvhtree_overlap(tree_b, tree_a, &tree_overlap_tot, NULL, NULL);
+	{
+		/* filter out pairs which can't intersect while traversing the trees (multi-threaded),
+		 * leaving only the pairs which may need splitting for the (serial) loop below. */
+		float (*looptri_nors)[3] = MEM_mallocN(sizeof(*looptri_nors) * (size_t)looptris_tot, __func__);
+		struct LoopTriNormalData nor_data = {
+			.looptris = looptris,
+			.looptri_nors = looptri_nors,
+		};
+		struct LoopTriOverlapData overlap_data = {
+			.looptris = looptris,
+			.looptri_nors = (const float (*)[3])looptri_nors,
+			.eps = s.epsilon.eps,
+			/* double the largest distance used to detect intersections, avoids precision issues */
+			.margin = s.epsilon.eps_margin * 2.0f,
+		};
+
+		BLI_task_parallel_range(
+		        0, looptris_tot, &nor_data, looptri_normal_cb,
+		        looptris_tot >= BM_OMP_LIMIT);
+
+		overlap = BLI_bvhtree_overlap(tree_b, tree_a, &tree_overlap_tot, bm_isect_tri_tri_overlap_cb, &overlap_data);
+
+		MEM_freeN(looptri_nors);
+	}
 
 	if (overlap) {
 		unsigned int i;
@@ -1385,10 +1512,10 @@ bool BM_mesh_intersect(
 
 		/* Remove edges! */
 		{
-			GHashIterator gh_iter;
+			int f_index;
 
-			GHASH_ITER (gh_iter, s.face_edges) {
-				struct LinkBase *e_ls_base = BLI_ghashIterator_getValue(&gh_iter);
+			for (f_index = 0; f_index < totface_orig; f_index++) {
+				struct LinkBase *e_ls_base = &s.face_edges[f_index];
 				LinkNode **node_prev_p;
 				unsigned int i;
 
@@ -1480,19 +1607,20 @@ bool BM_mesh_intersect(
 	/* now split faces */
 #ifdef USE_NET
 	{
-		GHashIterator gh_iter;
 		BMFace **faces;
+		int f_index;
 
 		MemArena *mem_arena_edgenet = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
 
 		faces = bm->ftable;
 
-		GHASH_ITER (gh_iter, s.face_edges) {
-			const int f_index = GET_INT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
+		for (f_index = 0; f_index < totface_orig; f_index++) {
 			BMFace *f;
-			struct LinkBase *e_ls_base = BLI_ghashIterator_getValue(&gh_iter);
+			struct LinkBase *e_ls_base = &s.face_edges[f_index];
 
-			BLI_assert(f_index >= 0 && f_index < totface_orig);
+			if (e_ls_base->list_len == 0) {
+				continue;
+			}
 
 			f = faces[f_index];
 			if (UNLIKELY(f == NULL)) {
@@ -1690,13 +1818,13 @@ bool BM_mesh_intersect(
 		}
 	}
 
-	has_edit_isect = (BLI_ghash_size(s.face_edges) != 0);
+	has_edit_isect = (s.face_edges_tot != 0);
 
 	/* cleanup */
 	BLI_ghash_free(s.edgetri_cache, NULL, NULL);
 
 	BLI_ghash_free(s.edge_verts, NULL, NULL);
-	BLI_ghash_free(s.face_edges, NULL, NULL);
+	MEM_freeN(s.face_edges);
 	BLI_gset_free(s.wire_edges, NULL);
 
 	BLI_memarena_free(s.mem_arena);
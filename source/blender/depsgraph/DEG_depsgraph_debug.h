@@ -69,6 +69,16 @@ typedef struct DepsgraphStats {
 	struct GHash *id_stats;
 } DepsgraphStats;
 
+/* Wall-clock time of the stages of the last relations build, in seconds. */
+typedef struct DepsgraphStatsBuild {
+	double time_nodes;
+	double time_relations;
+	double time_cycles;
+	double time_transitive;
+	double time_finalize;
+	double time_total;
+} DepsgraphStatsBuild;
+
 struct DepsgraphStats *DEG_stats(void);
 
 void DEG_stats_verify(void);
@@ -82,6 +92,32 @@ void DEG_stats_simple(const struct Depsgraph *graph,
                       size_t *r_operations,
                       size_t *r_relations);
 
+void DEG_stats_build(const struct Depsgraph *graph,
+                     struct DepsgraphStatsBuild *r_stats);
+
+/* ************************************************ */
+/* Operation Profiling */
+
+/* Evaluation of operations is only profiled when G_DEBUG_DEPSGRAPH_PROFILE
+ * is set, the data is collected until cleared.
+ */
+
+/* Returns false if nothing was profiled or the file could not be written. */
+bool DEG_debug_profile_write_trace(const struct Depsgraph *graph,
+                                   const char *filepath);
+
+/* Prints per-ID totals, ordered from the most expensive one.
+ * Returns false if nothing was profiled.
+ */
+bool DEG_debug_profile_print_stats(const struct Depsgraph *graph, FILE *stream);
+
+void DEG_debug_profile_summary(const struct Depsgraph *graph,
+                               int *r_num_evaluations,
+                               double *r_time_eval,
+                               double *r_time_idle);
+
+void DEG_debug_profile_clear(struct Depsgraph *graph);
+
 /* ************************************************ */
 /* Diagram-Based Graph Debugging */
 
@@ -39,6 +39,7 @@ extern "C" {
 #include "intern/nodes/deg_node_operation.h"
 
 #include "intern/depsgraph.h"
+#include "intern/depsgraph_intern.h"
 
 #include "util/deg_util_foreach.h"
 
@@ -57,6 +58,11 @@ namespace DEG {
  *
  * Care has to be taken to make sure the algorithm can handle the cyclic case
  * too! (unless we can to prevent this case early on).
+ *
+ * To keep the cost per target proportional to the part of the graph which is
+ * upstream of it, only nodes which were actually visited get their tags
+ * cleared, and the traversal uses an explicit stack so deep chains (long bone
+ * hierarchies, driver chains) don't overflow the call stack.
  */
 
 enum {
@@ -64,27 +70,49 @@ enum {
 	OP_REACHABLE = 2,
 };
 
-static void deg_graph_tag_paths_recursive(DepsNode *node)
+typedef vector<DepsNode *> DepsNodeStack;
+
+static void deg_graph_tag_paths(DepsNode *from,
+                                DepsNodeStack *stack,
+                                DepsNodeStack *visited)
 {
-	if (node->done & OP_VISITED) {
-		return;
-	}
-	node->done |= OP_VISITED;
-	foreach (DepsRelation *rel, node->inlinks) {
-		deg_graph_tag_paths_recursive(rel->from);
-		/* Do this only in inlinks loop, so the target node does not get
-		 * flagged.
-		 */
-		rel->from->done |= OP_REACHABLE;
+	stack->push_back(from);
+	while (!stack->empty()) {
+		DepsNode *node = stack->back();
+		stack->pop_back();
+		if (node->done & OP_VISITED) {
+			continue;
+		}
+		node->done |= OP_VISITED;
+		visited->push_back(node);
+		foreach (DepsRelation *rel, node->inlinks) {
+			/* Do this only in inlinks loop, so the target node does not get
+			 * flagged.
+			 */
+			if ((rel->from->done & (OP_VISITED | OP_REACHABLE)) == 0) {
+				visited->push_back(rel->from);
+			}
+			rel->from->done |= OP_REACHABLE;
+			stack->push_back(rel->from);
+		}
 	}
 }
 
 void deg_graph_transitive_reduction(Depsgraph *graph)
 {
+	DepsNodeStack stack, visited;
+	size_t num_removed_relations = 0;
+
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+
 	foreach (OperationDepsNode *target, graph->operations) {
-		/* Clear tags. */
-		foreach (OperationDepsNode *node, graph->operations) {
-			node->done = 0;
+		/* With a single incoming relation there is nothing which could be
+		 * redundant.
+		 */
+		if (target->inlinks.size() < 2) {
+			continue;
 		}
 
 		/* mark nodes from which we can reach the target
@@ -92,8 +120,9 @@ void deg_graph_transitive_reduction(Depsgraph *graph)
 		 * flagged.
 		 */
 		target->done |= OP_VISITED;
+		visited.push_back(target);
 		foreach (DepsRelation *rel, target->inlinks) {
-			deg_graph_tag_paths_recursive(rel->from);
+			deg_graph_tag_paths(rel->from, &stack, &visited);
 		}
 
 		/* Remove redundant paths to the target. */
@@ -113,9 +142,18 @@ void deg_graph_transitive_reduction(Depsgraph *graph)
 			}
 			else if (rel->from->done & OP_REACHABLE) {
 				OBJECT_GUARDED_DELETE(rel, DepsRelation);
+				++num_removed_relations;
 			}
 		}
+
+		/* Clear tags of the nodes touched by this target only. */
+		foreach (DepsNode *node, visited) {
+			node->done = 0;
+		}
+		visited.clear();
 	}
+
+	DEG_DEBUG_PRINTF("Removed %d relations\n", (int)num_removed_relations);
 }
 
 }  // namespace DEG
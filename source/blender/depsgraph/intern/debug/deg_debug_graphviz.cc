@@ -139,6 +139,11 @@ struct DebugContext {
 	FILE *file;
 	bool show_tags;
 	bool show_eval_priority;
+	/* Color operations by measured evaluation time, relative to the slowest
+	 * one in the graph.
+	 */
+	bool show_eval_cost;
+	float max_eval_time;
 };
 
 static void deg_debug_fprintf(const DebugContext &ctx, const char *fmt, ...) ATTR_PRINTF_FORMAT(2, 3);
@@ -239,6 +244,15 @@ static void deg_debug_graphviz_node_fillcolor(const DebugContext &ctx,
                                               const DepsNode *node)
 {
 	const char *defaultcolor = "gainsboro";
+	if (ctx.show_eval_cost && node->tclass == DEPSNODE_CLASS_OPERATION) {
+		const OperationDepsNode *op_node = (const OperationDepsNode *)node;
+		if (op_node->eval_time > 0.0f) {
+			/* From green for cheap operations to red for the most expensive. */
+			const float factor = MIN2(op_node->eval_time / ctx.max_eval_time, 1.0f);
+			deg_debug_fprintf(ctx, "\"%.3f 0.700 1.000\"", (1.0f - factor) * 0.333f);
+			return;
+		}
+	}
 	int color_index = deg_debug_node_color_index(node);
 	const char *fillcolor = color_index < 0 ? defaultcolor : deg_debug_colors_light[color_index % deg_debug_max_colors];
 	deg_debug_fprintf(ctx, "\"%s\"", fillcolor);
@@ -299,7 +313,13 @@ static void deg_debug_graphviz_node_single(const DebugContext &ctx,
 	deg_debug_fprintf(ctx, "\"node_%p\"", node);
 	deg_debug_fprintf(ctx, "[");
 //	deg_debug_fprintf(ctx, "label=<<B>%s</B>>", name);
-	if (priority >= 0.0f) {
+	if (priority >= 0.0f && ctx.show_eval_cost) {
+		deg_debug_fprintf(ctx, "label=<%s<BR/>(<I>%.3f ms, critical path %.3f ms</I>)>",
+		                 name.c_str(),
+		                 ((OperationDepsNode *)node)->eval_time * 1e3f,
+		                 priority * 1e3f);
+	}
+	else if (priority >= 0.0f) {
 		deg_debug_fprintf(ctx, "label=<%s<BR/>(<I>%.2f</I>)>",
 		                 name.c_str(),
 		                 priority);
@@ -566,6 +586,14 @@ void DEG_debug_graphviz(const Depsgraph *graph, FILE *f, const char *label, bool
 	ctx.file = f;
 	ctx.show_tags = show_eval;
 	ctx.show_eval_priority = show_eval;
+	ctx.show_eval_cost = false;
+	ctx.max_eval_time = 0.0f;
+	if (show_eval) {
+		foreach (DEG::OperationDepsNode *op_node, deg_graph->operations) {
+			ctx.max_eval_time = MAX2(ctx.max_eval_time, op_node->eval_time);
+		}
+		ctx.show_eval_cost = (ctx.max_eval_time > 0.0f);
+	}
 
 	DEG::deg_debug_fprintf(ctx, "digraph depgraph {" NL);
 	DEG::deg_debug_fprintf(ctx, "rankdir=LR;" NL);
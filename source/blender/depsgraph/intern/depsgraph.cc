@@ -60,6 +60,7 @@ extern "C" {
 #include "intern/nodes/deg_node_operation.h"
 
 #include "intern/depsgraph_intern.h"
+#include "intern/eval/deg_eval_profile.h"
 #include "util/deg_util_foreach.h"
 
 namespace DEG {
@@ -71,8 +72,10 @@ static DEG_EditorUpdateScenePreCb deg_editor_update_scene_pre_cb = NULL;
 Depsgraph::Depsgraph()
   : root_node(NULL),
     need_update(false),
-    layers(0)
+    layers(0),
+    profile(NULL)
 {
+	memset(&build_times, 0, sizeof(build_times));
 	BLI_spin_init(&lock);
 	id_hash = BLI_ghash_ptr_new("Depsgraph id hash");
 	subgraphs = BLI_gset_ptr_new("Depsgraph subgraphs");
@@ -90,6 +93,9 @@ Depsgraph::~Depsgraph()
 	if (this->root_node != NULL) {
 		OBJECT_GUARDED_DELETE(this->root_node, RootDepsNode);
 	}
+	if (profile != NULL) {
+		OBJECT_GUARDED_DELETE(profile, DepsgraphProfile);
+	}
 	BLI_spin_end(&lock);
 }
 
@@ -55,6 +55,17 @@ struct IDDepsNode;
 struct SubgraphDepsNode;
 struct ComponentDepsNode;
 struct OperationDepsNode;
+struct DepsgraphProfile;
+
+/* Wall-clock time spent in the stages of the last relations build, in seconds. */
+struct DepsgraphBuildTimes {
+	double nodes;
+	double relations;
+	double cycles;
+	double transitive;
+	double finalize;
+	double total;
+};
 
 /* *************************** */
 /* Relationships Between Nodes */
@@ -177,6 +188,14 @@ struct Depsgraph {
 	/* Visible layers bitfield, used for skipping invisible objects updates. */
 	unsigned int layers;
 
+	/* Debug ............................. */
+
+	/* Timing of the last build, see DEG_stats_build(). */
+	DepsgraphBuildTimes build_times;
+
+	/* Operation timing, only allocated when profiling is enabled. */
+	DepsgraphProfile *profile;
+
 	// XXX: additional stuff like eval contexts, mempools for allocating nodes from, etc.
 };
 
@@ -32,7 +32,7 @@
 
 #include "MEM_guardedalloc.h"
 
-// #define DEBUG_TIME
+#include <cstring>
 
 extern "C" {
 #include "DNA_cachefile_types.h"
@@ -42,11 +42,9 @@ extern "C" {
 
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_trace.h"
 
-#ifdef DEBUG_TIME
-#  include "PIL_time.h"
-#  include "PIL_time_utildefines.h"
-#endif
+#include "PIL_time.h"
 
 #include "BKE_main.h"
 #include "BKE_collision.h"
@@ -197,13 +195,16 @@ void DEG_add_special_eval_flag(Depsgraph *graph, ID *id, short flag)
  */
 void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 {
-#ifdef DEBUG_TIME
-	TIMEIT_START(DEG_graph_build_from_scene);
-#endif
-
 	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	DEG::DepsgraphBuildTimes *times = &deg_graph->build_times;
+	const double time_start = PIL_check_seconds_timer();
+	double time_stage = time_start, time_now;
+
+	memset(times, 0, sizeof(*times));
+	BLI_trace_begin("DEG_graph_build_from_scene");
 
 	/* 1) Generate all the nodes in the graph first */
+	BLI_trace_begin("deg_build_nodes");
 	DEG::DepsgraphNodeBuilder node_builder(bmain, deg_graph);
 	/* create root node for scene first
 	 * - this way it should be the first in the graph,
@@ -212,10 +213,15 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	node_builder.begin_build(bmain);
 	node_builder.add_root_node();
 	node_builder.build_scene(bmain, scene);
+	BLI_trace_end("deg_build_nodes");
+	time_now = PIL_check_seconds_timer();
+	times->nodes = time_now - time_stage;
+	time_stage = time_now;
 
 	/* 2) Hook up relationships between operations - to determine evaluation
 	 *    order.
 	 */
+	BLI_trace_begin("deg_build_relations");
 	DEG::DepsgraphRelationBuilder relation_builder(deg_graph);
 	/* Hook scene up to the root node as entrypoint to graph. */
 	/* XXX what does this relation actually mean?
@@ -230,21 +236,40 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	                              "Root to Active Scene");
 #endif
 	relation_builder.build_scene(bmain, scene);
+	BLI_trace_end("deg_build_relations");
+	time_now = PIL_check_seconds_timer();
+	times->relations = time_now - time_stage;
+	time_stage = time_now;
 
 	/* Detect and solve cycles. */
+	BLI_trace_begin("deg_graph_detect_cycles");
 	DEG::deg_graph_detect_cycles(deg_graph);
+	BLI_trace_end("deg_graph_detect_cycles");
+	time_now = PIL_check_seconds_timer();
+	times->cycles = time_now - time_stage;
+	time_stage = time_now;
 
 	/* 3) Simplify the graph by removing redundant relations (to optimize
 	 *    traversal later). */
-	/* TODO: it would be useful to have an option to disable this in cases where
-	 *       it is causing trouble.
+	/* Only done for debugging (debug value 799), it's not part of regular
+	 * builds: its cost is not known to be won back during evaluation.
 	 */
 	if (G.debug_value == 799) {
+		BLI_trace_begin("deg_graph_transitive_reduction");
 		DEG::deg_graph_transitive_reduction(deg_graph);
+		BLI_trace_end("deg_graph_transitive_reduction");
+		time_now = PIL_check_seconds_timer();
+		times->transitive = time_now - time_stage;
+		time_stage = time_now;
 	}
 
 	/* 4) Flush visibility layer and re-schedule nodes for update. */
+	BLI_trace_begin("deg_graph_build_finalize");
 	DEG::deg_graph_build_finalize(deg_graph);
+	BLI_trace_end("deg_graph_build_finalize");
+	time_now = PIL_check_seconds_timer();
+	times->finalize = time_now - time_stage;
+	times->total = time_now - time_start;
 
 #if 0
 	if (!DEG_debug_consistency_check(deg_graph)) {
@@ -253,9 +278,14 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	}
 #endif
 
-#ifdef DEBUG_TIME
-	TIMEIT_END(DEG_graph_build_from_scene);
-#endif
+	BLI_trace_end("DEG_graph_build_from_scene");
+
+	DEG_DEBUG_PRINTF("Depsgraph built in %.6fs: nodes %.6fs, relations %.6fs, "
+	                 "cycles %.6fs, reduction %.6fs, finalize %.6fs "
+	                 "(%d operations)\n",
+	                 times->total, times->nodes, times->relations,
+	                 times->cycles, times->transitive, times->finalize,
+	                 (int)deg_graph->operations.size());
 }
 
 /* Tag graph relations for update. */
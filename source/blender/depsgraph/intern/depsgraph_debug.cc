@@ -42,6 +42,7 @@ extern "C" {
 }  /* extern "C" */
 
 #include "intern/eval/deg_eval_debug.h"
+#include "intern/eval/deg_eval_profile.h"
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
@@ -241,3 +242,63 @@ void DEG_stats_simple(const Depsgraph *graph, size_t *r_outer,
 		if (r_outer)     *r_outer     = tot_outer;
 	}
 }
+
+/**
+ * Obtain timing of the stages of the last relations build of the depsgraph.
+ * Only wall-clock time is measured, so the values are approximate.
+ */
+void DEG_stats_build(const Depsgraph *graph, DepsgraphStatsBuild *r_stats)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	const DEG::DepsgraphBuildTimes *times = &deg_graph->build_times;
+
+	r_stats->time_nodes = times->nodes;
+	r_stats->time_relations = times->relations;
+	r_stats->time_cycles = times->cycles;
+	r_stats->time_transitive = times->transitive;
+	r_stats->time_finalize = times->finalize;
+	r_stats->time_total = times->total;
+}
+
+/* ************************************************ */
+/* Operation Profiling */
+
+bool DEG_debug_profile_write_trace(const Depsgraph *graph, const char *filepath)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	if (deg_graph->profile == NULL) {
+		return false;
+	}
+	return deg_graph->profile->write_trace(filepath);
+}
+
+bool DEG_debug_profile_print_stats(const Depsgraph *graph, FILE *stream)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	if (deg_graph->profile == NULL || deg_graph->profile->num_evaluations == 0) {
+		return false;
+	}
+	deg_graph->profile->print_stats(stream);
+	return true;
+}
+
+void DEG_debug_profile_summary(const Depsgraph *graph,
+                               int *r_num_evaluations,
+                               double *r_time_eval,
+                               double *r_time_idle)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	const DEG::DepsgraphProfile *profile = deg_graph->profile;
+
+	*r_num_evaluations = (profile) ? profile->num_evaluations : 0;
+	*r_time_eval = (profile) ? profile->time_eval : 0.0;
+	*r_time_idle = (profile) ? profile->time_threads - profile->time_busy : 0.0;
+}
+
+void DEG_debug_profile_clear(Depsgraph *graph)
+{
+	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	if (deg_graph->profile != NULL) {
+		deg_graph->profile->clear();
+	}
+}
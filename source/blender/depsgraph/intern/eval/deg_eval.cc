@@ -34,6 +34,8 @@
 
 #include "PIL_time.h"
 
+#include <algorithm>
+
 extern "C" {
 #include "BLI_utildefines.h"
 #include "BLI_task.h"
@@ -49,6 +51,7 @@ extern "C" {
 
 #include "intern/eval/deg_eval_debug.h"
 #include "intern/eval/deg_eval_flush.h"
+#include "intern/eval/deg_eval_profile.h"
 #include "intern/nodes/deg_node.h"
 #include "intern/nodes/deg_node_component.h"
 #include "intern/nodes/deg_node_operation.h"
@@ -56,8 +59,10 @@ extern "C" {
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
-/* Unfinished and unused, and takes quite some pre-processing time. */
-#undef USE_EVAL_PRIORITY
+/* Schedule operations on the longest remaining chain first, using the
+ * evaluation time measured during previous updates as cost.
+ */
+#define USE_EVAL_PRIORITY
 
 /* Use integrated debugger to keep track how much each of the nodes was
  * evaluating.
@@ -66,6 +71,19 @@ extern "C" {
 
 namespace DEG {
 
+#ifdef USE_EVAL_PRIORITY
+/* Cost assumed for operations which were not timed yet, in seconds. */
+#  define EVAL_TIME_MIN 1e-6f
+/* Weight of the new measurement in the running average of evaluation time. */
+#  define EVAL_TIME_FACTOR 0.25f
+#endif
+
+/* Upper bound for the number of children which become ready after an
+ * operation is evaluated and are ordered by priority, further ones are
+ * pushed in the order they are found.
+ */
+#define MAX_READY_CHILDREN 64
+
 /* ********************** */
 /* Evaluation Entrypoints */
 
@@ -74,12 +92,15 @@ static void schedule_children(TaskPool *pool,
                               Depsgraph *graph,
                               OperationDepsNode *node,
                               const unsigned int layers,
-                              const int thread_id);
+                              const int thread_id,
+                              bool *use_local_queue);
 
 struct DepsgraphEvalState {
 	EvaluationContext *eval_ctx;
 	Depsgraph *graph;
 	unsigned int layers;
+	/* Non-NULL when operations are being profiled. */
+	DepsgraphProfile *profile;
 };
 
 static void deg_task_run_func(TaskPool *pool,
@@ -108,6 +129,7 @@ static void deg_task_run_func(TaskPool *pool,
 	 * but that's all fine, we'll just scheduler it's children.
 	 */
 	if (node->evaluate) {
+		const double time_start = PIL_check_seconds_timer();
 			/* Take note of current time. */
 #ifdef USE_DEBUGGER
 		double start_time = PIL_check_seconds_timer();
@@ -117,6 +139,23 @@ static void deg_task_run_func(TaskPool *pool,
 		/* Perform operation. */
 		node->evaluate(state->eval_ctx);
 
+		const double time_end = PIL_check_seconds_timer();
+
+		if (state->profile != NULL) {
+			state->profile->operation_evaluated(node, thread_id, time_start, time_end);
+		}
+
+#ifdef USE_EVAL_PRIORITY
+		/* Only one thread evaluates an operation, no need for atomics. */
+		const float time = (float)(time_end - time_start);
+		if (node->eval_time == 0.0f) {
+			node->eval_time = time;
+		}
+		else {
+			node->eval_time += (time - node->eval_time) * EVAL_TIME_FACTOR;
+		}
+#endif
+
 			/* Note how long this took. */
 #ifdef USE_DEBUGGER
 		double end_time = PIL_check_seconds_timer();
@@ -126,7 +165,9 @@ static void deg_task_run_func(TaskPool *pool,
 #endif
 	}
 
-	schedule_children(pool, state->graph, node, state->layers, thread_id);
+	/* The local queue is emptied before a task runs. */
+	bool use_local_queue = true;
+	schedule_children(pool, state->graph, node, state->layers, thread_id, &use_local_queue);
 }
 
 typedef struct CalculatePengindData {
@@ -180,39 +221,96 @@ static void calculate_pending_parents(Depsgraph *graph, unsigned int layers)
 }
 
 #ifdef USE_EVAL_PRIORITY
-static void calculate_eval_priority(OperationDepsNode *node)
+static bool eval_priority_is_active(const OperationDepsNode *node,
+                                    const unsigned int layers)
 {
-	if (node->done) {
-		return;
-	}
-	node->done = 1;
+	return (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0 &&
+	       (node->owner->owner->layers & layers) != 0;
+}
 
-	if (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
-		/* XXX standard cost of a node, could be estimated somewhat later on */
-		const float cost = 1.0f;
-		/* NOOP nodes have no cost */
-		node->eval_priority = node->is_noop() ? cost : 0.0f;
+/* Length of the critical path from each node: its own cost plus the most
+ * expensive chain of operations which depend on it.
+ *
+ * Nodes are visited in reverse topological order (children before their
+ * parents) without recursion, so long chains of a rig don't use up the stack.
+ * Cyclic relations are ignored, like for the pending parents.
+ */
+static void calculate_eval_priority(Depsgraph *graph,
+                                    const unsigned int layers)
+{
+	vector<OperationDepsNode *> stack;
 
+	/* Count children each node waits for, start from the ones without. */
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->eval_priority = 0.0f;
+		node->done = 0;
+		if (!eval_priority_is_active(node, layers)) {
+			continue;
+		}
 		foreach (DepsRelation *rel, node->outlinks) {
 			OperationDepsNode *to = (OperationDepsNode *)rel->to;
 			BLI_assert(to->type == DEPSNODE_TYPE_OPERATION);
-			calculate_eval_priority(to);
-			node->eval_priority += to->eval_priority;
+			if ((rel->flag & DEPSREL_FLAG_CYCLIC) == 0 &&
+			    eval_priority_is_active(to, layers))
+			{
+				node->done++;
+			}
+		}
+		if (node->done == 0) {
+			stack.push_back(node);
 		}
 	}
-	else {
-		node->eval_priority = 0.0f;
+
+	while (!stack.empty()) {
+		OperationDepsNode *node = stack.back();
+		stack.pop_back();
+
+		float children_priority = 0.0f;
+		foreach (DepsRelation *rel, node->outlinks) {
+			if ((rel->flag & DEPSREL_FLAG_CYCLIC) == 0) {
+				OperationDepsNode *to = (OperationDepsNode *)rel->to;
+				children_priority = MAX2(children_priority, to->eval_priority);
+			}
+		}
+
+		/* NOOP nodes have no cost */
+		node->eval_priority = children_priority;
+		if (!node->is_noop()) {
+			node->eval_priority += MAX2(node->eval_time, EVAL_TIME_MIN);
+		}
+
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (rel->from->type != DEPSNODE_TYPE_OPERATION ||
+			    (rel->flag & DEPSREL_FLAG_CYCLIC) != 0)
+			{
+				continue;
+			}
+			OperationDepsNode *from = (OperationDepsNode *)rel->from;
+			if (eval_priority_is_active(from, layers)) {
+				BLI_assert(from->done > 0);
+				if (--from->done == 0) {
+					stack.push_back(from);
+				}
+			}
+		}
 	}
 }
+
+static bool eval_priority_less(const OperationDepsNode *a,
+                               const OperationDepsNode *b)
+{
+	return a->eval_priority < b->eval_priority;
+}
 #endif
 
-/* Schedule a node if it needs evaluation.
+/* Check whether the node needs evaluation and all its parents are done.
+ * Returns true if the caller got the ownership of scheduling the node.
  *   dec_parents: Decrement pending parents count, true when child nodes are
  *                scheduled after a task has been completed.
  */
-static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
-                          OperationDepsNode *node, bool dec_parents,
-                          const int thread_id)
+static bool schedule_node_acquire(OperationDepsNode *node,
+                                  const unsigned int layers,
+                                  bool dec_parents)
 {
 	unsigned int id_layers = node->owner->owner->layers;
 
@@ -227,31 +325,103 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
 		if (node->num_links_pending == 0) {
 			bool is_scheduled = atomic_fetch_and_or_uint8(
 			        (uint8_t *)&node->scheduled, (uint8_t)true);
-			if (!is_scheduled) {
-				if (node->is_noop()) {
-					/* skip NOOP node, schedule children right away */
-					schedule_children(pool, graph, node, layers, thread_id);
-				}
-				else {
-					/* children are scheduled once this task is completed */
-					BLI_task_pool_push_from_thread(pool,
-					                               deg_task_run_func,
-					                               node,
-					                               false,
-					                               TASK_PRIORITY_HIGH,
-					                               thread_id);
+			return !is_scheduled;
+		}
+	}
+	return false;
+}
+
+/* Push a task for the node.
+ *
+ * use_local_queue tracks whether the thread's local queue (a single slot,
+ * emptied before a task runs) is still free: the first task pushed from a
+ * task goes there, all further ones (and all tasks pushed while the pool is
+ * suspended) go to the head of the global queue.
+ */
+static void schedule_push(TaskPool *pool,
+                          OperationDepsNode *node,
+                          const int thread_id,
+                          bool *use_local_queue)
+{
+	/* children are scheduled once this task is completed */
+	BLI_task_pool_push_from_thread(pool,
+	                               deg_task_run_func,
+	                               node,
+	                               false,
+	                               TASK_PRIORITY_HIGH,
+	                               thread_id);
+	*use_local_queue = false;
+}
+
+/* Push operations which became ready for evaluation.
+ *
+ * When the local queue is free the first pushed task goes there, so it is the
+ * operation to continue with on this thread: the most critical one of the
+ * same ID as the parent when possible, so data of the ID stays in the cache
+ * of this core. The others go to the head of the global queue, so they are
+ * pushed least critical first, leaving the most critical at the head where an
+ * idle thread picks it up first.
+ */
+static void schedule_ready_nodes(TaskPool *pool,
+                                 const OperationDepsNode *parent,
+                                 OperationDepsNode **ready,
+                                 int num_ready,
+                                 const int thread_id,
+                                 bool *use_local_queue)
+{
+	if (num_ready == 0) {
+		return;
+	}
+#ifdef USE_EVAL_PRIORITY
+	std::sort(ready, ready + num_ready, eval_priority_less);
+
+	int local_index = -1;
+	if (*use_local_queue) {
+		local_index = num_ready - 1;
+		if (parent != NULL) {
+			for (int i = num_ready - 1; i >= 0; --i) {
+				if (ready[i]->owner->owner == parent->owner->owner) {
+					local_index = i;
+					break;
 				}
 			}
 		}
+		schedule_push(pool, ready[local_index], thread_id, use_local_queue);
 	}
+
+	for (int i = 0; i < num_ready; ++i) {
+		if (i != local_index) {
+			schedule_push(pool, ready[i], thread_id, use_local_queue);
+		}
+	}
+#else
+	UNUSED_VARS(parent);
+	for (int i = 0; i < num_ready; ++i) {
+		schedule_push(pool, ready[i], thread_id, use_local_queue);
+	}
+#endif
 }
 
 static void schedule_graph(TaskPool *pool,
                            Depsgraph *graph,
                            const unsigned int layers)
 {
+	/* The pool is suspended, all tasks go to the global queue. */
+	bool use_local_queue = false;
+	vector<OperationDepsNode *> ready;
 	foreach (OperationDepsNode *node, graph->operations) {
-		schedule_node(pool, graph, layers, node, false, 0);
+		if (schedule_node_acquire(node, layers, false)) {
+			if (node->is_noop()) {
+				/* skip NOOP node, schedule children right away */
+				schedule_children(pool, graph, node, layers, 0, &use_local_queue);
+			}
+			else {
+				ready.push_back(node);
+			}
+		}
+	}
+	if (!ready.empty()) {
+		schedule_ready_nodes(pool, NULL, &ready[0], (int)ready.size(), 0, &use_local_queue);
 	}
 }
 
@@ -259,8 +429,12 @@ static void schedule_children(TaskPool *pool,
                               Depsgraph *graph,
                               OperationDepsNode *node,
                               const unsigned int layers,
-                              const int thread_id)
+                              const int thread_id,
+                              bool *use_local_queue)
 {
+	OperationDepsNode *ready[MAX_READY_CHILDREN];
+	int num_ready = 0;
+
 	foreach (DepsRelation *rel, node->outlinks) {
 		OperationDepsNode *child = (OperationDepsNode *)rel->to;
 		BLI_assert(child->type == DEPSNODE_TYPE_OPERATION);
@@ -268,13 +442,25 @@ static void schedule_children(TaskPool *pool,
 			/* Happens when having cyclic dependencies. */
 			continue;
 		}
-		schedule_node(pool,
-		              graph,
-		              layers,
-		              child,
-		              (rel->flag & DEPSREL_FLAG_CYCLIC) == 0,
-		              thread_id);
+		if (!schedule_node_acquire(child,
+		                           layers,
+		                           (rel->flag & DEPSREL_FLAG_CYCLIC) == 0))
+		{
+			continue;
+		}
+		if (child->is_noop()) {
+			/* skip NOOP node, schedule children right away */
+			schedule_children(pool, graph, child, layers, thread_id, use_local_queue);
+		}
+		else if (num_ready < MAX_READY_CHILDREN) {
+			ready[num_ready++] = child;
+		}
+		else {
+			schedule_push(pool, child, thread_id, use_local_queue);
+		}
 	}
+
+	schedule_ready_nodes(pool, node, ready, num_ready, thread_id, use_local_queue);
 }
 
 /**
@@ -301,6 +487,8 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 	                 layers,
 	                 graph->layers);
 
+	const double time_start = PIL_check_seconds_timer();
+
 	/* Set time for the current graph evaluation context. */
 	TimeSourceDepsNode *time_src = graph->find_time_source();
 	eval_ctx->ctime = time_src->cfra;
@@ -310,6 +498,7 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 	state.eval_ctx = eval_ctx;
 	state.graph = graph;
 	state.layers = layers;
+	state.profile = NULL;
 
 	TaskScheduler *task_scheduler;
 	bool need_free_scheduler;
@@ -327,18 +516,20 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 
 	calculate_pending_parents(graph, layers);
 
-	/* Clear tags. */
-	foreach (OperationDepsNode *node, graph->operations) {
-		node->done = 0;
-	}
-
 	/* Calculate priority for operation nodes. */
 #ifdef USE_EVAL_PRIORITY
-	foreach (OperationDepsNode *node, graph->operations) {
-		calculate_eval_priority(node);
-	}
+	calculate_eval_priority(graph, layers);
 #endif
 
+	if (G.debug & G_DEBUG_DEPSGRAPH_PROFILE) {
+		if (graph->profile == NULL) {
+			graph->profile = OBJECT_GUARDED_NEW(DepsgraphProfile);
+		}
+		state.profile = graph->profile;
+		state.profile->eval_begin(BLI_task_scheduler_num_threads(task_scheduler),
+		                          eval_ctx->ctime);
+	}
+
 	DepsgraphDebug::eval_begin(eval_ctx);
 
 	schedule_graph(task_pool, graph, layers);
@@ -348,12 +539,21 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 
 	DepsgraphDebug::eval_end(eval_ctx);
 
+	if (state.profile != NULL) {
+		state.profile->eval_end();
+	}
+
 	/* Clear any uncleared tags - just in case. */
 	deg_graph_clear_tags(graph);
 
 	if (need_free_scheduler) {
 		BLI_task_scheduler_free(task_scheduler);
 	}
+
+	DEG_DEBUG_PRINTF("%s: frame %.2f evaluated in %.6fs\n",
+	                 __func__,
+	                 eval_ctx->ctime,
+	                 PIL_check_seconds_timer() - time_start);
 }
 
 }  // namespace DEG
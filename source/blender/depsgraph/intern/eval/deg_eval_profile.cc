@@ -0,0 +1,203 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/eval/deg_eval_profile.cc
+ *  \ingroup depsgraph
+ *
+ * Opt-in profiler of operations evaluation.
+ */
+
+#include "intern/eval/deg_eval_profile.h"
+
+#include <algorithm>
+
+#include "PIL_time.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_string.h"
+#include "BLI_trace.h"
+}  /* extern "C" */
+
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_operation.h"
+
+#include "util/deg_util_foreach.h"
+
+namespace DEG {
+
+DepsgraphProfile::DepsgraphProfile()
+{
+	m_time_origin = PIL_check_seconds_timer();
+	m_time_eval_start = 0.0;
+	m_frame = 0.0f;
+	clear();
+}
+
+void DepsgraphProfile::clear()
+{
+	m_thread_events.clear();
+	m_events.clear();
+	m_evaluations.clear();
+	m_id_stats.clear();
+	num_evaluations = 0;
+	time_eval = 0.0;
+	time_busy = 0.0;
+	time_threads = 0.0;
+}
+
+void DepsgraphProfile::eval_begin(int num_threads, float frame)
+{
+	m_thread_events.resize(num_threads);
+	for (int i = 0; i < num_threads; ++i) {
+		m_thread_events[i].clear();
+	}
+	m_frame = frame;
+	m_time_eval_start = PIL_check_seconds_timer();
+}
+
+void DepsgraphProfile::operation_evaluated(const OperationDepsNode *node,
+                                           int thread_id,
+                                           double time_start,
+                                           double time_end)
+{
+	/* Each thread only touches its own array, no locking needed. */
+	if (thread_id < 0 || thread_id >= (int)m_thread_events.size()) {
+		return;
+	}
+	PendingEvent event = {node, time_start, time_end};
+	m_thread_events[thread_id].push_back(event);
+}
+
+void DepsgraphProfile::eval_end()
+{
+	const double time_end = PIL_check_seconds_timer();
+	const double time = time_end - m_time_eval_start;
+	int num_active_threads = 0;
+
+	Evaluation evaluation = {m_frame, m_time_eval_start, time_end};
+	m_evaluations.push_back(evaluation);
+
+	for (size_t thread_id = 0; thread_id < m_thread_events.size(); ++thread_id) {
+		const vector<PendingEvent> &pending = m_thread_events[thread_id];
+		if (pending.empty()) {
+			continue;
+		}
+		++num_active_threads;
+		foreach (const PendingEvent &pending_event, pending) {
+			const OperationDepsNode *node = pending_event.node;
+			const double duration = pending_event.time_end - pending_event.time_start;
+			Event event;
+			event.id_name = node->owner->owner->name;
+			event.name = node->full_identifier();
+			event.thread_id = (int)thread_id;
+			event.time_start = pending_event.time_start;
+			event.time_end = pending_event.time_end;
+			m_events.push_back(event);
+
+			IDStats &id_stats = m_id_stats[event.id_name];
+			id_stats.time += duration;
+			id_stats.num_operations++;
+
+			time_busy += duration;
+		}
+		m_thread_events[thread_id].clear();
+	}
+
+	num_evaluations++;
+	time_eval += time;
+	/* Idle time is only counted for threads which took part in evaluation,
+	 * the others could have been busy with other pools.
+	 */
+	time_threads += time * num_active_threads;
+}
+
+/* Writes events in the Chrome trace event format (see BLI_trace.h), which can
+ * be loaded into chrome://tracing. Times are relative to when profiling started.
+ */
+bool DepsgraphProfile::write_trace(const char *filepath) const
+{
+	/* Whole evaluations get their own track after the threads ones. */
+	const int eval_thread_id = (int)m_thread_events.size();
+
+	TraceWriter *tw = BLI_trace_writer_open(filepath);
+	if (tw == NULL) {
+		return false;
+	}
+
+	BLI_trace_writer_thread_name(tw, eval_thread_id, "Evaluation");
+	foreach (const Evaluation &evaluation, m_evaluations) {
+		char args[64];
+		BLI_snprintf(args, sizeof(args), "{\"frame\": %.2f}", evaluation.frame);
+		BLI_trace_writer_event(tw, "Evaluation", "depsgraph", 'X',
+		                       evaluation.time_start - m_time_origin,
+		                       evaluation.time_end - evaluation.time_start,
+		                       eval_thread_id,
+		                       args);
+	}
+	foreach (const Event &event, m_events) {
+		BLI_trace_writer_event(tw, event.name.c_str(), event.id_name.c_str(), 'X',
+		                       event.time_start - m_time_origin,
+		                       event.time_end - event.time_start,
+		                       event.thread_id,
+		                       NULL);
+	}
+
+	return BLI_trace_writer_close(tw);
+}
+
+static bool id_stats_time_greater(const std::pair<string, double> &a,
+                                  const std::pair<string, double> &b)
+{
+	return a.second > b.second;
+}
+
+void DepsgraphProfile::print_stats(FILE *stream) const
+{
+	vector<std::pair<string, double> > ids;
+	for (std::map<string, IDStats>::const_iterator it = m_id_stats.begin();
+	     it != m_id_stats.end();
+	     ++it)
+	{
+		ids.push_back(std::make_pair(it->first, it->second.time));
+	}
+	std::sort(ids.begin(), ids.end(), id_stats_time_greater);
+
+	fprintf(stream, "Depsgraph profile: %d evaluations, %.3f ms per evaluation\n",
+	        num_evaluations,
+	        num_evaluations ? time_eval * 1e3 / num_evaluations : 0.0);
+	if (time_threads > 0.0) {
+		fprintf(stream, "Threads busy %.1f%%, idle %.3f ms per evaluation\n",
+		        time_busy * 100.0 / time_threads,
+		        (time_threads - time_busy) * 1e3 / num_evaluations);
+	}
+	fprintf(stream, "%12s %14s %8s  %s\n", "Total (ms)", "Per eval (ms)", "Ops", "ID");
+	for (size_t i = 0; i < ids.size(); ++i) {
+		const IDStats &id_stats = m_id_stats.find(ids[i].first)->second;
+		fprintf(stream, "%12.3f %14.3f %8d  %s\n",
+		        id_stats.time * 1e3,
+		        id_stats.time * 1e3 / num_evaluations,
+		        id_stats.num_operations,
+		        ids[i].first.c_str());
+	}
+}
+
+}  // namespace DEG
@@ -0,0 +1,99 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/eval/deg_eval_profile.h
+ *  \ingroup depsgraph
+ *
+ * Opt-in profiler of operations evaluation, see G_DEBUG_DEPSGRAPH_PROFILE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <map>
+
+#include "intern/depsgraph_types.h"
+
+namespace DEG {
+
+struct OperationDepsNode;
+
+struct DepsgraphProfile {
+	DepsgraphProfile();
+
+	/* Called from the thread which runs the evaluation. */
+	void eval_begin(int num_threads, float frame);
+	void eval_end();
+
+	/* Called from the thread which evaluated the operation, thread_id is the
+	 * task scheduler's thread index.
+	 */
+	void operation_evaluated(const OperationDepsNode *node,
+	                         int thread_id,
+	                         double time_start,
+	                         double time_end);
+
+	void clear();
+
+	bool write_trace(const char *filepath) const;
+	void print_stats(FILE *stream) const;
+
+	/* Totals since the last clear(). */
+	int num_evaluations;
+	double time_eval;
+	double time_busy;
+	double time_threads;
+
+protected:
+	/* Recorded from evaluation threads, identifiers are resolved after the
+	 * evaluation is done to keep string formatting out of the measurement.
+	 */
+	struct PendingEvent {
+		const OperationDepsNode *node;
+		double time_start, time_end;
+	};
+
+	struct Event {
+		string id_name;
+		string name;
+		int thread_id;
+		double time_start, time_end;
+	};
+
+	struct Evaluation {
+		float frame;
+		double time_start, time_end;
+	};
+
+	struct IDStats {
+		double time;
+		int num_operations;
+	};
+
+	vector<vector<PendingEvent> > m_thread_events;
+	vector<Event> m_events;
+	vector<Evaluation> m_evaluations;
+	std::map<string, IDStats> m_id_stats;
+	double m_time_origin;
+	double m_time_eval_start;
+	float m_frame;
+};
+
+}  // namespace DEG
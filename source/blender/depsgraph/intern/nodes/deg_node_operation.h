@@ -81,7 +81,13 @@ struct OperationDepsNode : public DepsNode {
 
 	/* How many inlinks are we still waiting on before we can be evaluated. */
 	uint32_t num_links_pending;
+	/* Estimated time from the start of this operation until the end of the
+	 * longest chain of operations depending on it, used to schedule the
+	 * critical path first.
+	 */
 	float eval_priority;
+	/* Running average of the measured evaluation time, in seconds. */
+	float eval_time;
 	bool scheduled;
 
 	/* Stage of evaluation */
@@ -44,13 +44,13 @@
 
 #include "DEG_depsgraph_debug.h"
 
-static void rna_Depsgraph_debug_graphviz(Depsgraph *graph, const char *filename)
+static void rna_Depsgraph_debug_graphviz(Depsgraph *graph, const char *filename, int show_eval)
 {
 	FILE *f = fopen(filename, "w");
 	if (f == NULL)
 		return;
 	
-	DEG_debug_graphviz(graph, f, "Depsgraph", false);
+	DEG_debug_graphviz(graph, f, "Depsgraph", show_eval != 0);
 	
 	fclose(f);
 }
@@ -79,6 +79,34 @@ static void rna_Depsgraph_debug_stats(Depsgraph *graph, ReportList *reports)
 	            ops, rels, outer);
 }
 
+static void rna_Depsgraph_debug_profile_stats(Depsgraph *graph, ReportList *reports)
+{
+	int num_evaluations;
+	double time_eval, time_idle;
+
+	if (!DEG_debug_profile_print_stats(graph, stdout)) {
+		BKE_report(reports, RPT_WARNING,
+		           "Nothing profiled, enable profiling with bpy.app.debug_depsgraph_profile");
+		return;
+	}
+
+	DEG_debug_profile_summary(graph, &num_evaluations, &time_eval, &time_idle);
+	BKE_reportf(reports, RPT_INFO, "%d evaluations, %.3f ms per evaluation, threads idle %.3f ms per evaluation",
+	            num_evaluations, time_eval * 1e3 / num_evaluations, time_idle * 1e3 / num_evaluations);
+}
+
+static void rna_Depsgraph_debug_profile_trace(Depsgraph *graph, ReportList *reports, const char *filepath)
+{
+	if (!DEG_debug_profile_write_trace(graph, filepath)) {
+		BKE_reportf(reports, RPT_ERROR, "Could not write profile to '%s'", filepath);
+	}
+}
+
+static void rna_Depsgraph_debug_profile_clear(Depsgraph *graph)
+{
+	DEG_debug_profile_clear(graph);
+}
+
 #else
 
 static void rna_def_depsgraph(BlenderRNA *brna)
@@ -94,6 +122,8 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	parm = RNA_def_string_file_path(func, "filename", NULL, FILE_MAX, "File Name",
 	                                "File in which to store graphviz debug output");
 	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
+	RNA_def_boolean(func, "show_eval", 0, "Show Evaluation",
+	                "Show update tags, priorities and measured cost of operations");
 
 	func = RNA_def_function(srna, "debug_rebuild", "rna_Depsgraph_debug_rebuild");
 	RNA_def_function_flag(func, FUNC_USE_MAIN);
@@ -101,6 +131,20 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	func = RNA_def_function(srna, "debug_stats", "rna_Depsgraph_debug_stats");
 	RNA_def_function_ui_description(func, "Report the number of elements in the Dependency Graph");
 	RNA_def_function_flag(func, FUNC_USE_REPORTS);
+
+	func = RNA_def_function(srna, "debug_profile_stats", "rna_Depsgraph_debug_profile_stats");
+	RNA_def_function_ui_description(func, "Print time spent evaluating each ID while profiling was enabled");
+	RNA_def_function_flag(func, FUNC_USE_REPORTS);
+
+	func = RNA_def_function(srna, "debug_profile_trace", "rna_Depsgraph_debug_profile_trace");
+	RNA_def_function_ui_description(func, "Write profiled operations as Chrome trace events (chrome://tracing)");
+	RNA_def_function_flag(func, FUNC_USE_REPORTS);
+	parm = RNA_def_string_file_path(func, "filepath", NULL, FILE_MAX, "File Path",
+	                                "File in which to store the trace");
+	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
+
+	func = RNA_def_function(srna, "debug_profile_clear", "rna_Depsgraph_debug_profile_clear");
+	RNA_def_function_ui_description(func, "Discard profiled data");
 }
 
 void RNA_def_depsgraph(BlenderRNA *brna)
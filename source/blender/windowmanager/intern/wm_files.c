@@ -1048,6 +1048,18 @@ static ImBuf *blend_file_thumb(Scene *scene, bScreen *screen, BlendThumbnail **t
 }
 
 /* easy access from gdb */
+/**
+ * Wait for an asynchronous write (see #wm_file_write_async) to finish before writing again.
+ * It may be writing the same file, so it would share the temporary file,
+ * the final rename and the history (`.blend1`) rotation.
+ */
+static void wm_file_write_wait_async(wmWindowManager *wm)
+{
+	if (wm) {
+		WM_jobs_kill_type(wm, NULL, WM_JOB_TYPE_FILE_WRITE);
+	}
+}
+
 bool write_crash_blend(void)
 {
 	char path[FILE_MAX];
@@ -1055,6 +1067,10 @@ bool write_crash_blend(void)
 
 	BLI_strncpy(path, G.main->name, sizeof(path));
 	BLI_replace_extension(path, sizeof(path), "_crash.blend");
+	/* can't join the job from its own thread (when it crashed) */
+	if (BLI_thread_is_main()) {
+		wm_file_write_wait_async(G.main->wm.first);
+	}
 	if (BLO_write_file(G.main, path, fileflags, NULL, NULL)) {
 		printf("written: %s\n", path);
 		return 1;
@@ -1065,10 +1081,130 @@ bool write_crash_blend(void)
 	}
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Asynchronous File Writing
+ *
+ * The file is stored in memory (blocking), compression and disk access run in a job.
+ * \{ */
+
+typedef struct FileWriteJob {
+	BlendWriteAsync *wa;
+	/* written after the file (ownership is taken) */
+	ImBuf *ibuf_thumb;
+	bool is_autosave;
+	bool success;
+	/* reports from the thread, passed on when the job ends */
+	ReportList reports;
+} FileWriteJob;
+
+static void wm_file_write_job_startjob(void *customdata, short *UNUSED(stop), short *do_update, float *progress)
+{
+	FileWriteJob *fj = customdata;
+
+	/* stopping isn't supported, a partially written file is useless (jobs are stopped on exit) */
+	fj->success = BLO_write_file_async_write(fj->wa, &fj->reports);
+
+	*do_update = true;
+	*progress = 1.0f;
+}
+
+static void wm_file_write_job_endjob(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+	const char *filepath = BLO_write_file_async_filepath(fj->wa);
+	Report *report;
+
+	for (report = fj->reports.list.first; report; report = report->next) {
+		WM_report(report->type, report->message);
+	}
+
+	if (fj->success) {
+		if (fj->is_autosave) {
+			if (G.debug) {
+				printf("Auto-saved '%s'\n", filepath);
+			}
+		}
+		else {
+			BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+
+			/* run this function after because the file cant be written before the blend is */
+			if (fj->ibuf_thumb) {
+				IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
+				fj->ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, fj->ibuf_thumb);
+			}
+
+			WM_reportf(RPT_INFO, "Saved \"%s\"", BLI_path_basename(filepath));
+		}
+	}
+	else if (fj->is_autosave == false) {
+		/* the file was already considered saved when the job started */
+		wmWindowManager *wm = G.main->wm.first;
+		if (wm) {
+			wm->file_saved = 0;
+			WM_main_add_notifier(NC_WM | ND_DATACHANGED, NULL);
+		}
+	}
+}
+
+static void wm_file_write_job_free(void *customdata)
+{
+	FileWriteJob *fj = customdata;
+
+	BLO_write_file_async_free(fj->wa);
+	if (fj->ibuf_thumb) {
+		IMB_freeImBuf(fj->ibuf_thumb);
+	}
+	BKE_reports_clear(&fj->reports);
+	MEM_freeN(fj);
+}
+
+/**
+ * Store the file in memory and start a job writing it to \a filepath.
+ *
+ * \param ibuf_thumb: Thumbnail to write once the file is saved, owned by the job on success.
+ * \return Success of storing the file, write errors are reported when the job ends.
+ */
+static bool wm_file_write_async(
+        const bContext *C, const char *filepath, int fileflags, ReportList *reports,
+        const BlendThumbnail *thumb, ImBuf *ibuf_thumb, const bool is_autosave)
+{
+	wmWindowManager *wm = CTX_wm_manager(C);
+	BlendWriteAsync *wa;
+	FileWriteJob *fj;
+	wmJob *wm_job;
+
+	/* so files are always written in order */
+	wm_file_write_wait_async(wm);
+
+	wa = BLO_write_file_async_begin(CTX_data_main(C), filepath, fileflags, reports, thumb);
+	if (wa == NULL) {
+		return false;
+	}
+
+	fj = MEM_callocN(sizeof(*fj), __func__);
+	fj->wa = wa;
+	fj->ibuf_thumb = ibuf_thumb;
+	fj->is_autosave = is_autosave;
+	BKE_reports_init(&fj->reports, RPT_STORE);
+
+	wm_job = WM_jobs_get(wm, CTX_wm_window(C), wm, "Saving", WM_JOB_PROGRESS, WM_JOB_TYPE_FILE_WRITE);
+	WM_jobs_customdata_set(wm_job, fj, wm_file_write_job_free);
+	WM_jobs_timer(wm_job, 0.1, 0, 0);
+	WM_jobs_callbacks(wm_job, wm_file_write_job_startjob, NULL, NULL, wm_file_write_job_endjob);
+	WM_jobs_start(wm, wm_job);
+
+	return true;
+}
+
+/** \} */
+
 /**
  * \see #wm_homefile_write_exec wraps #BLO_write_file in a similar way.
+ *
+ * \param use_async: Write the file in a job (see #wm_file_write_async),
+ * the file has not been written yet when this returns.
  */
-static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports)
+static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports, bool use_async)
 {
 	Library *li;
 	int len;
@@ -1139,9 +1275,26 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 	/* XXX temp solution to solve bug, real fix coming (ton) */
 	G.main->recovered = 0;
 	
-	if (BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb)) {
+	/* jobs need an event loop to finish */
+	if (G.background || !BLI_thread_is_main()) {
+		use_async = false;
+	}
+
+	if (use_async == false) {
+		wm_file_write_wait_async(CTX_wm_manager(C));
+	}
+
+	if (use_async ?
+	    wm_file_write_async(C, filepath, fileflags, reports, thumb, ibuf_thumb, false) :
+	    BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb))
+	{
 		const bool do_history = (G.background == false) && (CTX_wm_manager(C)->op_undo_depth == 0);
 
+		if (use_async) {
+			/* owned by the job */
+			ibuf_thumb = NULL;
+		}
+
 		if (!(fileflags & G_FILE_SAVE_COPY)) {
 			G.relbase_valid = 1;
 			BLI_strncpy(G.main->name, filepath, sizeof(G.main->name));  /* is guaranteed current file */
@@ -1157,12 +1310,15 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 			wm_history_file_update();
 		}
 
-		BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+		/* the job does this once the file is written */
+		if (use_async == false) {
+			BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
 
-		/* run this function after because the file cant be written before the blend is */
-		if (ibuf_thumb) {
-			IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
-			ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, ibuf_thumb);
+			/* run this function after because the file cant be written before the blend is */
+			if (ibuf_thumb) {
+				IMB_thumb_delete(filepath, THB_FAIL); /* without this a failed thumb overrides */
+				ibuf_thumb = IMB_thumb_create(filepath, THB_LARGE, THB_SOURCE_BLEND, ibuf_thumb);
+			}
 		}
 
 		ret = 0;  /* Success. */
@@ -1250,6 +1406,8 @@ void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(w
 	wm_autosave_location(filepath);
 
 	if (U.uiflag & USER_GLOBALUNDO) {
+		wm_file_write_wait_async(wm);
+
 		/* fast save of last undobuffer, now with UI */
 		BKE_undo_save_file(filepath);
 	}
@@ -1260,7 +1418,14 @@ void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(w
 		ED_editors_flush_edits(C, false);
 
 		/* Error reporting into console */
-		BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
+		if (G.background) {
+			wm_file_write_wait_async(wm);
+			BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
+		}
+		else {
+			/* don't block the interface while writing */
+			wm_file_write_async(C, filepath, fileflags, NULL, NULL, NULL, true);
+		}
 	}
 	/* do timer after file write, just in case file write takes a long time */
 	wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, U.savetime * 60.0);
@@ -1384,6 +1549,8 @@ static int wm_homefile_write_exec(bContext *C, wmOperator *op)
 	/*  force save as regular blend file */
 	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
+	wm_file_write_wait_async(wm);
+
 	if (BLO_write_file(CTX_data_main(C), filepath, fileflags | G_FILE_USERPREFS, op->reports, NULL) == 0) {
 		printf("fail\n");
 		return OPERATOR_CANCELLED;
@@ -1989,11 +2156,23 @@ static void save_set_filepath(wmOperator *op)
 	}
 }
 
+/* interactive saving doesn't wait for the file to be written (scripts calling exec do) */
+static void save_set_async(wmOperator *op)
+{
+	PropertyRNA *prop;
+
+	prop = RNA_struct_find_property(op->ptr, "use_async");
+	if (!RNA_property_is_set(op->ptr, prop)) {
+		RNA_property_boolean_set(op->ptr, prop, true);
+	}
+}
+
 static int wm_save_as_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent *UNUSED(event))
 {
 
 	save_set_compress(op);
 	save_set_filepath(op);
+	save_set_async(op);
 
 	WM_event_add_fileselect(C, op);
 
@@ -2037,7 +2216,7 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 #  error "don't remove by accident"
 #endif
 
-	if (wm_file_write(C, path, fileflags, op->reports) != 0)
+	if (wm_file_write(C, path, fileflags, op->reports, RNA_boolean_get(op->ptr, "use_async")) != 0)
 		return OPERATOR_CANCELLED;
 
 	WM_event_add_notifier(C, NC_WM | ND_FILESAVE, NULL);
@@ -2082,6 +2261,9 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	prop = RNA_def_boolean(ot->srna, "copy", false, "Save Copy",
 	                "Save a copy of the actual working state but does not make saved file active");
 	RNA_def_property_flag(prop, PROP_SKIP_SAVE);
+	prop = RNA_def_boolean(ot->srna, "use_async", false, "Background Write",
+	                       "Write the file in the background, without waiting for it to finish");
+	RNA_def_property_flag(prop, PROP_HIDDEN | PROP_SKIP_SAVE);
 #ifdef USE_BMESH_SAVE_AS_COMPAT
 	RNA_def_boolean(ot->srna, "use_mesh_compat", false, "Legacy Mesh Format",
 	                "Save using legacy mesh format (no ngons) - WARNING: only saves tris and quads, other ngons will "
@@ -2099,6 +2281,7 @@ static int wm_save_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent *U
 
 	save_set_compress(op);
 	save_set_filepath(op);
+	save_set_async(op);
 
 	/* if we're saving for the first time and prefer relative paths - any existing paths will be absolute,
 	 * enable the option to remap paths to avoid confusion [#37240] */
@@ -2130,6 +2313,8 @@ static int wm_save_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent *U
 
 void WM_OT_save_mainfile(wmOperatorType *ot)
 {
+	PropertyRNA *prop;
+
 	ot->name = "Save Blender File";
 	ot->idname = "WM_OT_save_mainfile";
 	ot->description = "Save the current Blender file";
@@ -2145,6 +2330,9 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
 	RNA_def_boolean(ot->srna, "relative_remap", false, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
+	prop = RNA_def_boolean(ot->srna, "use_async", false, "Background Write",
+	                       "Write the file in the background, without waiting for it to finish");
+	RNA_def_property_flag(prop, PROP_HIDDEN | PROP_SKIP_SAVE);
 }
 
 /** \} */
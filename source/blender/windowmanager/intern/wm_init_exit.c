@@ -50,6 +50,7 @@
 #include "BLI_path_util.h"
 #include "BLI_string.h"
 #include "BLI_threads.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "BLO_writefile.h"
@@ -152,18 +153,23 @@ bool wm_start_with_console = false; /* used in creator.c */
 /* only called once, for startup */
 void WM_init(bContext *C, int argc, const char **argv)
 {
-	
+	BLI_trace_begin("WM_init");
+
 	if (!G.background) {
+		BLI_trace_begin("wm_ghost_init");
 		wm_ghost_init(C);   /* note: it assigns C to ghost! */
 		wm_init_cursor_data();
+		BLI_trace_end("wm_ghost_init");
 	}
 	GHOST_CreateSystemPaths();
 
 	BKE_addon_pref_type_init();
 
+	BLI_trace_begin("wm_operatortype_init");
 	wm_operatortype_init();
 	WM_menutype_init();
 	WM_uilisttype_init();
+	BLI_trace_end("wm_operatortype_init");
 
 	BKE_undo_callback_wm_kill_jobs_set(wm_undo_kill_callback);
 
@@ -176,13 +182,19 @@ void WM_init(bContext *C, int argc, const char **argv)
 	                      ED_render_scene_update,
 	                      ED_render_scene_update_pre); /* depsgraph.c */
 	
+	BLI_trace_begin("ED_spacetypes_init");
 	ED_spacetypes_init();   /* editors/space_api/spacetype.c */
+	BLI_trace_end("ED_spacetypes_init");
 	
+	BLI_trace_begin("ED_file_init");
 	ED_file_init();         /* for fsmenu */
+	BLI_trace_end("ED_file_init");
 	ED_node_init_butfuncs();
 	
+	BLI_trace_begin("BLF_init");
 	BLF_init(11, U.dpi); /* Please update source/gamengine/GamePlayer/GPG_ghost.cpp if you change this */
 	BLT_lang_init();
+	BLI_trace_end("BLF_init");
 
 	/* Enforce loading the UI for the initial homefile */
 	G.fileflags &= ~G_FILE_NO_UI;
@@ -192,7 +204,9 @@ void WM_init(bContext *C, int argc, const char **argv)
 	wm_init_reports(C);
 
 	/* get the default database, plus a wm */
+	BLI_trace_begin("wm_homefile_read");
 	wm_homefile_read(C, NULL, G.factory_startup, false, NULL, NULL);
+	BLI_trace_end("wm_homefile_read");
 	
 
 	BLT_lang_set(NULL);
@@ -204,7 +218,9 @@ void WM_init(bContext *C, int argc, const char **argv)
 		WM_ndof_deadzone_set(U.ndof_deadzone);
 #endif
 
+		BLI_trace_begin("GPU_init");
 		GPU_init();
+		BLI_trace_end("GPU_init");
 
 		GPU_set_mipmap(!(U.gameflags & USER_DISABLE_MIPMAP));
 		GPU_set_linear_mipmap(true);
@@ -215,7 +231,9 @@ void WM_init(bContext *C, int argc, const char **argv)
 		BKE_subsurf_osd_init();
 #endif
 
+		BLI_trace_begin("UI_init");
 		UI_init();
+		BLI_trace_end("UI_init");
 	}
 	else {
 		/* Note: Currently only inits icons, which we now want in background mode too
@@ -238,9 +256,14 @@ void WM_init(bContext *C, int argc, const char **argv)
 
 #ifdef WITH_PYTHON
 	BPY_context_set(C); /* necessary evil */
+	BLI_trace_begin("BPY_python_start");
 	BPY_python_start(argc, argv);
+	BLI_trace_end("BPY_python_start");
 
+	/* registers scripts & add-ons */
+	BLI_trace_begin("BPY_python_reset");
 	BPY_python_reset(C);
+	BLI_trace_end("BPY_python_reset");
 #else
 	(void)argc; /* unused */
 	(void)argv; /* unused */
@@ -254,7 +277,9 @@ void WM_init(bContext *C, int argc, const char **argv)
 
 	// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+	BLI_trace_begin("wm_history_file_read");
 	wm_history_file_read();
+	BLI_trace_end("wm_history_file_read");
 
 	/* allow a path of "", this is what happens when making a new file */
 #if 0
@@ -296,6 +321,8 @@ void WM_init(bContext *C, int argc, const char **argv)
 			CTX_wm_window_set(C, NULL);
 		}
 	}
+
+	BLI_trace_end("WM_init");
 }
 
 void WM_init_splash(bContext *C)
@@ -444,12 +471,18 @@ void WM_exit_ext(bContext *C, const bool do_python)
 {
 	wmWindowManager *wm = C ? CTX_wm_manager(C) : NULL;
 
+	/* exiting before the event loop started (background mode), write what was recorded */
+	BLI_trace_stop();
+
 	/* first wrap up running stuff, we assume only the active WM is running */
 	/* modal handlers are on window level freed, others too? */
 	/* note; same code copied in wm_files.c */
 	if (C && wm) {
 		wmWindow *win;
 
+		/* finish saving (in the background) before writing anything else */
+		WM_jobs_kill_type(wm, NULL, WM_JOB_TYPE_FILE_WRITE);
+
 		if (!G.background) {
 			if ((U.uiflag2 & USER_KEEP_SESSION) || BKE_undo_is_valid(NULL)) {
 				/* save the undo state as quit.blend */
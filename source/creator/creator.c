@@ -49,6 +49,7 @@
 #include "BLI_utildefines.h"
 #include "BLI_callbacks.h"
 #include "BLI_string.h"
+#include "BLI_trace.h"
 
 /* mostly init functions */
 #include "BKE_appdir.h"
@@ -266,7 +267,7 @@ int main(
 
 	/* NOTE: Special exception for guarded allocator type switch:
 	 *       we need to perform switch from lock-free to fully
-	 *       guarded allocator before any allocation happened.
+	 *       guarded (or profiling) allocator before any allocation happened.
 	 */
 	{
 		int i;
@@ -278,12 +279,37 @@ int main(
 				MEM_use_guarded_allocator();
 				break;
 			}
+			else if (STREQ(argv[i], "--debug-memory-profile")) {
+				printf("Switching to profiling memory allocator.\n");
+				MEM_use_profiling_allocator();
+				break;
+			}
+			else if (STREQ(argv[i], "--enable-slab-allocator")) {
+				printf("Switching to size-class memory allocator.\n");
+				MEM_use_slab_allocator();
+				break;
+			}
 			else if (STREQ(argv[i], "--")) {
 				break;
 			}
 		}
 	}
 
+	/* Start as early as possible (but after the allocator switch), to include all of the startup. */
+	{
+		int i;
+		for (i = 0; i + 1 < argc; i++) {
+			if (STREQ(argv[i], "--profile-startup")) {
+				BLI_trace_start(argv[i + 1]);
+				break;
+			}
+			else if (STREQ(argv[i], "--")) {
+				break;
+			}
+		}
+	}
+	BLI_trace_begin("startup");
+
 #ifdef BUILD_DATE
 	{
 		time_t temp_time = build_commit_timestamp;
@@ -351,6 +377,8 @@ int main(
 	/* initialize path to executable */
 	BKE_appdir_program_path_init(argv[0]);
 
+	BLI_trace_begin("init_subsystems");
+
 	BLI_threadapi_init();
 
 	DNA_sdna_current_init();
@@ -369,6 +397,8 @@ int main(
 
 	BLI_callback_global_init();
 
+	BLI_trace_end("init_subsystems");
+
 #ifdef WITH_GAMEENGINE
 	syshandle = SYS_GetSystem();
 #else
@@ -382,9 +412,11 @@ int main(
 	/* ensure we free on early exit */
 	app_init_data.ba = ba;
 
+	BLI_trace_begin("args_parse");
 	main_args_setup(C, ba, &syshandle);
 
 	BLI_argsParse(ba, 1, NULL, NULL);
+	BLI_trace_end("args_parse");
 
 	main_signal_setup();
 
@@ -398,11 +430,15 @@ int main(
 #endif
 
 	/* after level 1 args, this is so playanim skips RNA init */
+	BLI_trace_begin("RNA_init");
 	RNA_init();
+	BLI_trace_end("RNA_init");
 
+	BLI_trace_begin("init_types");
 	RE_engines_init();
 	init_nodesystem();
 	psys_init_rng();
+	BLI_trace_end("init_types");
 	/* end second init */
 
 
@@ -419,7 +455,9 @@ int main(
 
 	/* Initialize ffmpeg if built in, also needed for bg mode if videos are
 	 * rendered via ffmpeg */
+	BLI_trace_begin("BKE_sound_init_once");
 	BKE_sound_init_once();
+	BLI_trace_end("BKE_sound_init_once");
 	
 	init_def_material();
 
@@ -458,7 +496,9 @@ int main(
 #endif
 	
 	CTX_py_init_set(C, 1);
+	BLI_trace_begin("WM_keymap_init");
 	WM_keymap_init(C);
+	BLI_trace_end("WM_keymap_init");
 
 #ifdef WITH_FREESTYLE
 	/* initialize Freestyle */
@@ -468,7 +508,10 @@ int main(
 
 	/* OK we are ready for it */
 #ifndef WITH_PYTHON_MODULE
+	/* load files & run scripts passed as arguments (in background mode this may render and exit) */
+	BLI_trace_begin("args_handle_post");
 	main_args_setup_post(C, ba);
+	BLI_trace_end("args_handle_post");
 	
 	if (G.background == 0) {
 		if (!G.file_loaded)
@@ -501,6 +544,8 @@ int main(
 #endif
 
 	if (G.background) {
+		/* WM_exit() writes the trace and doesn't return. */
+		BLI_trace_end("startup");
 		/* Using window-manager API in background mode is a bit odd, but works fine. */
 		WM_exit(C);
 	}
@@ -524,6 +569,9 @@ int main(
 		}
 	}
 
+	BLI_trace_end("startup");
+	BLI_trace_stop();
+
 	WM_main(C);
 
 	return 0;
@@ -43,6 +43,7 @@
 #include "BLI_path_util.h"
 #include "BLI_fileops.h"
 #include "BLI_mempool.h"
+#include "BLI_trace.h"
 
 #include "BKE_blender_version.h"
 #include "BKE_context.h"
@@ -422,6 +423,14 @@ static void arg_py_context_restore(
 		arg_py_context_restore(C, &py_c); \
 	} ((void)0)
 
+/* Exit on a script error, without going through WM_exit(). */
+static void arg_py_exit_on_error(void)
+{
+	/* write what '--profile-startup' recorded, open stages are ended here */
+	BLI_trace_stop();
+	exit(app_state.exit_code_on_error.python);
+}
+
 #endif /* WITH_PYTHON */
 
 /** \} */
@@ -546,10 +555,13 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--debug-cycles");
 #endif
 	BLI_argsPrintArgDoc(ba, "--debug-memory");
+	BLI_argsPrintArgDoc(ba, "--debug-memory-profile");
+	BLI_argsPrintArgDoc(ba, "--profile-startup");
 	BLI_argsPrintArgDoc(ba, "--debug-jobs");
 	BLI_argsPrintArgDoc(ba, "--debug-python");
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph");
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-no-threads");
+	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-profile");
 
 	BLI_argsPrintArgDoc(ba, "--debug-gpumem");
 	BLI_argsPrintArgDoc(ba, "--debug-wm");
@@ -589,6 +601,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	printf("Experimental Features:\n");
 	BLI_argsPrintArgDoc(ba, "--enable-new-depsgraph");
 	BLI_argsPrintArgDoc(ba, "--enable-new-basic-shader-glsl");
+	BLI_argsPrintArgDoc(ba, "--enable-slab-allocator");
 
 	/* Other options _must_ be last (anything not handled will show here) */
 	printf("\n");
@@ -748,6 +761,8 @@ static const char arg_handle_debug_mode_generic_set_doc_depsgraph[] =
 "\n\tEnable debug messages from dependency graph";
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_threads[] =
 "\n\tSwitch dependency graph to a single threaded evaluation";
+static const char arg_handle_debug_mode_generic_set_doc_depsgraph_profile[] =
+"\n\tRecord timing of dependency graph operations (see Depsgraph.debug_profile_* in Python)";
 static const char arg_handle_debug_mode_generic_set_doc_gpumem[] =
 "\n\tEnable GPU memory stats in status bar";
 
@@ -811,6 +826,31 @@ static int arg_handle_debug_mode_memory_set(int UNUSED(argc), const char **UNUSE
 	return 0;
 }
 
+static const char arg_handle_debug_mode_memory_profile_set_doc[] =
+"\n\tCollect allocation statistics per allocation name, printed on exit"
+;
+static int arg_handle_debug_mode_memory_profile_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Allocator is switched in main(), before any allocation happened. */
+	return 0;
+}
+
+static const char arg_handle_profile_startup_set_doc[] =
+"<filepath>\n"
+"\tWrite a timeline of the startup stages to <filepath> (Chrome trace JSON, view with chrome://tracing)"
+;
+static int arg_handle_profile_startup_set(int argc, const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Recording is started in main(), before anything else happens. */
+	if (argc > 1) {
+		return 1;
+	}
+	else {
+		printf("\nError: you must specify a filepath after '--profile-startup'.\n");
+		return 0;
+	}
+}
+
 static const char arg_handle_debug_value_set_doc[] =
 "<value>\n"
 "\tSet debug value of <value> on startup\n"
@@ -1195,6 +1235,15 @@ static int arg_handle_depsgraph_use_new(int UNUSED(argc), const char **UNUSED(ar
 	return 0;
 }
 
+static const char arg_handle_slab_allocator_use_doc[] =
+"\n\tUse size-class memory allocator with per-thread caches for small allocations"
+;
+static int arg_handle_slab_allocator_use(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Allocator is switched in main(), before any allocation happened. */
+	return 0;
+}
+
 static const char arg_handle_basic_shader_glsl_use_new_doc[] =
 "\n\tUse new GLSL basic shader"
 ;
@@ -1550,7 +1599,7 @@ static int arg_handle_python_file_run(int argc, const char **argv, void *data)
 		BPY_CTX_SETUP(ok = BPY_execute_filepath(C, filename, NULL));
 		if (!ok && app_state.exit_code_on_error.python) {
 			printf("\nError: script failed, file: '%s', exiting.\n", argv[1]);
-			exit(app_state.exit_code_on_error.python);
+			arg_py_exit_on_error();
 		}
 		return 1;
 	}
@@ -1590,7 +1639,7 @@ static int arg_handle_python_text_run(int argc, const char **argv, void *data)
 
 		if (!ok && app_state.exit_code_on_error.python) {
 			printf("\nError: script failed, text: '%s', exiting.\n", argv[1]);
-			exit(app_state.exit_code_on_error.python);
+			arg_py_exit_on_error();
 		}
 
 		return 1;
@@ -1621,7 +1670,7 @@ static int arg_handle_python_expr_run(int argc, const char **argv, void *data)
 		BPY_CTX_SETUP(ok = BPY_execute_string_ex(C, argv[1], false));
 		if (!ok && app_state.exit_code_on_error.python) {
 			printf("\nError: script failed, expr: '%s', exiting.\n", argv[1]);
-			exit(app_state.exit_code_on_error.python);
+			arg_py_exit_on_error();
 		}
 		return 1;
 	}
@@ -1828,6 +1877,8 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	BLI_argsAdd(ba, 1, NULL, "--debug-cycles", CB(arg_handle_debug_mode_cycles), NULL);
 #endif
 	BLI_argsAdd(ba, 1, NULL, "--debug-memory", CB(arg_handle_debug_mode_memory_set), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--debug-memory-profile", CB(arg_handle_debug_mode_memory_profile_set), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--profile-startup", CB(arg_handle_profile_startup_set), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--debug-value",
 	            CB(arg_handle_debug_value_set), NULL);
@@ -1839,11 +1890,14 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph), (void *)G_DEBUG_DEPSGRAPH);
 	BLI_argsAdd(ba, 1, NULL, "--debug-depsgraph-no-threads",
 	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_no_threads), (void *)G_DEBUG_DEPSGRAPH_NO_THREADS);
+	BLI_argsAdd(ba, 1, NULL, "--debug-depsgraph-profile",
+	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_profile), (void *)G_DEBUG_DEPSGRAPH_PROFILE);
 	BLI_argsAdd(ba, 1, NULL, "--debug-gpumem",
 	            CB_EX(arg_handle_debug_mode_generic_set, gpumem), (void *)G_DEBUG_GPU_MEM);
 
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-depsgraph", CB(arg_handle_depsgraph_use_new), NULL);
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-basic-shader-glsl", CB(arg_handle_basic_shader_glsl_use_new), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--enable-slab-allocator", CB(arg_handle_slab_allocator_use), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 
@@ -0,0 +1,154 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+#include "DNA_meshdata_types.h"
+#include "BKE_mesh.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* 1118 x 1118 quads, a bit over 5M loops. */
+#define GRID_SIZE 1118
+
+typedef struct GridMesh {
+	MVert *mverts;
+	MEdge *medges;
+	MLoop *mloops;
+	MPoly *mpolys;
+	float (*polynors)[3];
+	int verts_num, edges_num, loops_num, polys_num;
+} GridMesh;
+
+/* Wavy grid so that the split angle actually splits some edges, with some edges tagged sharp too. */
+static void grid_mesh_create(GridMesh *grid, const int size)
+{
+	const int row = size + 1;
+
+	grid->verts_num = row * row;
+	grid->edges_num = 2 * size * row;
+	grid->polys_num = size * size;
+	grid->loops_num = grid->polys_num * 4;
+
+	grid->mverts = (MVert *)MEM_callocN(sizeof(*grid->mverts) * grid->verts_num, __func__);
+	grid->medges = (MEdge *)MEM_callocN(sizeof(*grid->medges) * grid->edges_num, __func__);
+	grid->mloops = (MLoop *)MEM_callocN(sizeof(*grid->mloops) * grid->loops_num, __func__);
+	grid->mpolys = (MPoly *)MEM_callocN(sizeof(*grid->mpolys) * grid->polys_num, __func__);
+	grid->polynors = (float (*)[3])MEM_mallocN(sizeof(*grid->polynors) * grid->polys_num, __func__);
+
+	for (int y = 0; y < row; y++) {
+		for (int x = 0; x < row; x++) {
+			float *co = grid->mverts[y * row + x].co;
+			co[0] = (float)x;
+			co[1] = (float)y;
+			co[2] = ((x / 4 + y / 4) % 2) ? 0.8f * sinf((float)x) : 0.0f;
+		}
+	}
+
+	/* Horizontal edges first, then vertical ones. */
+	int e = 0;
+	for (int y = 0; y < row; y++) {
+		for (int x = 0; x < size; x++, e++) {
+			grid->medges[e].v1 = (unsigned int)(y * row + x);
+			grid->medges[e].v2 = (unsigned int)(y * row + x + 1);
+		}
+	}
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < row; x++, e++) {
+			grid->medges[e].v1 = (unsigned int)(y * row + x);
+			grid->medges[e].v2 = (unsigned int)((y + 1) * row + x);
+		}
+	}
+	for (e = 0; e < grid->edges_num; e += 7) {
+		grid->medges[e].flag |= ME_SHARP;
+	}
+
+	const int edges_vert_offset = row * size;
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			const int p = y * size + x;
+			MPoly *mp = &grid->mpolys[p];
+			MLoop *ml = &grid->mloops[p * 4];
+
+			mp->loopstart = p * 4;
+			mp->totloop = 4;
+			mp->flag = (p % 97) ? ME_SMOOTH : 0;
+
+			ml[0].v = (unsigned int)(y * row + x);
+			ml[0].e = (unsigned int)(y * size + x);
+			ml[1].v = (unsigned int)(y * row + x + 1);
+			ml[1].e = (unsigned int)(edges_vert_offset + y * row + x + 1);
+			ml[2].v = (unsigned int)((y + 1) * row + x + 1);
+			ml[2].e = (unsigned int)((y + 1) * size + x);
+			ml[3].v = (unsigned int)((y + 1) * row + x);
+			ml[3].e = (unsigned int)(edges_vert_offset + y * row + x);
+		}
+	}
+
+	BKE_mesh_calc_normals_poly(
+	        grid->mverts, NULL, grid->verts_num, grid->mloops, grid->mpolys,
+	        grid->loops_num, grid->polys_num, grid->polynors, false);
+}
+
+static void grid_mesh_free(GridMesh *grid)
+{
+	MEM_freeN(grid->mverts);
+	MEM_freeN(grid->medges);
+	MEM_freeN(grid->mloops);
+	MEM_freeN(grid->mpolys);
+	MEM_freeN(grid->polynors);
+}
+
+static void grid_mesh_loop_split(GridMesh *grid, float (*r_loopnors)[3], MLoopNorSpaceArray *r_lnors_spacearr)
+{
+	BKE_mesh_normals_loop_split(
+	        grid->mverts, grid->verts_num, grid->medges, grid->edges_num,
+	        grid->mloops, r_loopnors, grid->loops_num,
+	        grid->mpolys, (const float (*)[3])grid->polynors, grid->polys_num,
+	        true, DEG2RADF(30.0f), r_lnors_spacearr, NULL, NULL);
+}
+
+TEST(mesh_normals, LoopSplit5MLoops)
+{
+	GridMesh grid;
+	grid_mesh_create(&grid, GRID_SIZE);
+
+	float (*loopnors)[3] = (float (*)[3])MEM_mallocN(sizeof(*loopnors) * grid.loops_num, __func__);
+	float (*loopnors_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*loopnors_ref) * grid.loops_num, __func__);
+
+	printf("\n========== STARTING %d loops ==========\n", grid.loops_num);
+
+	{
+		TIMEIT_START(loop_split_parallel);
+		grid_mesh_loop_split(&grid, loopnors, NULL);
+		TIMEIT_END(loop_split_parallel);
+	}
+
+	/* Building lnor spaces uses the serial fan generator, gives the reference result. */
+	{
+		MLoopNorSpaceArray lnors_spacearr = {NULL};
+
+		TIMEIT_START(loop_split_lnor_spaces);
+		grid_mesh_loop_split(&grid, loopnors_ref, &lnors_spacearr);
+		TIMEIT_END(loop_split_lnor_spaces);
+
+		BKE_lnor_spacearr_free(&lnors_spacearr);
+	}
+
+	int mismatch_num = 0;
+	for (int i = 0; i < grid.loops_num; i++) {
+		if (!compare_v3v3(loopnors[i], loopnors_ref[i], 1e-6f)) {
+			mismatch_num++;
+		}
+	}
+	EXPECT_EQ(0, mismatch_num);
+
+	printf("========== ENDED ==========\n\n");
+
+	MEM_freeN(loopnors);
+	MEM_freeN(loopnors_ref);
+	grid_mesh_free(&grid);
+}
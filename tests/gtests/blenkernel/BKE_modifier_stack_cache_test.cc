@@ -0,0 +1,71 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "BKE_cdderivedmesh.h"
+#include "BKE_DerivedMesh.h"
+#include "BKE_modifier.h"
+}
+
+TEST(modifier_stack_cache, StoreLookup)
+{
+	ModifierData md = {NULL};
+	DerivedMesh *dm = CDDM_new(4, 0, 0, 0, 0);
+	DerivedMesh *dm_cached;
+
+	/* The first time a key is seen it's only remembered. */
+	DM_stack_cache_store(&md, 1, dm);
+	EXPECT_EQ(NULL, DM_stack_cache_lookup(&md, 1));
+
+	/* The second time the result is stored. */
+	DM_stack_cache_store(&md, 1, dm);
+	dm_cached = DM_stack_cache_lookup(&md, 1);
+	ASSERT_TRUE(dm_cached != NULL);
+	EXPECT_NE(dm, dm_cached);
+	EXPECT_EQ(4, dm_cached->getNumVerts(dm_cached));
+	dm_cached->release(dm_cached);
+
+	/* Another key misses, and storing it invalidates the previous result. */
+	EXPECT_EQ(NULL, DM_stack_cache_lookup(&md, 2));
+	DM_stack_cache_store(&md, 2, dm);
+	EXPECT_EQ(NULL, DM_stack_cache_lookup(&md, 1));
+	EXPECT_EQ(NULL, DM_stack_cache_lookup(&md, 2));
+
+	DM_stack_cache_store(&md, 2, dm);
+	dm_cached = DM_stack_cache_lookup(&md, 2);
+	ASSERT_TRUE(dm_cached != NULL);
+	dm_cached->release(dm_cached);
+
+	/* Freeing the modifier drops its entry. */
+	DM_stack_cache_free_modifier(&md);
+	EXPECT_EQ(NULL, DM_stack_cache_lookup(&md, 2));
+
+	dm->release(dm);
+	DM_stack_cache_free_all();
+}
+
+TEST(modifier_stack_cache, Cacheable)
+{
+	Object ob = {{NULL}};
+	ModifierData *md;
+
+	BKE_modifier_init();
+
+	md = modifier_new(eModifierType_Subsurf);
+	EXPECT_TRUE(DM_stack_cache_modifier_is_cacheable(&ob, md));
+	modifier_free(md);
+
+	/* Binding only changes state which isn't part of the key. */
+	md = modifier_new(eModifierType_CorrectiveSmooth);
+	EXPECT_FALSE(DM_stack_cache_modifier_is_cacheable(&ob, md));
+	modifier_free(md);
+
+	md = modifier_new(eModifierType_LaplacianDeform);
+	EXPECT_FALSE(DM_stack_cache_modifier_is_cacheable(&ob, md));
+	modifier_free(md);
+}
@@ -0,0 +1,162 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests (10M triangles, needs a few GB of memory)! */
+//#define BVH_RUN_BIG
+
+#define RAYCAST_NUM 100000
+
+/* A grid of triangles displaced by noise, so the tree isn't perfectly regular. */
+static float (*grid_tris_new(const int tris_len, const int random_seed))[3][3]
+{
+	const int quads_x = (int)ceilf(sqrtf((float)tris_len / 2.0f));
+	const float step = 1.0f / (float)quads_x;
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*tris)[3][3] = (float (*)[3][3])MEM_mallocN(sizeof(*tris) * (size_t)tris_len, __func__);
+
+	for (int i = 0; i < tris_len; i++) {
+		const int quad = i / 2;
+		const float x = (float)(quad % quads_x) * step;
+		const float y = (float)(quad / quads_x) * step;
+		const float z = BLI_rng_get_float(rng) * step;
+		if (i % 2 == 0) {
+			ARRAY_SET_ITEMS(tris[i][0], x, y, z);
+			ARRAY_SET_ITEMS(tris[i][1], x + step, y, z);
+			ARRAY_SET_ITEMS(tris[i][2], x + step, y + step, z);
+		}
+		else {
+			ARRAY_SET_ITEMS(tris[i][0], x, y, z);
+			ARRAY_SET_ITEMS(tris[i][1], x + step, y + step, z);
+			ARRAY_SET_ITEMS(tris[i][2], x, y + step, z);
+		}
+	}
+
+	BLI_rng_free(rng);
+	return tris;
+}
+
+static void raycast_tris_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+	const float (*tris)[3][3] = (const float (*)[3][3])userdata;
+	float dist;
+	if (isect_ray_tri_v3(ray->origin, ray->direction, tris[index][0], tris[index][1], tris[index][2], &dist, NULL) &&
+	    (dist < hit->dist))
+	{
+		hit->index = index;
+		hit->dist = dist;
+	}
+}
+
+static void bvh_build_test(const int tris_len, const char tree_type, const char axis, const int flag)
+{
+	printf("\n========== STARTING %d triangles (tree_type: %d, axis: %d, sah: %d) ==========\n",
+	       tris_len, tree_type, axis, (flag & BVH_BALANCE_SAH) != 0);
+
+	float (*tris)[3][3] = grid_tris_new(tris_len, 1234);
+	BVHTree *tree = BLI_bvhtree_new(tris_len, 0.0f, tree_type, axis);
+
+	{
+		TIMEIT_START(bvh_insert);
+		for (int i = 0; i < tris_len; i++) {
+			BLI_bvhtree_insert(tree, i, tris[i][0], 3);
+		}
+		TIMEIT_END(bvh_insert);
+	}
+
+	{
+		TIMEIT_START(bvh_balance);
+		BLI_bvhtree_balance_ex(tree, flag);
+		TIMEIT_END(bvh_balance);
+	}
+
+	{
+		TIMEIT_START(bvh_update);
+		for (int i = 0; i < tris_len; i++) {
+			BLI_bvhtree_update_node(tree, i, tris[i][0], NULL, 3);
+		}
+		BLI_bvhtree_update_tree(tree);
+		TIMEIT_END(bvh_update);
+	}
+
+	{
+		struct RNG *rng = BLI_rng_new(4321);
+		const float dir[3] = {0.0f, 0.0f, -1.0f};
+		int hits = 0;
+
+		TIMEIT_START(bvh_raycast);
+		for (int i = 0; i < RAYCAST_NUM; i++) {
+			const float co[3] = {BLI_rng_get_float(rng), BLI_rng_get_float(rng), 2.0f};
+			BVHTreeRayHit hit;
+			hit.index = -1;
+			hit.dist = BVH_RAYCAST_DIST_MAX;
+			if (BLI_bvhtree_ray_cast(tree, co, dir, 0.0f, &hit, raycast_tris_cb, tris) != -1) {
+				hits++;
+			}
+		}
+		TIMEIT_END(bvh_raycast);
+
+		/* rays are cast inside the grid bounds */
+		EXPECT_GT(hits, 0);
+		BLI_rng_free(rng);
+	}
+
+	{
+		struct RNG *rng = BLI_rng_new(4321);
+		float (*ray_co)[3] = (float (*)[3])MEM_mallocN(sizeof(*ray_co) * RAYCAST_NUM, __func__);
+		float (*ray_dir)[3] = (float (*)[3])MEM_mallocN(sizeof(*ray_dir) * RAYCAST_NUM, __func__);
+		BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * RAYCAST_NUM, __func__);
+		int hits_num = 0;
+
+		for (int i = 0; i < RAYCAST_NUM; i++) {
+			/* rays in scan-line order, so consecutive rays are coherent */
+			const float x = (float)(i % 256) / 256.0f, y = (float)(i / 256) / (float)(RAYCAST_NUM / 256);
+			ARRAY_SET_ITEMS(ray_co[i], x + BLI_rng_get_float(rng) * 0.001f, y, 2.0f);
+			ARRAY_SET_ITEMS(ray_dir[i], 0.0f, 0.0f, -1.0f);
+			hits[i].index = -1;
+			hits[i].dist = BVH_RAYCAST_DIST_MAX;
+		}
+
+		TIMEIT_START(bvh_raycast_batch);
+		BLI_bvhtree_ray_cast_batch(tree, ray_co, ray_dir, RAYCAST_NUM, 0.0f, hits, raycast_tris_cb, tris, 0);
+		TIMEIT_END(bvh_raycast_batch);
+
+		for (int i = 0; i < RAYCAST_NUM; i++) {
+			hits_num += (hits[i].index != -1);
+		}
+		EXPECT_GT(hits_num, 0);
+
+		BLI_rng_free(rng);
+		MEM_freeN(ray_co);
+		MEM_freeN(ray_dir);
+		MEM_freeN(hits);
+	}
+
+	BLI_bvhtree_free(tree);
+	MEM_freeN(tris);
+
+	printf("========== ENDED ==========\n\n");
+}
+
+TEST(kdopbvh, Build100000_Median_4_6)  { bvh_build_test(100000, 4, 6, 0); }
+TEST(kdopbvh, Build100000_Median_2_6)  { bvh_build_test(100000, 2, 6, 0); }
+TEST(kdopbvh, Build100000_SAH_2_6)     { bvh_build_test(100000, 2, 6, BVH_BALANCE_SAH); }
+
+TEST(kdopbvh, Build1000000_Median_4_6) { bvh_build_test(1000000, 4, 6, 0); }
+TEST(kdopbvh, Build1000000_Median_2_6) { bvh_build_test(1000000, 2, 6, 0); }
+TEST(kdopbvh, Build1000000_SAH_2_6)    { bvh_build_test(1000000, 2, 6, BVH_BALANCE_SAH); }
+
+#ifdef BVH_RUN_BIG
+TEST(kdopbvh, Build10000000_Median_4_6) { bvh_build_test(10000000, 4, 6, 0); }
+TEST(kdopbvh, Build10000000_Median_2_6) { bvh_build_test(10000000, 2, 6, 0); }
+TEST(kdopbvh, Build10000000_SAH_2_6)    { bvh_build_test(10000000, 2, 6, BVH_BALANCE_SAH); }
+#endif
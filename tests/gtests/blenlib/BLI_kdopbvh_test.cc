@@ -0,0 +1,272 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+/* TODO: ray intersection, overlap ... etc.*/
+
+extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "MEM_guardedalloc.h"
+}
+
+/* large enough to use the threaded code-paths */
+#define POINTS_NUM 10000
+#define QUERY_NUM 1000
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static void rng_v3_round(
+        float *coords, int coords_len,
+        struct RNG *rng, int round, float scale)
+{
+	for (int i = 0; i < coords_len; i++) {
+		float f = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		coords[i] = ((float)((int)(f * round)) / (float)round) * scale;
+	}
+}
+
+static BVHTree *points_bvhtree_new(
+        const float (*points)[3], int points_len,
+        char tree_type, char axis, int flag)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, tree_type, axis);
+	for (int i = 0; i < points_len; i++) {
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance_ex(tree, flag);
+	return tree;
+}
+
+static float points_nearest_dist_sq_brute_force(
+        const float (*points)[3], int points_len, const float co[3])
+{
+	float dist_sq_best = FLT_MAX;
+	for (int i = 0; i < points_len; i++) {
+		dist_sq_best = min_ff(dist_sq_best, len_squared_v3v3(points[i], co));
+	}
+	return dist_sq_best;
+}
+
+/* Callback to use the exact point position (without the bounding volume epsilon). */
+static void points_nearest_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+	const float (*points)[3] = (const float (*)[3])userdata;
+	const float dist_sq = len_squared_v3v3(points[index], co);
+	if (dist_sq < nearest->dist_sq) {
+		nearest->index = index;
+		nearest->dist_sq = dist_sq;
+		copy_v3_v3(nearest->co, points[index]);
+	}
+}
+
+static void find_nearest_points_test(
+        int points_len, float scale, int round, int random_seed,
+        char tree_type, char axis, int flag)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+
+	BVHTree *tree = points_bvhtree_new(points, points_len, tree_type, axis, flag);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		float co[3];
+		rng_v3_round(co, 3, rng, round, scale * 1.5f);
+
+		BVHTreeNearest nearest = {-1};
+		nearest.dist_sq = FLT_MAX;
+		EXPECT_NE(-1, BLI_bvhtree_find_nearest(tree, co, &nearest, points_nearest_cb, points));
+		EXPECT_EQ(points_nearest_dist_sq_brute_force(points, points_len, co), nearest.dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+}
+
+/* Move all points, refit the tree and check queries still find the nearest point. */
+static void update_tree_points_test(
+        int points_len, float scale, int round, int random_seed,
+        char tree_type, char axis, int flag)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+
+	BVHTree *tree = points_bvhtree_new(points, points_len, tree_type, axis, flag);
+
+	for (int i = 0; i < points_len; i++) {
+		float offset[3];
+		rng_v3_round(offset, 3, rng, round, scale * 0.1f);
+		add_v3_v3(points[i], offset);
+		EXPECT_TRUE(BLI_bvhtree_update_node(tree, i, points[i], NULL, 1));
+	}
+	BLI_bvhtree_update_tree(tree);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		float co[3];
+		rng_v3_round(co, 3, rng, round, scale * 1.5f);
+
+		BVHTreeNearest nearest = {-1};
+		nearest.dist_sq = FLT_MAX;
+		BLI_bvhtree_find_nearest(tree, co, &nearest, points_nearest_cb, points);
+		EXPECT_EQ(points_nearest_dist_sq_brute_force(points, points_len, co), nearest.dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+}
+
+TEST(kdopbvh, Empty)
+{
+	BVHTree *tree = BLI_bvhtree_new(0, 0.0, 8, 8);
+	BLI_bvhtree_balance(tree);
+	EXPECT_EQ(0, BLI_bvhtree_get_size(tree));
+	BLI_bvhtree_free(tree);
+}
+
+TEST(kdopbvh, Empty_SAH)
+{
+	BVHTree *tree = BLI_bvhtree_new(0, 0.0, 2, 6);
+	BLI_bvhtree_balance_ex(tree, BVH_BALANCE_SAH);
+	EXPECT_EQ(0, BLI_bvhtree_get_size(tree));
+	BLI_bvhtree_free(tree);
+}
+
+TEST(kdopbvh, Single)
+{
+	BVHTree *tree = BLI_bvhtree_new(1, 0.0, 2, 6);
+	{
+		float co[3] = {0};
+		BLI_bvhtree_insert(tree, 0, co, 1);
+	}
+
+	EXPECT_EQ(BLI_bvhtree_get_size(tree), 1);
+
+	BLI_bvhtree_balance_ex(tree, BVH_BALANCE_SAH);
+	BLI_bvhtree_free(tree);
+}
+
+TEST(kdopbvh, FindNearest_Median_4_6)  { find_nearest_points_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6, 0); }
+TEST(kdopbvh, FindNearest_Median_2_8)  { find_nearest_points_test(POINTS_NUM, 1.0, 1000, 1234, 2, 8, 0); }
+TEST(kdopbvh, FindNearest_SAH_2_6)     { find_nearest_points_test(POINTS_NUM, 1.0, 1000, 1234, 2, 6, BVH_BALANCE_SAH); }
+TEST(kdopbvh, FindNearest_SAH_2_26)    { find_nearest_points_test(POINTS_NUM, 1.0, 1000, 1234, 2, 26, BVH_BALANCE_SAH); }
+/* SAH is only used for binary trees, others must fall back to median splits. */
+TEST(kdopbvh, FindNearest_SAH_4_6)     { find_nearest_points_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6, BVH_BALANCE_SAH); }
+/* Many overlapping points, exercises the median fall-back of the SAH build. */
+TEST(kdopbvh, FindNearest_SAH_Coarse)  { find_nearest_points_test(POINTS_NUM, 1.0, 2, 1234, 2, 6, BVH_BALANCE_SAH); }
+TEST(kdopbvh, FindNearest_SAH_Small)   { find_nearest_points_test(7, 1.0, 1000, 1234, 2, 6, BVH_BALANCE_SAH); }
+
+TEST(kdopbvh, UpdateTree_Median_4_6)   { update_tree_points_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6, 0); }
+TEST(kdopbvh, UpdateTree_Median_8_26)  { update_tree_points_test(POINTS_NUM, 1.0, 1000, 1234, 8, 26, 0); }
+TEST(kdopbvh, UpdateTree_SAH_2_6)      { update_tree_points_test(POINTS_NUM, 1.0, 1000, 1234, 2, 6, BVH_BALANCE_SAH); }
+TEST(kdopbvh, UpdateTree_Small)        { update_tree_points_test(5, 1.0, 1000, 1234, 4, 6, 0); }
+
+/* Batch queries must give the same results as individual queries. */
+static void find_nearest_batch_test(
+        int points_len, float scale, int round, int random_seed,
+        char tree_type, char axis)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*query_co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * QUERY_NUM, __func__);
+	BVHTreeNearest *nearest_batch = (BVHTreeNearest *)MEM_mallocN(sizeof(BVHTreeNearest) * QUERY_NUM, __func__);
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+	rng_v3_round(&query_co[0][0], QUERY_NUM * 3, rng, round, scale * 1.5f);
+
+	BVHTree *tree = points_bvhtree_new(points, points_len, tree_type, axis, 0);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		nearest_batch[i].index = -1;
+		nearest_batch[i].dist_sq = FLT_MAX;
+	}
+	BLI_bvhtree_find_nearest_batch(tree, query_co, QUERY_NUM, nearest_batch, points_nearest_cb, points);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		BVHTreeNearest nearest = {-1};
+		nearest.dist_sq = FLT_MAX;
+		BLI_bvhtree_find_nearest(tree, query_co[i], &nearest, points_nearest_cb, points);
+		EXPECT_EQ(nearest.dist_sq, nearest_batch[i].dist_sq);
+		EXPECT_NE(-1, nearest_batch[i].index);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(query_co);
+	MEM_freeN(nearest_batch);
+}
+
+static void ray_cast_batch_test(
+        int points_len, float scale, int round, int random_seed,
+        char tree_type, char axis, float radius)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*ray_co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * QUERY_NUM, __func__);
+	float (*ray_dir)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * QUERY_NUM, __func__);
+	BVHTreeRayHit *hits_batch = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * QUERY_NUM, __func__);
+	int hits_num = 0;
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+	rng_v3_round(&ray_co[0][0], QUERY_NUM * 3, rng, round, scale * 1.5f);
+	for (int i = 0; i < QUERY_NUM; i++) {
+		/* aim at a point so some rays hit */
+		sub_v3_v3v3(ray_dir[i], points[i % points_len], ray_co[i]);
+		if (normalize_v3(ray_dir[i]) == 0.0f) {
+			ray_dir[i][2] = 1.0f;
+		}
+		if (i % 2) {
+			/* and some that (mostly) miss */
+			negate_v3(ray_dir[i]);
+		}
+	}
+
+	/* give the points some size */
+	BVHTree *tree = BLI_bvhtree_new(points_len, scale * 0.001f, tree_type, axis);
+	for (int i = 0; i < points_len; i++) {
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		hits_batch[i].index = -1;
+		hits_batch[i].dist = BVH_RAYCAST_DIST_MAX;
+	}
+	/* odd number of rays, to test incomplete packets */
+	BLI_bvhtree_ray_cast_batch(
+	        tree, ray_co, ray_dir, QUERY_NUM - 1, radius, hits_batch, NULL, NULL, BVH_RAYCAST_DEFAULT);
+
+	for (int i = 0; i < QUERY_NUM - 1; i++) {
+		BVHTreeRayHit hit;
+		hit.index = -1;
+		hit.dist = BVH_RAYCAST_DIST_MAX;
+		BLI_bvhtree_ray_cast(tree, ray_co[i], ray_dir[i], radius, &hit, NULL, NULL);
+		EXPECT_EQ(hit.index, hits_batch[i].index);
+		EXPECT_EQ(hit.dist, hits_batch[i].dist);
+		hits_num += (hit.index != -1);
+	}
+	EXPECT_GT(hits_num, 0);
+	EXPECT_EQ(-1, hits_batch[QUERY_NUM - 1].index);
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(ray_co);
+	MEM_freeN(ray_dir);
+	MEM_freeN(hits_batch);
+}
+
+TEST(kdopbvh, FindNearestBatch_4_6)    { find_nearest_batch_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6); }
+TEST(kdopbvh, FindNearestBatch_2_26)   { find_nearest_batch_test(POINTS_NUM, 1.0, 1000, 1234, 2, 26); }
+TEST(kdopbvh, RayCastBatch_4_6)        { ray_cast_batch_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6, 0.0f); }
+TEST(kdopbvh, RayCastBatch_2_8)        { ray_cast_batch_test(POINTS_NUM, 1.0, 1000, 1234, 2, 8, 0.0f); }
+TEST(kdopbvh, RayCastBatch_Radius)     { ray_cast_batch_test(POINTS_NUM, 1.0, 1000, 1234, 4, 6, 0.01f); }
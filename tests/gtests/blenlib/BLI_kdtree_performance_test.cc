@@ -0,0 +1,92 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define KDTREE_RUN_BIG
+
+#define NEAREST_N 8
+
+static void kdtree_test(const unsigned int points_len, const bool use_batch)
+{
+	printf("\n========== STARTING %u points (batch: %d) ==========\n", points_len, use_batch);
+
+	struct RNG *rng = BLI_rng_new(1234);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * points_len, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * points_len * NEAREST_N, __func__);
+	unsigned int *found = (unsigned int *)MEM_mallocN(sizeof(*found) * points_len, __func__);
+
+	for (unsigned int i = 0; i < points_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+	}
+
+	KDTree *tree = BLI_kdtree_new(points_len);
+
+	{
+		TIMEIT_START(kdtree_insert);
+		for (unsigned int i = 0; i < points_len; i++) {
+			BLI_kdtree_insert(tree, (int)i, points[i]);
+		}
+		TIMEIT_END(kdtree_insert);
+	}
+
+	{
+		TIMEIT_START(kdtree_balance);
+		BLI_kdtree_balance(tree);
+		TIMEIT_END(kdtree_balance);
+	}
+
+	/* search all points, as done by remove-doubles or particle neighbors */
+	if (use_batch) {
+		TIMEIT_START(kdtree_find_nearest_n);
+		BLI_kdtree_find_nearest_n_batch(tree, points, points_len, FLT_MAX, NEAREST_N, nearest, found);
+		TIMEIT_END(kdtree_find_nearest_n);
+
+		TIMEIT_START(kdtree_range_search);
+		BLI_kdtree_find_nearest_n_batch(tree, points, points_len, 0.01f, NEAREST_N, nearest, found);
+		TIMEIT_END(kdtree_range_search);
+	}
+	else {
+		TIMEIT_START(kdtree_find_nearest_n);
+		for (unsigned int i = 0; i < points_len; i++) {
+			found[i] = (unsigned int)BLI_kdtree_find_nearest_n(tree, points[i], &nearest[i * NEAREST_N], NEAREST_N);
+		}
+		TIMEIT_END(kdtree_find_nearest_n);
+
+		TIMEIT_START(kdtree_range_search);
+		for (unsigned int i = 0; i < points_len; i++) {
+			KDTreeNearest *range_nearest;
+			found[i] = (unsigned int)BLI_kdtree_range_search(tree, points[i], &range_nearest, 0.01f);
+			if (range_nearest) {
+				MEM_freeN(range_nearest);
+			}
+		}
+		TIMEIT_END(kdtree_range_search);
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(nearest);
+	MEM_freeN(found);
+
+	printf("========== ENDED ==========\n\n");
+}
+
+TEST(kdtree, Search100000)           { kdtree_test(100000, false); }
+TEST(kdtree, Search100000_Batch)     { kdtree_test(100000, true); }
+TEST(kdtree, Search1000000)          { kdtree_test(1000000, false); }
+TEST(kdtree, Search1000000_Batch)    { kdtree_test(1000000, true); }
+
+#ifdef KDTREE_RUN_BIG
+TEST(kdtree, Search10000000)         { kdtree_test(10000000, false); }
+TEST(kdtree, Search10000000_Batch)   { kdtree_test(10000000, true); }
+#endif
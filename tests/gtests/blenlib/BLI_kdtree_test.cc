@@ -0,0 +1,202 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "BLI_utildefines.h"
+#include "MEM_guardedalloc.h"
+}
+
+#define QUERY_NUM 1000
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static void rng_v3_round(
+        float *coords, int coords_len,
+        struct RNG *rng, int round, float scale)
+{
+	for (int i = 0; i < coords_len; i++) {
+		float f = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		coords[i] = ((float)((int)(f * round)) / (float)round) * scale;
+	}
+}
+
+static KDTree *points_kdtree_new(const float (*points)[3], int points_len)
+{
+	KDTree *tree = BLI_kdtree_new((unsigned int)points_len);
+	for (int i = 0; i < points_len; i++) {
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+	return tree;
+}
+
+static float points_nearest_dist_brute_force(
+        const float (*points)[3], int points_len, const float co[3])
+{
+	float dist_sq_best = FLT_MAX;
+	for (int i = 0; i < points_len; i++) {
+		dist_sq_best = min_ff(dist_sq_best, len_squared_v3v3(points[i], co));
+	}
+	return sqrtf(dist_sq_best);
+}
+
+static unsigned int points_in_range_brute_force(
+        const float (*points)[3], int points_len, const float co[3], const float range)
+{
+	unsigned int found = 0;
+	for (int i = 0; i < points_len; i++) {
+		if (len_squared_v3v3(points[i], co) <= range * range) {
+			found++;
+		}
+	}
+	return found;
+}
+
+static void find_nearest_points_test(int points_len, float scale, int round, int random_seed)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*query_co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * QUERY_NUM, __func__);
+	KDTreeNearest *nearest_batch = (KDTreeNearest *)MEM_mallocN(sizeof(KDTreeNearest) * QUERY_NUM, __func__);
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+	rng_v3_round(&query_co[0][0], QUERY_NUM * 3, rng, round, scale * 1.5f);
+
+	KDTree *tree = points_kdtree_new(points, points_len);
+
+	BLI_kdtree_find_nearest_batch(tree, query_co, QUERY_NUM, nearest_batch);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		KDTreeNearest nearest;
+		const float dist = points_nearest_dist_brute_force(points, points_len, query_co[i]);
+		EXPECT_NE(-1, BLI_kdtree_find_nearest(tree, query_co[i], &nearest));
+		EXPECT_EQ(dist, nearest.dist);
+		EXPECT_EQ(dist, nearest_batch[i].dist);
+		EXPECT_EQ(0.0f, len_v3v3(points[nearest_batch[i].index], nearest_batch[i].co));
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(query_co);
+	MEM_freeN(nearest_batch);
+}
+
+static void find_nearest_n_points_test(
+        int points_len, float scale, int round, int random_seed,
+        const unsigned int n, const float range)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*query_co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * QUERY_NUM, __func__);
+	KDTreeNearest *nearest_batch = (KDTreeNearest *)MEM_mallocN(sizeof(KDTreeNearest) * QUERY_NUM * n, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(KDTreeNearest) * n, __func__);
+	unsigned int *found_batch = (unsigned int *)MEM_mallocN(sizeof(unsigned int) * QUERY_NUM, __func__);
+
+	rng_v3_round(&points[0][0], points_len * 3, rng, round, scale);
+	rng_v3_round(&query_co[0][0], QUERY_NUM * 3, rng, round, scale * 1.5f);
+
+	KDTree *tree = points_kdtree_new(points, points_len);
+
+	BLI_kdtree_find_nearest_n_batch(tree, query_co, QUERY_NUM, range, n, nearest_batch, found_batch);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		const KDTreeNearest *nearest_batch_i = &nearest_batch[i * n];
+
+		if (range == FLT_MAX) {
+			const int found = BLI_kdtree_find_nearest_n(tree, query_co[i], nearest, n);
+			EXPECT_EQ(found, (int)found_batch[i]);
+			for (int j = 0; j < found; j++) {
+				EXPECT_EQ(nearest[j].dist, nearest_batch_i[j].dist);
+			}
+		}
+		else {
+			const unsigned int found = points_in_range_brute_force(points, points_len, query_co[i], range);
+			EXPECT_EQ(min_ii((int)found, (int)n), (int)found_batch[i]);
+		}
+
+		for (unsigned int j = 0; j < found_batch[i]; j++) {
+			EXPECT_LE(nearest_batch_i[j].dist, range);
+			EXPECT_EQ(0.0f, len_v3v3(points[nearest_batch_i[j].index], nearest_batch_i[j].co));
+			if (j != 0) {
+				EXPECT_LE(nearest_batch_i[j - 1].dist, nearest_batch_i[j].dist);
+			}
+		}
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(query_co);
+	MEM_freeN(nearest);
+	MEM_freeN(nearest_batch);
+	MEM_freeN(found_batch);
+}
+
+TEST(kdtree, Empty)
+{
+	KDTree *tree = BLI_kdtree_new(0);
+	BLI_kdtree_balance(tree);
+	{
+		const float co[3] = {0.0f, 0.0f, 0.0f};
+		KDTreeNearest nearest;
+		unsigned int found = 1;
+		EXPECT_EQ(-1, BLI_kdtree_find_nearest(tree, co, NULL));
+		BLI_kdtree_find_nearest_batch(tree, &co, 1, &nearest);
+		EXPECT_EQ(-1, nearest.index);
+		BLI_kdtree_find_nearest_n_batch(tree, &co, 1, FLT_MAX, 1, &nearest, &found);
+		EXPECT_EQ(0, found);
+	}
+	BLI_kdtree_free(tree);
+}
+
+TEST(kdtree, Single)
+{
+	KDTree *tree = BLI_kdtree_new(1);
+	{
+		const float co[3] = {1.0f, 2.0f, 3.0f};
+		BLI_kdtree_insert(tree, 7, co);
+	}
+	BLI_kdtree_balance(tree);
+	{
+		const float co[3] = {0.0f, 0.0f, 0.0f};
+		EXPECT_EQ(7, BLI_kdtree_find_nearest(tree, co, NULL));
+	}
+	BLI_kdtree_free(tree);
+}
+
+/* Balancing again (after adding more points) must be supported. */
+TEST(kdtree, Rebalance)
+{
+	KDTree *tree = BLI_kdtree_new(3);
+	const float co_a[3] = {1.0f, 0.0f, 0.0f};
+	const float co_b[3] = {-1.0f, 0.0f, 0.0f};
+	const float co_c[3] = {0.0f, 5.0f, 0.0f};
+	BLI_kdtree_insert(tree, 0, co_a);
+	BLI_kdtree_insert(tree, 1, co_b);
+	BLI_kdtree_balance(tree);
+	EXPECT_EQ(1, BLI_kdtree_find_nearest(tree, co_b, NULL));
+	BLI_kdtree_insert(tree, 2, co_c);
+	BLI_kdtree_balance(tree);
+	EXPECT_EQ(2, BLI_kdtree_find_nearest(tree, co_c, NULL));
+	EXPECT_EQ(0, BLI_kdtree_find_nearest(tree, co_a, NULL));
+	BLI_kdtree_free(tree);
+}
+
+/* Large enough to balance in parallel. */
+TEST(kdtree, FindNearest_100000)       { find_nearest_points_test(100000, 1.0, 1000, 1234); }
+TEST(kdtree, FindNearest_Small)        { find_nearest_points_test(17, 1.0, 1000, 1234); }
+/* Debug builds balance this in parallel with fewer sub-trees (of two nodes) than a task chunk. */
+TEST(kdtree, FindNearest_FewSubTrees)  { find_nearest_points_test(48, 1.0, 1000, 1234); }
+/* Many duplicate points. */
+TEST(kdtree, FindNearest_Coarse)       { find_nearest_points_test(100000, 1.0, 4, 1234); }
+
+TEST(kdtree, FindNearestN_100000)      { find_nearest_n_points_test(100000, 1.0, 1000, 1234, 8, FLT_MAX); }
+TEST(kdtree, FindNearestN_Small)       { find_nearest_n_points_test(5, 1.0, 1000, 1234, 8, FLT_MAX); }
+TEST(kdtree, FindNearestN_Range)       { find_nearest_n_points_test(100000, 1.0, 1000, 1234, 10000, 0.05f); }
+TEST(kdtree, FindNearestN_RangeLimit)  { find_nearest_n_points_test(100000, 1.0, 1000, 1234, 4, 0.05f); }
@@ -0,0 +1,94 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "MEM_guardedalloc.h"
+};
+
+#define NUM_TASKS 8
+
+/* A scheduler without worker threads for regular pools,
+ * so all tasks run on this thread in a predictable order. */
+
+typedef struct TaskOrderData {
+	int order[NUM_TASKS * 2];
+	int num_run;
+} TaskOrderData;
+
+static void task_order_run(TaskPool *pool, void *taskdata, int UNUSED(thread_id))
+{
+	TaskOrderData *data = (TaskOrderData *)BLI_task_pool_userdata(pool);
+	data->order[data->num_run++] = GET_INT_FROM_POINTER(taskdata);
+}
+
+static void task_order_push(TaskPool *pool, int value, int thread_id)
+{
+	BLI_task_pool_push_from_thread(
+	        pool, task_order_run, SET_INT_IN_POINTER(value), false, TASK_PRIORITY_HIGH, thread_id);
+}
+
+/* Tasks pushed from a task: the first one runs next, the rest last pushed first. */
+static void task_order_push_children_run(TaskPool *pool, void *taskdata, int thread_id)
+{
+	task_order_run(pool, taskdata, thread_id);
+	for (int i = 1; i < NUM_TASKS; i++) {
+		task_order_push(pool, NUM_TASKS + i, thread_id);
+	}
+}
+
+/* The depsgraph pushes its roots to a suspended pool least critical first,
+ * relying on the most critical (last pushed) one to run first. */
+TEST(task, SuspendedPoolPushOrder)
+{
+	TaskOrderData data = {{0}, 0};
+
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+	TaskPool *pool = BLI_task_pool_create_suspended(scheduler, &data);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		task_order_push(pool, i, 0);
+	}
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+
+	EXPECT_EQ(NUM_TASKS, data.num_run);
+	for (int i = 0; i < NUM_TASKS; i++) {
+		EXPECT_EQ(NUM_TASKS - 1 - i, data.order[i]);
+	}
+}
+
+/* The depsgraph pushes the operation to continue with first (to the local queue),
+ * then the other ready ones least critical first. */
+TEST(task, LocalQueuePushOrder)
+{
+	TaskOrderData data = {{0}, 0};
+
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	BLI_task_pool_push_from_thread(
+	        pool, task_order_push_children_run, SET_INT_IN_POINTER(0), false, TASK_PRIORITY_HIGH, 0);
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+
+	EXPECT_EQ(NUM_TASKS, data.num_run);
+	EXPECT_EQ(0, data.order[0]);
+	/* the first child went to the local queue */
+	EXPECT_EQ(NUM_TASKS + 1, data.order[1]);
+	for (int i = 2; i < NUM_TASKS; i++) {
+		EXPECT_EQ(NUM_TASKS * 2 + 1 - i, data.order[i]);
+	}
+}
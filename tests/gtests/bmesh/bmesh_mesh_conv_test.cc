@@ -0,0 +1,386 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_rand.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+
+#include "bmesh.h"
+}
+
+/* -------------------------------------------------------------------- */
+/* Mesh Creation */
+
+struct TestMesh {
+	std::vector<MVert> verts;
+	std::vector<MEdge> edges;
+	std::vector<MPoly> polys;
+	std::vector<MLoop> loops;
+	std::map<std::pair<int, int>, int> edge_map;
+	int act_face = -1;
+};
+
+static int test_mesh_vert_add(TestMesh &tm, float x, float y, float z)
+{
+	MVert mv = {{0}};
+	mv.co[0] = x;
+	mv.co[1] = y;
+	mv.co[2] = z;
+	tm.verts.push_back(mv);
+	return (int)tm.verts.size() - 1;
+}
+
+static int test_mesh_edge_add(TestMesh &tm, int v1, int v2)
+{
+	const std::pair<int, int> key(MIN2(v1, v2), MAX2(v1, v2));
+	std::map<std::pair<int, int>, int>::const_iterator it = tm.edge_map.find(key);
+	if (it != tm.edge_map.end()) {
+		return it->second;
+	}
+	MEdge me = {0};
+	me.v1 = (unsigned int)v1;
+	me.v2 = (unsigned int)v2;
+	me.flag = ME_EDGEDRAW;
+	tm.edges.push_back(me);
+	tm.edge_map[key] = (int)tm.edges.size() - 1;
+	return (int)tm.edges.size() - 1;
+}
+
+static int test_mesh_poly_add(TestMesh &tm, const std::vector<int> &poly_verts)
+{
+	MPoly mp = {0};
+	mp.loopstart = (int)tm.loops.size();
+	mp.totloop = (int)poly_verts.size();
+	for (size_t i = 0; i < poly_verts.size(); i++) {
+		MLoop ml;
+		ml.v = (unsigned int)poly_verts[i];
+		ml.e = (unsigned int)test_mesh_edge_add(tm, poly_verts[i], poly_verts[(i + 1) % poly_verts.size()]);
+		tm.loops.push_back(ml);
+	}
+	tm.polys.push_back(mp);
+	return (int)tm.polys.size() - 1;
+}
+
+/**
+ * A grid of quads, with two faces added on its first edge (giving it a radial cycle of three loops),
+ * an n-gon sharing some of the grid's edges, a loose edge and a loose vertex.
+ */
+static void test_mesh_grid_create(TestMesh &tm, const int size)
+{
+	const int row = size + 1;
+	int x, y;
+
+	for (y = 0; y < row; y++) {
+		for (x = 0; x < row; x++) {
+			test_mesh_vert_add(tm, (float)x, (float)y, 0.0f);
+		}
+	}
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			const int v = y * row + x;
+			test_mesh_poly_add(tm, {v, v + 1, v + row + 1, v + row});
+		}
+	}
+
+	/* fins on the edge (0, 1) */
+	for (x = 0; x < 2; x++) {
+		const float z = x ? 1.0f : -1.0f;
+		const int v_a = test_mesh_vert_add(tm, 0.0f, 0.0f, z);
+		const int v_b = test_mesh_vert_add(tm, 1.0f, 0.0f, z);
+		test_mesh_poly_add(tm, {1, 0, v_a, v_b});
+	}
+
+	/* n-gon on the last row's outer edges */
+	{
+		std::vector<int> ngon;
+		const int v_top = test_mesh_vert_add(tm, (float)size / 2.0f, (float)size + 1.0f, 0.0f);
+		ngon.push_back(v_top);
+		for (x = size; x >= 0; x--) {
+			ngon.push_back(size * row + x);
+		}
+		test_mesh_poly_add(tm, ngon);
+	}
+
+	/* loose edge and vertex */
+	test_mesh_edge_add(
+	        tm,
+	        test_mesh_vert_add(tm, -2.0f, 0.0f, 0.0f),
+	        test_mesh_vert_add(tm, -3.0f, 0.0f, 0.0f));
+	test_mesh_vert_add(tm, -4.0f, 0.0f, 0.0f);
+}
+
+/* Set selection & hidden state (and a few other flags) at random. */
+static void test_mesh_flags_randomize(TestMesh &tm, const unsigned int seed)
+{
+	RNG *rng = BLI_rng_new(seed);
+	size_t i;
+
+	for (i = 0; i < tm.verts.size(); i++) {
+		const int r = BLI_rng_get_int(rng) % 8;
+		tm.verts[i].flag = (char)((r == 0 ? ME_HIDE : 0) | (r < 3 ? SELECT : 0));
+	}
+	for (i = 0; i < tm.edges.size(); i++) {
+		const int r = BLI_rng_get_int(rng) % 8;
+		tm.edges[i].flag |= (short)((r == 0 ? ME_HIDE : 0) | (r < 3 ? SELECT : 0) |
+		                            (r == 4 ? ME_SEAM : 0) | (r == 5 ? ME_SHARP : 0));
+	}
+	for (i = 0; i < tm.polys.size(); i++) {
+		const int r = BLI_rng_get_int(rng) % 8;
+		tm.polys[i].flag = (char)((r == 0 ? ME_HIDE : 0) | (r < 3 ? ME_FACE_SEL : 0) |
+		                          (r == 4 ? ME_SMOOTH : 0));
+		tm.polys[i].mat_nr = (short)(r % 3);
+	}
+	tm.act_face = (int)(BLI_rng_get_uint(rng) % tm.polys.size());
+
+	BLI_rng_free(rng);
+}
+
+static BMesh *test_bmesh_from_test_mesh(TestMesh &tm, const bool use_serial)
+{
+	Mesh me;
+	memset(&me, 0, sizeof(me));
+	strcpy(me.id.name, "METest");
+	me.mvert = tm.verts.data();
+	me.medge = tm.edges.data();
+	me.mpoly = tm.polys.data();
+	me.mloop = tm.loops.data();
+	me.totvert = (int)tm.verts.size();
+	me.totedge = (int)tm.edges.size();
+	me.totpoly = (int)tm.polys.size();
+	me.totloop = (int)tm.loops.size();
+	me.act_face = tm.act_face;
+
+	const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_ME(&me);
+	BMeshCreateParams bm_create_params = {0};
+	bm_create_params.use_toolflags = true;
+	BMesh *bm = BM_mesh_create(&allocsize, &bm_create_params);
+
+	BMeshFromMeshParams bm_from_me_params = {0};
+	bm_from_me_params.calc_face_normal = true;
+	bm_from_me_params.use_serial = use_serial;
+	BM_mesh_bm_from_me(bm, &me, &bm_from_me_params);
+
+	return bm;
+}
+
+/* -------------------------------------------------------------------- */
+/* Comparison */
+
+#define EXPECT_ELEM_INDEX_EQ(a, b) \
+	EXPECT_EQ((a) ? BM_elem_index_get(a) : -1, (b) ? BM_elem_index_get(b) : -1)
+
+static void expect_bmesh_eq(BMesh *bm_a, BMesh *bm_b)
+{
+	ASSERT_EQ(bm_a->totvert, bm_b->totvert);
+	ASSERT_EQ(bm_a->totedge, bm_b->totedge);
+	ASSERT_EQ(bm_a->totface, bm_b->totface);
+	ASSERT_EQ(bm_a->totloop, bm_b->totloop);
+
+	EXPECT_EQ(bm_a->totvertsel, bm_b->totvertsel);
+	EXPECT_EQ(bm_a->totedgesel, bm_b->totedgesel);
+	EXPECT_EQ(bm_a->totfacesel, bm_b->totfacesel);
+
+	EXPECT_EQ(bm_a->elem_index_dirty, bm_b->elem_index_dirty);
+	EXPECT_ELEM_INDEX_EQ(bm_a->act_face, bm_b->act_face);
+
+	BMIter iter_a, iter_b;
+	int i;
+
+	BMVert *v_a, *v_b;
+	v_b = (BMVert *)BM_iter_new(&iter_b, bm_b, BM_VERTS_OF_MESH, NULL);
+	BM_ITER_MESH_INDEX (v_a, &iter_a, bm_a, BM_VERTS_OF_MESH, i) {
+		EXPECT_EQ(BM_elem_index_get(v_a), i);
+		EXPECT_EQ(BM_elem_index_get(v_b), i);
+		EXPECT_EQ(v_a->head.hflag, v_b->head.hflag);
+		EXPECT_EQ(v_a->head.api_flag, v_b->head.api_flag);
+		EXPECT_V3_NEAR(v_a->co, v_b->co, 0.0f);
+
+		/* disk cycle */
+		EXPECT_ELEM_INDEX_EQ(v_a->e, v_b->e);
+		if (v_a->e && v_b->e) {
+			BMEdge *e_iter_a = v_a->e, *e_iter_b = v_b->e;
+			do {
+				EXPECT_ELEM_INDEX_EQ(e_iter_a, e_iter_b);
+				EXPECT_ELEM_INDEX_EQ(BM_DISK_EDGE_PREV(e_iter_a, v_a), BM_DISK_EDGE_PREV(e_iter_b, v_b));
+				e_iter_a = BM_DISK_EDGE_NEXT(e_iter_a, v_a);
+				e_iter_b = BM_DISK_EDGE_NEXT(e_iter_b, v_b);
+			} while ((e_iter_a != v_a->e) && (e_iter_b != v_b->e));
+			EXPECT_TRUE((e_iter_a == v_a->e) && (e_iter_b == v_b->e));
+		}
+
+		v_b = (BMVert *)BM_iter_step(&iter_b);
+	}
+
+	BMEdge *e_a, *e_b;
+	e_b = (BMEdge *)BM_iter_new(&iter_b, bm_b, BM_EDGES_OF_MESH, NULL);
+	BM_ITER_MESH_INDEX (e_a, &iter_a, bm_a, BM_EDGES_OF_MESH, i) {
+		EXPECT_EQ(BM_elem_index_get(e_a), i);
+		EXPECT_EQ(BM_elem_index_get(e_b), i);
+		EXPECT_EQ(e_a->head.hflag, e_b->head.hflag);
+		EXPECT_EQ(e_a->head.api_flag, e_b->head.api_flag);
+		EXPECT_ELEM_INDEX_EQ(e_a->v1, e_b->v1);
+		EXPECT_ELEM_INDEX_EQ(e_a->v2, e_b->v2);
+
+		/* radial cycle */
+		EXPECT_ELEM_INDEX_EQ(e_a->l, e_b->l);
+		if (e_a->l && e_b->l) {
+			BMLoop *l_iter_a = e_a->l, *l_iter_b = e_b->l;
+			do {
+				EXPECT_ELEM_INDEX_EQ(l_iter_a, l_iter_b);
+				EXPECT_ELEM_INDEX_EQ(l_iter_a->radial_prev, l_iter_b->radial_prev);
+				l_iter_a = l_iter_a->radial_next;
+				l_iter_b = l_iter_b->radial_next;
+			} while ((l_iter_a != e_a->l) && (l_iter_b != e_b->l));
+			EXPECT_TRUE((l_iter_a == e_a->l) && (l_iter_b == e_b->l));
+		}
+
+		e_b = (BMEdge *)BM_iter_step(&iter_b);
+	}
+
+	BMFace *f_a, *f_b;
+	f_b = (BMFace *)BM_iter_new(&iter_b, bm_b, BM_FACES_OF_MESH, NULL);
+	BM_ITER_MESH_INDEX (f_a, &iter_a, bm_a, BM_FACES_OF_MESH, i) {
+		EXPECT_EQ(BM_elem_index_get(f_a), i);
+		EXPECT_EQ(BM_elem_index_get(f_b), i);
+		EXPECT_EQ(f_a->head.hflag, f_b->head.hflag);
+		EXPECT_EQ(f_a->head.api_flag, f_b->head.api_flag);
+		EXPECT_EQ(f_a->mat_nr, f_b->mat_nr);
+		EXPECT_V3_NEAR(f_a->no, f_b->no, 0.0f);
+		ASSERT_EQ(f_a->len, f_b->len);
+
+		BMLoop *l_iter_a = BM_FACE_FIRST_LOOP(f_a), *l_iter_b = BM_FACE_FIRST_LOOP(f_b);
+		int j;
+		for (j = 0; j < f_a->len; j++) {
+			EXPECT_ELEM_INDEX_EQ(l_iter_a, l_iter_b);
+			EXPECT_EQ(l_iter_a->head.hflag, l_iter_b->head.hflag);
+			EXPECT_ELEM_INDEX_EQ(l_iter_a->v, l_iter_b->v);
+			EXPECT_ELEM_INDEX_EQ(l_iter_a->e, l_iter_b->e);
+			EXPECT_ELEM_INDEX_EQ(l_iter_a->f, l_iter_b->f);
+			EXPECT_ELEM_INDEX_EQ(l_iter_a->prev, l_iter_b->prev);
+			l_iter_a = l_iter_a->next;
+			l_iter_b = l_iter_b->next;
+		}
+		EXPECT_TRUE((l_iter_a == BM_FACE_FIRST_LOOP(f_a)) && (l_iter_b == BM_FACE_FIRST_LOOP(f_b)));
+
+		f_b = (BMFace *)BM_iter_step(&iter_b);
+	}
+}
+
+/* Convert both ways, compare, then return the bulk result for further checks (caller frees). */
+static BMesh *test_bmesh_bulk_serial_compare(TestMesh &tm)
+{
+	BMesh *bm_bulk = test_bmesh_from_test_mesh(tm, false);
+	BMesh *bm_serial = test_bmesh_from_test_mesh(tm, true);
+
+	expect_bmesh_eq(bm_bulk, bm_serial);
+
+	BM_mesh_free(bm_serial);
+	return bm_bulk;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(bmesh_mesh_conv, FromMesh_Plain)
+{
+	TestMesh tm;
+	test_mesh_grid_create(tm, 4);
+	BMesh *bm = test_bmesh_bulk_serial_compare(tm);
+
+	EXPECT_EQ(bm->totvertsel, 0);
+	EXPECT_EQ(bm->act_face, (BMFace *)NULL);
+	BM_mesh_free(bm);
+}
+
+TEST(bmesh_mesh_conv, FromMesh_Selection)
+{
+	TestMesh tm;
+	test_mesh_grid_create(tm, 8);
+	for (size_t i = 0; i < tm.polys.size(); i += 3) {
+		tm.polys[i].flag |= ME_FACE_SEL;
+	}
+	tm.edges[1].flag |= SELECT;
+	tm.verts[tm.verts.size() - 1].flag |= SELECT;
+	tm.act_face = 3;
+	BMesh *bm = test_bmesh_bulk_serial_compare(tm);
+
+	EXPECT_EQ(BM_elem_index_get(bm->act_face), 3);
+	BM_mesh_free(bm);
+}
+
+/* Hidden elements are never selected, whatever their flag or their neighbors. */
+TEST(bmesh_mesh_conv, FromMesh_Hidden)
+{
+	TestMesh tm;
+	test_mesh_grid_create(tm, 4);
+	for (size_t i = 0; i < tm.polys.size(); i++) {
+		tm.polys[i].flag |= ME_FACE_SEL | ((i % 2) ? ME_HIDE : 0);
+	}
+	for (size_t i = 0; i < tm.edges.size(); i += 2) {
+		tm.edges[i].flag |= SELECT | ME_HIDE;
+	}
+	for (size_t i = 0; i < tm.verts.size(); i += 3) {
+		tm.verts[i].flag |= SELECT | ME_HIDE;
+	}
+	BMesh *bm = test_bmesh_bulk_serial_compare(tm);
+
+	BMIter iter;
+	BMElem *ele;
+	const BMIterType itypes[3] = {BM_VERTS_OF_MESH, BM_EDGES_OF_MESH, BM_FACES_OF_MESH};
+	for (int i = 0; i < 3; i++) {
+		BM_ITER_MESH (ele, &iter, bm, itypes[i]) {
+			if (BM_elem_flag_test(ele, BM_ELEM_HIDDEN)) {
+				EXPECT_FALSE(BM_elem_flag_test(ele, BM_ELEM_SELECT));
+			}
+		}
+	}
+	EXPECT_EQ(bm->totfacesel, (bm->totface + 1) / 2);
+	BM_mesh_free(bm);
+}
+
+/* A selected face selects its vertices, even a vertex only reached through the face's hidden edges. */
+TEST(bmesh_mesh_conv, FromMesh_SelectedFaceHiddenEdge)
+{
+	TestMesh tm;
+	test_mesh_grid_create(tm, 2);
+	const MPoly *mp = &tm.polys[0];
+	/* both edges of the face using its second vertex */
+	const int edge_index_a = (int)tm.loops[mp->loopstart].e;
+	const int edge_index_b = (int)tm.loops[mp->loopstart + 1].e;
+	const int vert_index = (int)tm.loops[mp->loopstart + 1].v;
+	tm.polys[0].flag |= ME_FACE_SEL;
+	tm.edges[edge_index_a].flag |= ME_HIDE;
+	tm.edges[edge_index_b].flag |= ME_HIDE;
+	tm.act_face = 0;
+	BMesh *bm = test_bmesh_bulk_serial_compare(tm);
+
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE);
+	EXPECT_FALSE(BM_elem_flag_test(BM_edge_at_index(bm, edge_index_a), BM_ELEM_SELECT));
+	EXPECT_FALSE(BM_elem_flag_test(BM_edge_at_index(bm, edge_index_b), BM_ELEM_SELECT));
+	EXPECT_TRUE(BM_elem_flag_test(BM_vert_at_index(bm, vert_index), BM_ELEM_SELECT));
+	EXPECT_EQ(bm->totvertsel, 4);
+	EXPECT_EQ(bm->totedgesel, 2);
+	EXPECT_EQ(bm->totfacesel, 1);
+	EXPECT_EQ(BM_elem_index_get(bm->act_face), 0);
+	BM_mesh_free(bm);
+}
+
+/* Large enough to use threads (see BM_OMP_LIMIT). */
+TEST(bmesh_mesh_conv, FromMesh_Random)
+{
+	TestMesh tm;
+	test_mesh_grid_create(tm, 64);
+	test_mesh_flags_randomize(tm, 1234);
+	BMesh *bm = test_bmesh_bulk_serial_compare(tm);
+	BM_mesh_free(bm);
+}
@@ -45,6 +45,18 @@ TEST(guardedalloc, GuardedAlignedAlloc16)
 	DoBasicAlignmentChecks(16);
 }
 
+TEST(guardedalloc, ProfileAlignedAlloc16)
+{
+	MEM_use_profiling_allocator();
+	DoBasicAlignmentChecks(16);
+}
+
+TEST(guardedalloc, SlabAlignedAlloc16)
+{
+	MEM_use_slab_allocator();
+	DoBasicAlignmentChecks(16);
+}
+
 // On Apple we currently support 16 bit alignment only.
 // Harmless for Blender, but would be nice to support
 // eventually.
@@ -0,0 +1,75 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_task.h"
+#include "PIL_time_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define BLOCKS_NUM 1000
+#define ITERATIONS_NUM 2000
+#define TASKS_NUM 8
+
+/* Allocate and free many small blocks of varying size, in the order they are typically used
+ * (custom-data layers, list-base links, temporary arrays). */
+static void alloc_small_blocks(const int iterations_num, const int seed)
+{
+	void **blocks = (void **)MEM_mallocN(sizeof(*blocks) * BLOCKS_NUM, __func__);
+	unsigned int rand_state = (unsigned int)seed;
+
+	for (int iter = 0; iter < iterations_num; iter++) {
+		for (int i = 0; i < BLOCKS_NUM; i++) {
+			rand_state = rand_state * 1103515245u + 12345u;
+			blocks[i] = MEM_mallocN(8 + (rand_state >> 16) % 256, __func__);
+		}
+		/* Free in a different order than allocated. */
+		for (int i = 0; i < BLOCKS_NUM; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+		for (int i = 1; i < BLOCKS_NUM; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+	}
+
+	MEM_freeN(blocks);
+}
+
+static void alloc_small_blocks_task(void *UNUSED(userdata), int index)
+{
+	alloc_small_blocks(ITERATIONS_NUM / TASKS_NUM, index);
+}
+
+static void alloc_test(const char *id)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	{
+		TIMEIT_START(small_alloc_single_thread);
+		alloc_small_blocks(ITERATIONS_NUM, 0);
+		TIMEIT_END(small_alloc_single_thread);
+	}
+
+	{
+		TIMEIT_START(small_alloc_multi_thread);
+		BLI_task_parallel_range(0, TASKS_NUM, NULL, alloc_small_blocks_task, true);
+		TIMEIT_END(small_alloc_multi_thread);
+	}
+
+	printf("========== ENDED ==========\n\n");
+}
+
+/* Order matters, blocks of the size-class allocator can't be freed by the lock-free allocator. */
+TEST(guardedalloc, SmallAllocLockfree)
+{
+	alloc_test("lock-free allocator");
+}
+
+TEST(guardedalloc, SmallAllocSlab)
+{
+	MEM_use_slab_allocator();
+	alloc_test("size-class allocator");
+}
@@ -0,0 +1,61 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+TEST(guardedalloc, ProfileAllocLen)
+{
+	MEM_use_profiling_allocator();
+	const unsigned int blocks_num = MEM_get_memory_blocks_in_use();
+
+	char *foo = (char *)MEM_mallocN(12, "test");
+	EXPECT_EQ(12, MEM_allocN_len(foo));
+
+	char *bar = (char *)MEM_dupallocN(foo);
+	EXPECT_EQ(12, MEM_allocN_len(bar));
+	MEM_freeN(bar);
+
+	foo = (char *)MEM_reallocN(foo, 100);
+	EXPECT_EQ(100, MEM_allocN_len(foo));
+
+	foo = (char *)MEM_reallocN(foo, 4);
+	EXPECT_EQ(4, MEM_allocN_len(foo));
+
+	MEM_freeN(foo);
+
+	EXPECT_EQ(blocks_num, MEM_get_memory_blocks_in_use());
+}
+
+TEST(guardedalloc, ProfileRecallocZero)
+{
+	MEM_use_profiling_allocator();
+
+	char *foo = (char *)MEM_mallocN(8, "test");
+	memset(foo, 1, 8);
+	foo = (char *)MEM_recallocN(foo, 64);
+	EXPECT_EQ(64, MEM_allocN_len(foo));
+	for (int i = 0; i < 8; i++) {
+		EXPECT_EQ(1, foo[i]);
+	}
+	for (int i = 8; i < 64; i++) {
+		EXPECT_EQ(0, foo[i]);
+	}
+	MEM_freeN(foo);
+}
+
+/* Blocks allocated before switching allocators must remain valid. */
+TEST(guardedalloc, ProfileSwitchAllocator)
+{
+	int *foo = (int *)MEM_callocN(sizeof(int) * 4, "test");
+	MEM_use_profiling_allocator();
+	EXPECT_EQ(sizeof(int) * 4, MEM_allocN_len(foo));
+	int *bar = (int *)MEM_dupallocN(foo);
+	EXPECT_EQ(sizeof(int) * 4, MEM_allocN_len(bar));
+	MEM_freeN(bar);
+	MEM_freeN(foo);
+}
@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define BLOCKS_NUM 10000
+
+TEST(guardedalloc, SlabAllocLen)
+{
+	MEM_use_slab_allocator();
+	const unsigned int blocks_num = MEM_get_memory_blocks_in_use();
+	const size_t mem_in_use = MEM_get_memory_in_use();
+
+	char *foo = (char *)MEM_mallocN(12, "test");
+	EXPECT_EQ(12, MEM_allocN_len(foo));
+	EXPECT_EQ(blocks_num + 1, MEM_get_memory_blocks_in_use());
+	EXPECT_EQ(mem_in_use + 12, MEM_get_memory_in_use());
+
+	char *bar = (char *)MEM_dupallocN(foo);
+	EXPECT_EQ(12, MEM_allocN_len(bar));
+	MEM_freeN(bar);
+
+	/* Grow into a large (non size-class) block and back. */
+	foo = (char *)MEM_reallocN(foo, 4000);
+	EXPECT_EQ(4000, MEM_allocN_len(foo));
+
+	foo = (char *)MEM_reallocN(foo, 4);
+	EXPECT_EQ(4, MEM_allocN_len(foo));
+
+	MEM_freeN(foo);
+
+	EXPECT_EQ(blocks_num, MEM_get_memory_blocks_in_use());
+	EXPECT_EQ(mem_in_use, MEM_get_memory_in_use());
+}
+
+TEST(guardedalloc, SlabRecallocZero)
+{
+	MEM_use_slab_allocator();
+
+	char *foo = (char *)MEM_mallocN(8, "test");
+	memset(foo, 1, 8);
+	foo = (char *)MEM_recallocN(foo, 64);
+	EXPECT_EQ(64, MEM_allocN_len(foo));
+	for (int i = 0; i < 8; i++) {
+		EXPECT_EQ(1, foo[i]);
+	}
+	for (int i = 8; i < 64; i++) {
+		EXPECT_EQ(0, foo[i]);
+	}
+	MEM_freeN(foo);
+}
+
+/* Blocks must not overlap, also when chunks are moved between thread caches and the central lists. */
+TEST(guardedalloc, SlabManyBlocks)
+{
+	MEM_use_slab_allocator();
+
+	int **blocks = (int **)MEM_mallocN(sizeof(*blocks) * BLOCKS_NUM, __func__);
+	for (int i = 0; i < BLOCKS_NUM; i++) {
+		const int len = 1 + (i * 7) % 250;
+		blocks[i] = (int *)MEM_callocN(sizeof(int) * (size_t)len, __func__);
+		for (int j = 0; j < len; j++) {
+			EXPECT_EQ(0, blocks[i][j]);
+			blocks[i][j] = i;
+		}
+	}
+	/* Free every other block and allocate again. */
+	for (int i = 0; i < BLOCKS_NUM; i += 2) {
+		MEM_freeN(blocks[i]);
+		blocks[i] = (int *)MEM_mallocN(sizeof(int) * 3, __func__);
+		blocks[i][0] = blocks[i][1] = blocks[i][2] = i;
+	}
+	for (int i = 0; i < BLOCKS_NUM; i++) {
+		const int len = (i % 2) ? 1 + (i * 7) % 250 : 3;
+		for (int j = 0; j < len; j++) {
+			EXPECT_EQ(i, blocks[i][j]);
+		}
+		MEM_freeN(blocks[i]);
+	}
+	MEM_freeN(blocks);
+}
+
+#ifndef WIN32
+#include <pthread.h>
+
+static pthread_key_t slab_test_key;
+
+/* Runs after the allocator freed the thread cache (keys are destroyed in creation order). */
+static void slab_test_key_free(void *value)
+{
+	char *foo = (char *)MEM_mallocN(24, "test");
+	memset(foo, 1, 24);
+	MEM_freeN(foo);
+	MEM_freeN(value);
+}
+
+static void *slab_test_thread(void *UNUSED(arg))
+{
+	MEM_freeN(MEM_mallocN(16, "test"));
+	pthread_setspecific(slab_test_key, MEM_mallocN(32, "test"));
+	return NULL;
+}
+
+/* Allocating from destructors of other keys on an exiting thread must not use its freed cache. */
+TEST(guardedalloc, SlabThreadExit)
+{
+	MEM_use_slab_allocator();
+	const unsigned int blocks_num = MEM_get_memory_blocks_in_use();
+	pthread_t thread;
+
+	/* Allocate first so the allocators own key is created before ours. */
+	MEM_freeN(MEM_mallocN(16, "test"));
+	pthread_key_create(&slab_test_key, slab_test_key_free);
+	pthread_create(&thread, NULL, slab_test_thread, NULL);
+	pthread_join(thread, NULL);
+	pthread_key_delete(slab_test_key);
+
+	EXPECT_EQ(blocks_num, MEM_get_memory_blocks_in_use());
+}
+#endif
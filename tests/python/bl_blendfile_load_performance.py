@@ -0,0 +1,82 @@
+# Apache License, Version 2.0
+
+# Measure loading time of large synthetic .blend files (many data-blocks and linked library data).
+#
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/bl_blendfile_load_performance.py -- \
+#     --objects 20000 --linked 20000 --repeat 3
+
+import os
+import sys
+import tempfile
+import time
+
+import bpy
+
+
+def create_library_file(filepath, objects_num):
+    bpy.ops.wm.read_factory_settings(use_empty=True)
+    scene = bpy.context.scene
+    for i in range(objects_num):
+        me = bpy.data.meshes.new("LibMesh.%d" % i)
+        me.materials.append(bpy.data.materials.new("LibMaterial.%d" % i))
+        ob = bpy.data.objects.new("LibObject.%d" % i, me)
+        scene.objects.link(ob)
+    bpy.ops.wm.save_as_mainfile(filepath=filepath)
+
+
+def create_main_file(filepath, filepath_lib, objects_num):
+    bpy.ops.wm.read_factory_settings(use_empty=True)
+    scene = bpy.context.scene
+
+    # Linked data, resolved through the library map.
+    with bpy.data.libraries.load(filepath_lib, link=True) as (data_from, data_to):
+        data_to.objects = data_from.objects
+    for ob in data_to.objects:
+        scene.objects.link(ob)
+
+    # Local data, resolved through the data and global maps.
+    material = bpy.data.materials.new("Material")
+    for i in range(objects_num):
+        me = bpy.data.meshes.new("Mesh.%d" % i)
+        me.materials.append(material)
+        ob = bpy.data.objects.new("Object.%d" % i, me)
+        scene.objects.link(ob)
+
+    bpy.ops.wm.save_as_mainfile(filepath=filepath)
+
+
+def main():
+    import argparse
+
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    parser = argparse.ArgumentParser(description="Measure .blend file load time")
+    parser.add_argument("--objects", type=int, default=20000, help="Number of local objects")
+    parser.add_argument("--linked", type=int, default=20000, help="Number of linked objects")
+    parser.add_argument("--repeat", type=int, default=3, help="Number of times to load the file")
+    args = parser.parse_args(argv)
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        filepath_lib = os.path.join(temp_dir, "perf_lib.blend")
+        filepath = os.path.join(temp_dir, "perf_main.blend")
+
+        create_library_file(filepath_lib, args.linked)
+        create_main_file(filepath, filepath_lib, args.objects)
+
+        print("File size: %.2f MB (library %.2f MB)" % (
+            os.path.getsize(filepath) / (1024 * 1024),
+            os.path.getsize(filepath_lib) / (1024 * 1024)))
+
+        timings = []
+        for _ in range(args.repeat):
+            time_start = time.time()
+            bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False)
+            timings.append(time.time() - time_start)
+
+            assert len(bpy.data.objects) == args.objects + args.linked
+
+        print("Load time: %.4f sec (best of %d), %.4f sec (average)" % (
+            min(timings), len(timings), sum(timings) / len(timings)))
+
+
+if __name__ == "__main__":
+    main()